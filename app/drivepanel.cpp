@@ -114,7 +114,6 @@ void DrivePanel::updateUI()
 
 
   if(smartOK) {
-    int percent = drive -> getSelfTestPercentRemaining();
     QString status = drive -> getSelfTestStatus();
 
     ui -> selfTestStatusLabel -> setText(localizeSelfTestStatus(status));
@@ -123,12 +122,13 @@ void DrivePanel::updateUI()
       ui -> startSelfTestButton -> setEnabled(false);
       ui -> progressBar -> setEnabled(true);
       ui -> cancelSelfTestButton -> setVisible(true);
-      if(percent >= 0) ui -> progressBar -> setValue(100 - percent);
+      updateProgress();
 
     } else {
       ui -> startSelfTestButton -> setEnabled(true);
       ui -> progressBar -> setEnabled(false);
       ui -> progressBar -> setValue(0);
+      ui -> progressBar -> setToolTip(QString());
       ui -> cancelSelfTestButton -> setVisible(false);
     }
 
@@ -141,6 +141,29 @@ void DrivePanel::updateUI()
 
 
 
+/*
+ * Update the self test progress bar, from the drive's job if UDisks2
+ * reports its progress or from the drive's SMART data
+ */
+void DrivePanel::updateProgress()
+{
+  Drive* drive = getDrive();
+  if(drive == nullptr || !drive -> isOperationRunning())
+    return;
+
+  double progress = drive -> getJobProgress();
+  int percent = drive -> getSelfTestPercentRemaining();
+
+  if(progress >= 0)
+    ui -> progressBar -> setValue(progress * 100);
+  else if(percent >= 0)
+    ui -> progressBar -> setValue(100 - percent);
+
+  ui -> progressBar -> setToolTip(jobToolTip(drive));
+}
+
+
+
 /*
  * Test if an operation is currently running on the drive
  */
@@ -148,7 +171,7 @@ bool DrivePanel::isOperationRunning()
 {
   Drive* drive = getDrive();
 
-  return !(drive == nullptr || drive -> getSelfTestStatus() != "inprogress");
+  return drive != nullptr && drive -> isOperationRunning();
 }
 
 
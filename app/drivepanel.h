@@ -43,6 +43,7 @@ public:
 
 protected:
   virtual void updateUI() override;
+  virtual void updateProgress() override;
   virtual bool isOperationRunning() override;
 
 private:
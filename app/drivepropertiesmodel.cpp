@@ -37,7 +37,9 @@
  */
 DrivePropertiesModel::DrivePropertiesModel()
 {
-  sensitiveAttributes = DiskMonitorSettings::sensitiveAttributes();
+  evaluator.setSensitiveAttributes(DiskMonitorSettings::sensitiveAttributes());
+  evaluateHealth();
+
   headerLabels << i18nc("Attribute's id", "Id")
                << i18nc("Attribute's name", "Name")
                << i18nc("Attribute's flags", "Flags")
@@ -81,6 +83,57 @@ void DrivePropertiesModel::updateInternalState()
     attributes = drive -> getSMARTAttributes();
   else
     attributes.clear();
+
+  evaluateHealth();
+}
+
+
+
+/*
+ * Evaluate the health of the attributes of the drive, used to color the rows
+ */
+void DrivePropertiesModel::evaluateHealth()
+{
+  Drive* drive = getDrive();
+
+  if(drive != nullptr)
+    health = evaluator.evaluate(drive -> getSMARTAttributeTable());
+  else
+    health = evaluator.evaluate(SmartAttributeTable());
+}
+
+
+
+/*
+ * Key identifying the row of an attribute
+ */
+static quint8 attributeKey(const SmartAttribute& attr)
+{
+  return attr.id;
+}
+
+
+
+/*
+ * Test if two values of an attribute are displayed the same way
+ */
+static bool sameAttribute(const SmartAttribute& a, const SmartAttribute& b)
+{
+  return a.name == b.name && a.flags == b.flags && a.value == b.value && a.worst == b.worst &&
+         a.threshold == b.threshold && a.pretty == b.pretty && a.pretty_unit == b.pretty_unit;
+}
+
+
+
+/*
+ * Handle an update of the drive, notifying only the attributes which changed in order
+ * to keep the scroll position and selection of the table
+ */
+void DrivePropertiesModel::updateModel()
+{
+  Drive* drive = getDrive();
+  evaluateHealth();
+  updateRows(attributes, drive != nullptr ? drive -> getSMARTAttributes() : SmartAttributesList(), attributeKey, sameAttribute);
 }
 
 
@@ -122,12 +175,12 @@ QVariant DrivePropertiesModel::data(const QModelIndex& index, int role) const
       return QVariant(QBrush());
 
     //set the row background to 'error' if value < threshold
-    if(attr.value <= attr.threshold) {
+    if(health.isBelowThreshold(attr.id)) {
       QBrush brush(DiskMonitorSettings::errorColor());
       return QVariant(brush);
 
     //set the row background to 'warning' if value is non 0 for sensitive attributes
-    } else if(attr.pretty != 0 && sensitiveAttributes.contains(attr.id)) {
+    } else if(health.isSensitiveNonZero(attr.id)) {
       QBrush brush(DiskMonitorSettings::warningColor());
       return QVariant(brush);
 
@@ -213,5 +266,9 @@ QVariant DrivePropertiesModel::headerData(int section, Qt::Orientation orientati
  */
 void DrivePropertiesModel::configChanged()
 {
-  sensitiveAttributes = DiskMonitorSettings::sensitiveAttributes();
+  evaluator.setSensitiveAttributes(DiskMonitorSettings::sensitiveAttributes());
+  evaluateHealth();
+
+  if(!attributes.isEmpty())
+    emitRowsChanged(0, attributes.size() - 1);
 }
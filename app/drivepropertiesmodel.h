@@ -23,6 +23,7 @@
 
 #include "storageunitpropertiesmodel.h"
 #include "drive.h"
+#include "smarthealthevaluator.h"
 
 
 /*
@@ -45,14 +46,20 @@ public:
 
 protected:
   virtual void updateInternalState() override;
+  virtual void updateModel() override;
 
   QVariant humanizeSmartAttribute(const SmartAttribute& attr) const;
 
 private:
   QStringList headerLabels;
-  QList<int> sensitiveAttributes;
   SmartAttributesList attributes;
 
+  //health of the displayed attributes, evaluated on each update
+  SmartHealthEvaluator evaluator;
+  SmartHealth health;
+
+  void evaluateHealth();
+
 public slots:
   void configChanged();
 };
@@ -22,6 +22,13 @@
 #include "ui_mainwindow.h"
 
 #include <QIcon>
+#include <QDialog>
+#include <QDialogButtonBox>
+#include <QFileDialog>
+#include <QFontDatabase>
+#include <QMessageBox>
+#include <QPlainTextEdit>
+#include <QVBoxLayout>
 #include <KHelpMenu>
 #include <KLocalizedString>
 
@@ -31,6 +38,9 @@
 
 #include "diskmonitor_settings.h"
 #include "configdialog.h"
+#include "unitscheduler.h"
+#include "healthruleengine.h"
+#include "tracer.h"
 
 
 #include <QDebug>
@@ -45,6 +55,22 @@ MainWindow::MainWindow(QWidget* parent) :
 {
   ui -> setupUi(this);
 
+#ifdef DISKMONITOR_TRACING
+  /*
+   * setup the debug menu, exposing the trace of the refresh cycles
+   */
+  QMenu* debugMenu = menuBar() -> addMenu(i18n("&Debug"));
+
+  QAction* recordAction = debugMenu -> addAction(i18n("&Record Trace"));
+  recordAction -> setCheckable(true);
+  recordAction -> setChecked(Tracer::instance() -> isRecording());
+  connect(recordAction, SIGNAL(toggled(bool)), this, SLOT(setTraceRecording(bool)));
+
+  connect(debugMenu -> addAction(i18n("&Save Trace...")), SIGNAL(triggered()), this, SLOT(saveTrace()));
+  connect(debugMenu -> addAction(i18n("DBus &Latencies...")), SIGNAL(triggered()), this, SLOT(showLatencies()));
+#endif
+
+
   /*
    * setup KDE default help menu
    */
@@ -70,6 +96,7 @@ MainWindow::MainWindow(QWidget* parent) :
 
   //connect(ui -> listView, SIGNAL(activated(QModelIndex)), this, SLOT(unitSelected(QModelIndex)));
   connect(ui -> listView -> selectionModel(), SIGNAL(currentChanged(QModelIndex,QModelIndex)), this, SLOT(unitSelected(QModelIndex)));
+  connect(UDisks2Wrapper::instance(), SIGNAL(storageUnitAdded(StorageUnit*)), this, SLOT(storageUnitAdded(StorageUnit*)));
   connect(UDisks2Wrapper::instance(), SIGNAL(storageUnitRemoved(StorageUnit*)), this, SLOT(storageUnitRemoved(StorageUnit*)));
 
 
@@ -94,6 +121,12 @@ MainWindow::MainWindow(QWidget* parent) :
    */
   connect(ui -> actionSettings, SIGNAL(triggered()), this, SLOT(showSettings()));
   connect(DiskMonitorSettings::self(), SIGNAL(configChanged()), this, SLOT(configChanged()));
+  UDisks2Wrapper::instance() -> setCallTimeout(DiskMonitorSettings::callTimeout() * 1000);
+  HealthRuleEngine::instance() -> setRules(DiskMonitorSettings::failingRule(), DiskMonitorSettings::warningRule());
+
+  //keep the units up to date while the window is open, unless diskmonitord already polls them
+  if(!storageUnitModel -> isDaemonUsed())
+    UDisks2Wrapper::instance() -> getScheduler() -> start();
 
 
   //autosave config activation
@@ -142,20 +175,24 @@ void MainWindow::closeEvent(QCloseEvent* event)
 /*
  * Set the select unit
  *
+ * Units are listed asynchronously, if the unit is not yet available the selection
+ * is delayed until the unit is added
+ *
  * @param path The unit path
  */
 void MainWindow::setSelectedUnit(const QString& path)
 {
-  QList<StorageUnit*> units = UDisks2Wrapper::instance() -> listStorageUnits();
+  pendingSelection = path;
+
+  for(int i = 0; i < storageUnitModel -> rowCount(QModelIndex()); i++) {
+    QModelIndex index = storageUnitModel -> index(i, 0);
+    StorageUnit* u = index.data(Qt::UserRole).value<StorageUnit*>();
 
-  int i = 0;
-  foreach(StorageUnit* u, units) {
-    if(u -> getPath() == path) {
-      ui -> listView -> setCurrentIndex(storageUnitModel -> index(i, 0));
+    if(u != nullptr && u -> getPath() == path) {
+      pendingSelection.clear();
+      ui -> listView -> setCurrentIndex(index);
       break;
     }
-
-    i++;
   }
 }
 
@@ -221,6 +258,17 @@ void MainWindow::updateCurrentUnit(StorageUnit* unit)
 
 
 
+/*
+ * Handle new unit, selecting it if it has been requested before being available
+ */
+void MainWindow::storageUnitAdded(StorageUnit* unit)
+{
+  if(!pendingSelection.isEmpty() && unit -> getPath() == pendingSelection)
+    setSelectedUnit(pendingSelection);
+}
+
+
+
 /*
  * Handle hot unplug of selected unit
  */
@@ -266,6 +314,11 @@ void MainWindow::updateHealthStatus(StorageUnit* unit)
     text = i18nc("Failing health status", "Failing");
     icon = QIcon::fromTheme(iconProvider.failing()).pixmap(QSize(16,16));
 
+  } else if(unit -> isWarning()) {
+    style = "QLabel { color: " + DiskMonitorSettings::warningColor().name() + "; }";
+    text = i18nc("Warning health status", "Warning");
+    icon = QIcon::fromTheme(iconProvider.healthy()).pixmap(QSize(16,16));
+
   } else {
     text = i18nc("Healthy health status", "Healthy");
     icon = QIcon::fromTheme(iconProvider.healthy()).pixmap(QSize(16,16));
@@ -295,6 +348,69 @@ void MainWindow::configChanged()
 {
   qDebug() << "DiskMonitor::MainWindow - Configuration changed, updating UI...";
 
+  UDisks2Wrapper::instance() -> setCallTimeout(DiskMonitorSettings::callTimeout() * 1000);
+  HealthRuleEngine::instance() -> setRules(DiskMonitorSettings::failingRule(), DiskMonitorSettings::warningRule());
   storageUnitModel -> refresh();
 }
 
+
+
+
+/*
+ * Start or stop the recording of the trace events, starting a new trace
+ */
+void MainWindow::setTraceRecording(bool recording)
+{
+  if(recording)
+    Tracer::instance() -> reset();
+
+  Tracer::instance() -> setRecording(recording);
+}
+
+
+
+/*
+ * Save the recorded trace events in the Chrome trace event format
+ */
+void MainWindow::saveTrace()
+{
+  QString fileName = QFileDialog::getSaveFileName(this, i18n("Save Trace"), "diskmonitor-trace.json",
+                                                  i18n("Chrome trace (*.json)"));
+  if(fileName.isEmpty())
+    return;
+
+  if(!Tracer::instance() -> writeChromeTrace(fileName))
+    QMessageBox::warning(this, i18n("Save Trace"), i18n("Unable to write the trace to %1", fileName));
+}
+
+
+
+/*
+ * Display the latency histograms of the DBus calls, and the number of calls per caller
+ */
+void MainWindow::showLatencies()
+{
+  QString report = Tracer::instance() -> latencyReport();
+
+  report += "\n";
+  foreach(const DBusCallCount& c, UDisks2Wrapper::instance() -> getCallCounts())
+    report += QString("%1 %2\n").arg(c.interface + "." + c.member + " from " + c.caller, -80).arg(c.count, 8);
+
+  QDialog dialog(this);
+  dialog.setWindowTitle(i18n("DBus Latencies"));
+
+  QPlainTextEdit* text = new QPlainTextEdit(report, &dialog);
+  text -> setReadOnly(true);
+  text -> setLineWrapMode(QPlainTextEdit::NoWrap);
+  text -> setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+
+  QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Close, &dialog);
+  connect(buttons, SIGNAL(rejected()), &dialog, SLOT(reject()));
+
+  QVBoxLayout* layout = new QVBoxLayout(&dialog);
+  layout -> addWidget(text);
+  layout -> addWidget(buttons);
+
+  dialog.resize(900, 400);
+  dialog.exec();
+}
@@ -55,6 +55,7 @@ private:
 
   StorageUnit* currentUnit = nullptr;
   StorageUnitModel* storageUnitModel;
+  QString pendingSelection;
 
   Settings::IconProvider iconProvider;
 
@@ -62,12 +63,17 @@ private:
 
 public slots:
   void unitSelected(const QModelIndex& index);
+  void storageUnitAdded(StorageUnit* unit);
   void storageUnitRemoved(StorageUnit* unit);
   void updateHealthStatus(StorageUnit* unit);
 
   void refreshDetails();
   void showSettings();
   void configChanged();
+
+  void setTraceRecording(bool recording);
+  void saveTrace();
+  void showLatencies();
 };
 
 #endif // MAINWINDOW_H
@@ -77,7 +77,39 @@ void MDRaidMembersModel::updateInternalState()
 
 
 /*
- * Get the number of rows contained in the model's data. Always 1
+ * Key identifying the row of a member: its slot, and its block device
+ * for the spares which all have the slot -1
+ */
+static QPair<qint32, QString> memberKey(const MDRaidMember& member)
+{
+  return qMakePair(member.slot, member.block.path());
+}
+
+
+
+/*
+ * Test if two values of a member are displayed the same way
+ */
+static bool sameMember(const MDRaidMember& a, const MDRaidMember& b)
+{
+  return a.state == b.state && a.numReadErrors == b.numReadErrors;
+}
+
+
+
+/*
+ * Handle an update of the raid array, notifying only the members which changed
+ */
+void MDRaidMembersModel::updateModel()
+{
+  MDRaid* mdraid = getMDRaid();
+  updateRows(members, mdraid != nullptr ? mdraid -> getMembers() : MDRaidMemberList(), memberKey, sameMember);
+}
+
+
+
+/*
+ * Get the number of rows contained in the model's data
  */
 int MDRaidMembersModel::rowCount(const QModelIndex& /*index*/) const
 {
@@ -46,6 +46,7 @@ public:
 
 protected:
   virtual void updateInternalState() override;
+  virtual void updateModel() override;
 
 private:
   QStringList headerLabels;
@@ -97,18 +97,40 @@ void MDRaidPanel::updateUI()
   ui -> startScrubButton -> setEnabled(!running);
 
   if(raid != nullptr) {
-    double completed = raid -> getSyncCompleted();
-    ui -> progressBar -> setValue(completed * 100);
+    updateProgress();
     ui -> cancelScrubButton -> setVisible(raid -> getSyncAction() == "check");
 
     //force height of attributesView to be minimal
     enforceAttributesViewSize();
   } else {
     ui -> progressBar -> setValue(0);
+    ui -> progressBar -> setToolTip(QString());
     ui -> cancelScrubButton -> setVisible(false);
   }
 
-  this -> modelMembers -> setStorageUnit(raid);
+  //the members model follows the updates of its raid, only reset it on a new selection
+  if(this -> modelMembers -> getStorageUnit() != raid)
+    this -> modelMembers -> setStorageUnit(raid);
+}
+
+
+
+/*
+ * Update the scrubbing progress bar, from the raid's job if UDisks2
+ * reports its progress or from the raid's SyncCompleted property
+ */
+void MDRaidPanel::updateProgress()
+{
+  MDRaid* raid = getMDRaid();
+  if(raid == nullptr)
+    return;
+
+  double progress = raid -> getJobProgress();
+  if(progress < 0)
+    progress = raid -> getSyncCompleted();
+
+  ui -> progressBar -> setValue(progress * 100);
+  ui -> progressBar -> setToolTip(jobToolTip(raid));
 }
 
 
@@ -120,7 +142,7 @@ bool MDRaidPanel::isOperationRunning()
 {
   MDRaid* raid = getMDRaid();
 
-  return !(raid == nullptr || raid -> getSyncAction() == "idle");
+  return raid != nullptr && raid -> isOperationRunning();
 }
 
 
@@ -63,6 +63,16 @@ MDRaid* MDRaidPropertiesModel::getMDRaid() const
 
 
 
+/*
+ * Handle an update of the raid array, the single row being updated in place
+ */
+void MDRaidPropertiesModel::updateModel()
+{
+  emitRowsChanged(0, 0);
+}
+
+
+
 /*
  * Get the number of rows contained in the model's data. Always 1
  */
@@ -44,6 +44,9 @@ public:
   virtual QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
   virtual QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
 
+protected:
+  virtual void updateModel() override;
+
 private:
   QStringList headerLabels;
 };
@@ -21,9 +21,14 @@
 #include "storageunitmodel.h"
 
 #include "udisks2wrapper.h"
+#include "daemonclient.h"
+#include "unitscheduler.h"
+#include "diskmonitor_debug.h"
+#include "tracer.h"
 
 #include <QPixmap>
 #include <KIconLoader>
+#include <KLocalizedString>
 
 #include <QDebug>
 
@@ -37,6 +42,9 @@ const QSize& StorageUnitModel::ItemSize = QSize(150, 100);
 
 /*
  * Constructor
+ *
+ * The panels need the full data of the units, which are always read locally. When
+ * diskmonitord is running, the units are only refreshed on a change detected by the daemon
  */
 StorageUnitModel::StorageUnitModel()
 {
@@ -45,6 +53,13 @@ StorageUnitModel::StorageUnitModel()
   UDisks2Wrapper* udisks2 = UDisks2Wrapper::instance();
   connect(udisks2, SIGNAL(storageUnitAdded(StorageUnit*)), this, SLOT(storageUnitAdded(StorageUnit*)));
   connect(udisks2, SIGNAL(storageUnitRemoved(StorageUnit*)), this, SLOT(storageUnitRemoved(StorageUnit*)));
+  connect(udisks2, SIGNAL(storageUnitsRefreshed()), this, SLOT(storageUnitsRefreshed()));
+
+  if(DaemonClient::isDaemonRunning()) {
+    client = new DaemonClient(this);
+    connect(client, SIGNAL(unitChanged(QDBusObjectPath)), this, SLOT(daemonUnitChanged(QDBusObjectPath)));
+    connect(client, SIGNAL(daemonLost()), this, SLOT(daemonLost()));
+  }
 }
 
 
@@ -65,37 +80,44 @@ StorageUnitModel::~StorageUnitModel()
 void StorageUnitModel::init() {
   UDisks2Wrapper* udisks2 = UDisks2Wrapper::instance();
 
-  inhibitUpdate = true;
+  TRACE_SCOPE("model", "StorageUnitModel::reset");
   beginResetModel();
 
   storageUnits.clear();
   QList<StorageUnit*> units = udisks2 -> listStorageUnits();
 
+  //units are updated by the wrapper when they are added, and new ones
+  //are notified with storageUnitAdded()
   foreach(StorageUnit* u, units) {
-    u -> update();
     storageUnits.append(u);
     connect(u, SIGNAL(updated(StorageUnit*)), this, SLOT(storageUnitUpdated(StorageUnit*)));
   }
 
   endResetModel();
-  inhibitUpdate = false;
 }
 
 
 
 /*
  * Refresh the internal state
+ *
+ * Units are refreshed concurrently, the rows being updated at once
+ * by StorageUnitModel::storageUnitsRefreshed() at the end of the cycle
  */
 void StorageUnitModel::refresh() {
-  qDebug() << "DiskMonitor::StorageUnitModel - refreshing...";
+  qCDebug(DISKMONITOR_MODEL) << "DiskMonitor::StorageUnitModel - refreshing...";
 
-  inhibitUpdate = true;
-  beginResetModel();
-  foreach(StorageUnit* u, storageUnits) {
-    u -> update();
-  }
-  endResetModel();
-  inhibitUpdate = false;
+  UDisks2Wrapper::instance() -> refreshStorageUnits();
+}
+
+
+
+/*
+ * Test if the units are polled by diskmonitord, the local polling being then useless
+ */
+bool StorageUnitModel::isDaemonUsed() const
+{
+  return client != nullptr;
 }
 
 
@@ -125,7 +147,21 @@ QVariant StorageUnitModel::data(const QModelIndex &index, int role) const
 
   } else if(role == Qt::DisplayRole || role == Qt::ToolTipRole) {
     QString dev = u -> getDevice().split("/").last();
-    return QVariant(dev + " (" + u -> getShortName() + ")");
+    QString text = dev + " (" + u -> getShortName() + ")";
+
+    if(role == Qt::ToolTipRole && u -> isUnresponsive())
+      text += "\n" + i18n("Not responding");
+
+    if(role == Qt::ToolTipRole && u -> isWarning())
+      text += "\n" + i18n("Matching the warning rule");
+
+    if(role == Qt::ToolTipRole && u -> isDrive()) {
+      Drive* drive = static_cast<Drive*>(u);
+      if(drive -> isStandby())
+        text += "\n" + i18n("Standby, data from %1", QLocale().toString(drive -> getStaleSince(), QLocale::ShortFormat));
+    }
+
+    return QVariant(text);
 
   } else if(role == Qt::DecorationRole) {
 
@@ -200,7 +236,8 @@ void StorageUnitModel::storageUnitRemoved(StorageUnit* unit)
  */
 void StorageUnitModel::storageUnitUpdated(StorageUnit* unit)
 {
-  if(inhibitUpdate)
+  //handled at the end of the refresh cycle
+  if(UDisks2Wrapper::instance() -> isRefreshing())
     return;
 
   QVector<int> roles;
@@ -212,3 +249,53 @@ void StorageUnitModel::storageUnitUpdated(StorageUnit* unit)
     emit dataChanged(idx, idx, roles);
   }
 }
+
+
+
+/*
+ * Handle the end of a refresh cycle, updating every row at once
+ */
+void StorageUnitModel::storageUnitsRefreshed()
+{
+  if(storageUnits.isEmpty())
+    return;
+
+  TRACE_SCOPE("model", "StorageUnitModel::storageUnitsRefreshed");
+
+  QVector<int> roles;
+  roles << Qt::DisplayRole << Qt::DecorationRole << Qt::ToolTipRole;
+  emit dataChanged(createIndex(0, 0), createIndex(storageUnits.size() - 1, 0), roles);
+}
+
+
+
+/*
+ * Refresh the unit whose health changed according to diskmonitord
+ */
+void StorageUnitModel::daemonUnitChanged(const QDBusObjectPath& objectPath)
+{
+  foreach(StorageUnit* u, storageUnits) {
+    if(u -> getObjectPath() == objectPath) {
+      u -> update();
+      return;
+    }
+  }
+}
+
+
+
+/*
+ * Handle the exit of diskmonitord, the units being then polled by the local
+ * scheduler and refreshed at once
+ */
+void StorageUnitModel::daemonLost()
+{
+  qCWarning(DISKMONITOR_MODEL) << "DiskMonitor::StorageUnitModel - diskmonitord stopped, polling the units locally";
+
+  client -> disconnect(this);
+  client -> deleteLater();
+  client = nullptr;
+
+  UDisks2Wrapper::instance() -> getScheduler() -> start();
+  refresh();
+}
@@ -27,6 +27,8 @@
 
 #include "iconprovider.h"
 
+class DaemonClient;
+
 class StorageUnitModel : public QAbstractListModel
 {
   Q_OBJECT
@@ -40,20 +42,27 @@ public:
 
     static const QSize& ItemSize;
 
+    bool isDaemonUsed() const;
+
 public slots:
     void refresh();
 
 private:
-    bool inhibitUpdate = false;
     Settings::IconProvider iconProvider;
     QList<StorageUnit*> storageUnits;
 
+    //client of diskmonitord, following the health changes detected by the daemon
+    DaemonClient* client = nullptr;
+
     void init();
 
 private slots:
     void storageUnitAdded(StorageUnit* unit);
     void storageUnitRemoved(StorageUnit* unit);
     void storageUnitUpdated(StorageUnit* unit);
+    void storageUnitsRefreshed();
+    void daemonUnitChanged(const QDBusObjectPath& objectPath);
+    void daemonLost();
 };
 
 #endif // STORAGEUNITMODEL_H
@@ -21,6 +21,10 @@
 #include "storageunitpanel.h"
 
 #include "udisks2wrapper.h"
+#include "humanize.h"
+
+#include <KLocalizedString>
+#include <QLocale>
 
 /*
  * Constructor
@@ -30,9 +34,6 @@ StorageUnitPanel::StorageUnitPanel(StorageUnitPropertiesModel* model, QWidget* p
   this -> model = model;
 
   connect(UDisks2Wrapper::instance(), SIGNAL(storageUnitRemoved(StorageUnit*)), this, SLOT(storageUnitRemoved(StorageUnit*)));
-
-  this -> autorefreshTimer = new QTimer();
-  connect(autorefreshTimer, SIGNAL(timeout()), this, SLOT(refresh()));
 }
 
 
@@ -48,13 +49,25 @@ StorageUnitPanel::~StorageUnitPanel()
 
 
 /*
- * Set the StorageUnit. Call updateUI and handle auto-refresh if needed
+ * Set the StorageUnit and call updateUI. The unit is kept up to date by the
+ * wrapper's scheduler, the progress of a running operation being notified
+ * by the unit's job
  */
 void StorageUnitPanel::setStorageUnit(StorageUnit* unit)
 {
+  StorageUnit* oldUnit = this -> model -> getStorageUnit();
+  if(oldUnit != nullptr) {
+    disconnect(oldUnit, SIGNAL(updated(StorageUnit*)), this, SLOT(storageUnitUpdated(StorageUnit*)));
+    disconnect(oldUnit, SIGNAL(jobChanged(StorageUnit*)), this, SLOT(storageUnitJobChanged(StorageUnit*)));
+  }
+
+  if(unit != nullptr) {
+    connect(unit, SIGNAL(updated(StorageUnit*)), this, SLOT(storageUnitUpdated(StorageUnit*)));
+    connect(unit, SIGNAL(jobChanged(StorageUnit*)), this, SLOT(storageUnitJobChanged(StorageUnit*)));
+  }
+
   this -> model -> setStorageUnit(unit);
   updateUI();
-  updateAutoRefreshTimer();
 }
 
 
@@ -66,7 +79,6 @@ void StorageUnitPanel::refresh()
 {
   this -> model -> refreshAll();
   updateUI();
-  updateAutoRefreshTimer();
 }
 
 
@@ -83,16 +95,44 @@ void StorageUnitPanel::storageUnitRemoved(StorageUnit* unit)
 
 
 /*
- * Auto-refresh enabling/disabling routine
+ * Handle changes of the current unit notified by the backend
  */
-void StorageUnitPanel::updateAutoRefreshTimer()
+void StorageUnitPanel::storageUnitUpdated(StorageUnit* /*unit*/)
 {
-  bool running = isOperationRunning();
+  updateUI();
+}
+
+
 
-  if(running && !autorefreshTimer -> isActive())
-    autorefreshTimer -> start(1000);
-  else if(!running && autorefreshTimer -> isActive())
-    autorefreshTimer -> stop();
+/*
+ * Handle changes of the job running on the current unit
+ */
+void StorageUnitPanel::storageUnitJobChanged(StorageUnit* /*unit*/)
+{
+  updateProgress();
 }
 
 
+
+/*
+ * Build a tooltip describing the job running on the unit (expected end, rate)
+ *
+ * @param unit The unit, can be NULL
+ * @return The tooltip, empty if no job is running or nothing is known about it
+ */
+QString StorageUnitPanel::jobToolTip(const StorageUnit* unit) const
+{
+  if(unit == nullptr || !unit -> hasJob())
+    return QString();
+
+  QStringList lines;
+
+  QDateTime end = unit -> getJobExpectedEndTime();
+  if(end.isValid())
+    lines << i18n("Expected end: %1", QLocale().toString(end, QLocale::ShortFormat));
+
+  if(unit -> getJobRate() > 0)
+    lines << i18n("Rate: %1/s", Humanize::size(unit -> getJobRate()));
+
+  return lines.join("\n");
+}
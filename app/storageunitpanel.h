@@ -31,7 +31,7 @@
 /*
  * Base class to implement a panel displaying information for a StorageUnit
  *
- * Handle refreshing the internal data, and auto refresh during a running operation
+ * Handle refreshing the internal data
  */
 class StorageUnitPanel : public QWidget
 {
@@ -48,14 +48,16 @@ protected:
   virtual bool isOperationRunning() { return false; }
   virtual void updateUI() { }
 
-private:
-  QTimer* autorefreshTimer;
+  //update the progress of the running operation, called on each change of the unit's job
+  virtual void updateProgress() { }
 
-  void updateAutoRefreshTimer();
+  QString jobToolTip(const StorageUnit* unit) const;
 
 public slots:
   void refresh();
   void storageUnitRemoved(StorageUnit* unit);
+  void storageUnitUpdated(StorageUnit* unit);
+  void storageUnitJobChanged(StorageUnit* unit);
 };
 
 #endif // STORAGEUNITPANEL_H
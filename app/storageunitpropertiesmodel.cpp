@@ -80,6 +80,17 @@ StorageUnit* StorageUnitPropertiesModel::getStorageUnit()
  * Handle storage unit updated
  */
 void StorageUnitPropertiesModel::storageUnitUpdate(StorageUnit* /*unit*/)
+{
+  updateModel();
+}
+
+
+
+/*
+ * Update the model after a change of the unit. Reset the model by default,
+ * subclasses notifying only the changed rows with updateRows()
+ */
+void StorageUnitPropertiesModel::updateModel()
 {
   beginResetModel();
   updateInternalState();
@@ -88,6 +99,16 @@ void StorageUnitPropertiesModel::storageUnitUpdate(StorageUnit* /*unit*/)
 
 
 
+/*
+ * Notify the views of changed values in a range of rows, on every column
+ */
+void StorageUnitPropertiesModel::emitRowsChanged(int first, int last)
+{
+  emit dataChanged(index(first, 0), index(last, columnCount(QModelIndex()) - 1));
+}
+
+
+
 /*
  * Refresh the model's internal data
  */
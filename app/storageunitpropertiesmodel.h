@@ -47,9 +47,135 @@ public:
 protected:
     StorageUnit* unit = nullptr;
     virtual void updateInternalState() { }
+    virtual void updateModel();
+    void emitRowsChanged(int first, int last);
+
+    template<typename T, typename KeyOf, typename Equal>
+    void updateRows(QList<T>& rows, const QList<T>& newRows, KeyOf keyOf, Equal equal);
+
+private:
+    template<typename T, typename Key, typename KeyOf>
+    static int indexOfKey(const QList<T>& rows, const Key& key, KeyOf keyOf, int from);
 
 private slots:
     void storageUnitUpdate(StorageUnit* unit);
 };
 
+
+
+
+/*
+ * Get the position of the row identified by key, starting the search at from
+ *
+ * @return The position of the row, or -1 if not found
+ */
+template<typename T, typename Key, typename KeyOf>
+int StorageUnitPropertiesModel::indexOfKey(const QList<T>& rows, const Key& key, KeyOf keyOf, int from)
+{
+    for(int i = from; i < rows.size(); i++) {
+        if(keyOf(rows.at(i)) == key)
+            return i;
+    }
+
+    return -1;
+}
+
+
+
+/*
+ * Update the rows of the model with a new list, notifying the views with the minimal
+ * removal, move, insertion and change ranges instead of resetting the model. Rows
+ * are identified by their key, the selection and scroll position of the views
+ * being preserved
+ *
+ * @param rows The current rows of the model, updated to newRows
+ * @param newRows The new list of rows
+ * @param keyOf Function returning the key identifying a row
+ * @param equal Function testing if two rows with the same key display the same values
+ */
+template<typename T, typename KeyOf, typename Equal>
+void StorageUnitPropertiesModel::updateRows(QList<T>& rows, const QList<T>& newRows, KeyOf keyOf, Equal equal)
+{
+    QList<decltype(keyOf(T()))> newKeys;
+    foreach(const T& row, newRows)
+        newKeys << keyOf(row);
+
+    //remove the rows which disappeared, by contiguous ranges
+    int last = rows.size() - 1;
+    while(last >= 0) {
+        if(newKeys.contains(keyOf(rows.at(last)))) {
+            last--;
+            continue;
+        }
+
+        int first = last;
+        while(first > 0 && !newKeys.contains(keyOf(rows.at(first - 1))))
+            first--;
+
+        beginRemoveRows(QModelIndex(), first, last);
+        for(int i = last; i >= first; i--)
+            rows.removeAt(i);
+        endRemoveRows();
+
+        last = first - 1;
+    }
+
+    //then walk the new rows, the remaining ones being kept in place, moved or updated
+    int changedFirst = -1;
+    int i = 0;
+    while(i < newRows.size()) {
+        const T& newRow = newRows.at(i);
+
+        int current = indexOfKey(rows, newKeys.at(i), keyOf, i);
+
+        //new rows, inserted at once
+        if(current < 0) {
+            int count = 1;
+            while(i + count < newRows.size() && indexOfKey(rows, newKeys.at(i + count), keyOf, i) < 0)
+                count++;
+
+            if(changedFirst >= 0) {
+                emitRowsChanged(changedFirst, i - 1);
+                changedFirst = -1;
+            }
+
+            beginInsertRows(QModelIndex(), i, i + count - 1);
+            for(int j = 0; j < count; j++)
+                rows.insert(i + j, newRows.at(i + j));
+            endInsertRows();
+
+            i += count;
+            continue;
+        }
+
+        //row moved up to its new position
+        if(current != i) {
+            if(changedFirst >= 0) {
+                emitRowsChanged(changedFirst, i - 1);
+                changedFirst = -1;
+            }
+
+            beginMoveRows(QModelIndex(), current, current, QModelIndex(), i);
+            rows.move(current, i);
+            endMoveRows();
+        }
+
+        //row kept, changed rows being notified by contiguous ranges
+        if(!equal(rows.at(i), newRow)) {
+            rows[i] = newRow;
+            if(changedFirst < 0)
+                changedFirst = i;
+
+        } else if(changedFirst >= 0) {
+            emitRowsChanged(changedFirst, i - 1);
+            changedFirst = -1;
+        }
+
+        i++;
+    }
+
+    if(changedFirst >= 0)
+        emitRowsChanged(changedFirst, rows.size() - 1);
+}
+
 #endif // STORAGEUNITPROPERTIESMODEL_H
@@ -0,0 +1,260 @@
+/****************************************************************************
+ * DisKMonitor, KDE tools to monitor SMART and MDRaid health status         *
+ * Copyright (C) 2014-2015 Michaël Lhomme <papylhomme@gmail.com>            *
+ *                                                                          *
+ * This program is free software; you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation; either version 2 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License along  *
+ * with this program; if not, write to the Free Software Foundation, Inc.,  *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.              *
+ ****************************************************************************/
+
+
+
+#include "diskmonitordaemon.h"
+
+#include "diskmonitor_adaptor.h"
+#include "daemonclient.h"
+#include "remoteunit.h"
+#include "udisks2wrapper.h"
+#include "unitscheduler.h"
+#include "diskmonitor_debug.h"
+
+#include <QDBusConnection>
+#include <QDateTime>
+#include <QDebug>
+
+
+
+/*
+ * Constructor. Start polling the storage units
+ *
+ * @param slowInterval The polling interval of the idle and healthy units, in milliseconds
+ * @param callTimeout The deadline of the UDisks2 calls, in milliseconds
+ * @param snapshotFile The shared memory snapshot file, not published if empty
+ * @param historyFile The history file, not recorded if empty
+ */
+DiskMonitorDaemon::DiskMonitorDaemon(int slowInterval, int callTimeout, const QString& snapshotFile, const QString& historyFile) : QObject()
+{
+  new DiskMonitorAdaptor(this);
+
+  if(!snapshotFile.isEmpty()) {
+    snapshotWriter = new HealthSnapshotWriter(snapshotFile);
+    if(!snapshotWriter -> open()) {
+      delete snapshotWriter;
+      snapshotWriter = nullptr;
+    }
+  }
+
+  if(!historyFile.isEmpty()) {
+    historyStore = new HistoryStore(historyFile);
+    if(!historyStore -> open()) {
+      delete historyStore;
+      historyStore = nullptr;
+    }
+  }
+
+  snapshotTimer.setSingleShot(true);
+  snapshotTimer.setInterval(DAEMON_SNAPSHOT_DELAY);
+  connect(&snapshotTimer, SIGNAL(timeout()), this, SLOT(writeSnapshot()));
+
+  refreshTimer.setSingleShot(true);
+  connect(&refreshTimer, SIGNAL(timeout()), this, SLOT(startRefresh()));
+
+  UDisks2Wrapper* udisks2 = UDisks2Wrapper::instance();
+  connect(udisks2, SIGNAL(storageUnitAdded(StorageUnit*)), this, SLOT(storageUnitAdded(StorageUnit*)));
+  connect(udisks2, SIGNAL(storageUnitRemoved(StorageUnit*)), this, SLOT(storageUnitRemoved(StorageUnit*)));
+  connect(udisks2, SIGNAL(storageUnitsRefreshed()), this, SLOT(storageUnitsRefreshed()));
+
+  udisks2 -> setCallTimeout(callTimeout);
+
+  //the list may be empty at this point, units are then added asynchronously
+  foreach(StorageUnit* unit, udisks2 -> listStorageUnits())
+    storageUnitAdded(unit);
+
+  udisks2 -> getScheduler() -> setSlowInterval(slowInterval);
+  udisks2 -> getScheduler() -> start();
+}
+
+
+
+/*
+ * Destructor
+ */
+DiskMonitorDaemon::~DiskMonitorDaemon()
+{
+  delete snapshotWriter;
+  delete historyStore;
+}
+
+
+
+/*
+ * Export the daemon on the system bus
+ *
+ * @return true on success
+ */
+bool DiskMonitorDaemon::registerOnBus()
+{
+  QDBusConnection bus = QDBusConnection::systemBus();
+
+  if(!bus.registerObject(DISKMONITORD_PATH, this)) {
+    qCCritical(DISKMONITOR_MODEL) << "diskmonitord => Unable to register object: " << bus.lastError().message();
+    return false;
+  }
+
+  if(!bus.registerService(DISKMONITORD_SERVICE)) {
+    qCCritical(DISKMONITOR_MODEL) << "diskmonitord => Unable to register service: " << bus.lastError().message();
+    return false;
+  }
+
+  return true;
+}
+
+
+
+/*
+ * Get the generation of the snapshot, incremented on each change of a unit
+ */
+qulonglong DiskMonitorDaemon::getGeneration() const
+{
+  return generation;
+}
+
+
+
+/*
+ * DBus method returning the health snapshot of every unit
+ */
+UnitHealthList DiskMonitorDaemon::GetUnits() const
+{
+  UnitHealthList units;
+
+  foreach(StorageUnit* unit, snapshots.keys())
+    units[unit -> getObjectPath()] = snapshots[unit];
+
+  return units;
+}
+
+
+
+/*
+ * DBus method refreshing every unit, Refreshed() being emitted at the end of the cycle.
+ * Concurrent requests join the running cycle
+ *
+ * Any user being allowed to call it, the requests are rate limited: a request received
+ * less than DAEMON_REFRESH_MIN_INTERVAL after the start of the last cycle is delayed,
+ * the requests received meanwhile being coalesced in this single cycle
+ */
+void DiskMonitorDaemon::Refresh()
+{
+  if(refreshTimer.isActive())
+    return;
+
+  qint64 elapsed = QDateTime::currentMSecsSinceEpoch() - lastRefresh;
+  if(elapsed >= DAEMON_REFRESH_MIN_INTERVAL || elapsed < 0)
+    startRefresh();
+  else
+    refreshTimer.start((int) (DAEMON_REFRESH_MIN_INTERVAL - elapsed));
+}
+
+
+
+/*
+ * Start a refresh cycle requested by DiskMonitorDaemon::Refresh()
+ */
+void DiskMonitorDaemon::startRefresh()
+{
+  lastRefresh = QDateTime::currentMSecsSinceEpoch();
+  UDisks2Wrapper::instance() -> refreshStorageUnits();
+}
+
+
+
+/*
+ * Update the snapshot of the unit, notifying the clients if its health changed. The
+ * shared memory snapshot, holding more volatile data, is written on every update
+ */
+void DiskMonitorDaemon::publish(StorageUnit* unit)
+{
+  if(snapshotWriter != nullptr && !snapshotTimer.isActive())
+    snapshotTimer.start();
+
+  QVariantMap health = RemoteUnit::snapshot(unit);
+  if(snapshots.value(unit) == health)
+    return;
+
+  snapshots[unit] = health;
+  generation++;
+
+  emit UnitChanged(unit -> getObjectPath(), health);
+}
+
+
+
+/*
+ * Handle StorageUnit added
+ */
+void DiskMonitorDaemon::storageUnitAdded(StorageUnit* unit)
+{
+  connect(unit, SIGNAL(updated(StorageUnit*)), this, SLOT(storageUnitUpdated(StorageUnit*)));
+  publish(unit);
+}
+
+
+
+/*
+ * Handle StorageUnit removed
+ */
+void DiskMonitorDaemon::storageUnitRemoved(StorageUnit* unit)
+{
+  if(snapshots.remove(unit) == 0)
+    return;
+
+  generation++;
+  emit UnitRemoved(unit -> getObjectPath());
+
+  if(snapshotWriter != nullptr && !snapshotTimer.isActive())
+    snapshotTimer.start();
+}
+
+
+
+/*
+ * Handle StorageUnit updated, by the scheduler or a change notified by UDisks2
+ */
+void DiskMonitorDaemon::storageUnitUpdated(StorageUnit* unit)
+{
+  if(historyStore != nullptr)
+    historyStore -> record(unit, QDateTime::currentMSecsSinceEpoch());
+
+  publish(unit);
+}
+
+
+
+/*
+ * Handle the end of a refresh cycle
+ */
+void DiskMonitorDaemon::storageUnitsRefreshed()
+{
+  emit Refreshed();
+}
+
+
+
+/*
+ * Write the shared memory snapshot of every unit
+ */
+void DiskMonitorDaemon::writeSnapshot()
+{
+  snapshotWriter -> publish(snapshots.keys());
+}
@@ -0,0 +1,100 @@
+/****************************************************************************
+ * DisKMonitor, KDE tools to monitor SMART and MDRaid health status         *
+ * Copyright (C) 2014-2015 Michaël Lhomme <papylhomme@gmail.com>            *
+ *                                                                          *
+ * This program is free software; you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation; either version 2 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License along  *
+ * with this program; if not, write to the Free Software Foundation, Inc.,  *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.              *
+ ****************************************************************************/
+
+
+
+#ifndef DISKMONITORDAEMON_H
+#define DISKMONITORDAEMON_H
+
+#include <QObject>
+#include <QHash>
+#include <QTimer>
+
+#include "dbus_metatypes.h"
+
+#include "storageunit.h"
+#include "healthsnapshot.h"
+#include "historystore.h"
+
+
+//delay coalescing the writes of the shared memory snapshot, in milliseconds
+#define DAEMON_SNAPSHOT_DELAY 100
+
+//minimal delay between two refresh cycles requested by the clients, in milliseconds
+#define DAEMON_REFRESH_MIN_INTERVAL 60000
+
+
+
+/*
+ * diskmonitord main object, exported on the system bus by DiskMonitorAdaptor
+ *
+ * Poll the storage units with the wrapper's scheduler and maintain a health
+ * snapshot, every change being notified to the clients with UnitChanged()
+ */
+class DiskMonitorDaemon : public QObject
+{
+  Q_OBJECT
+  Q_PROPERTY(qulonglong Generation READ getGeneration)
+
+public:
+  explicit DiskMonitorDaemon(int slowInterval, int callTimeout, const QString& snapshotFile, const QString& historyFile);
+  ~DiskMonitorDaemon();
+
+  bool registerOnBus();
+
+  qulonglong getGeneration() const;
+
+public slots:
+  UnitHealthList GetUnits() const;
+  void Refresh();
+
+private:
+  //last snapshot sent to the clients
+  QHash<StorageUnit*, QVariantMap> snapshots;
+
+  qulonglong generation = 0;
+
+  //shared memory snapshot, written by writeSnapshot() once the changes are coalesced
+  HealthSnapshotWriter* snapshotWriter = nullptr;
+  QTimer snapshotTimer;
+
+  //requested refresh, delayed by the rate limit
+  QTimer refreshTimer;
+  qint64 lastRefresh = 0;
+
+  //time series of the attributes and raid counters, recorded on each update
+  HistoryStore* historyStore = nullptr;
+
+  void publish(StorageUnit* unit);
+
+private slots:
+  void storageUnitAdded(StorageUnit* unit);
+  void storageUnitRemoved(StorageUnit* unit);
+  void storageUnitUpdated(StorageUnit* unit);
+  void storageUnitsRefreshed();
+  void writeSnapshot();
+  void startRefresh();
+
+signals:
+  void UnitChanged(const QDBusObjectPath& unit, const QVariantMap& health);
+  void UnitRemoved(const QDBusObjectPath& unit);
+  void Refreshed();
+};
+
+#endif // DISKMONITORDAEMON_H
@@ -0,0 +1,67 @@
+/****************************************************************************
+ * DisKMonitor, KDE tools to monitor SMART and MDRaid health status         *
+ * Copyright (C) 2014-2015 Michaël Lhomme <papylhomme@gmail.com>            *
+ *                                                                          *
+ * This program is free software; you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation; either version 2 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License along  *
+ * with this program; if not, write to the Free Software Foundation, Inc.,  *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.              *
+ ****************************************************************************/
+
+
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+
+#include "diskmonitordaemon.h"
+#include "udisks2wrapper.h"
+#include "healthruleengine.h"
+#include "config.h"
+
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+  app.setApplicationName("diskmonitord");
+  app.setApplicationVersion(DISKMONITOR_VERSION);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Poll the storage units once and serve their health status to every DisKMonitor client");
+  parser.addHelpOption();
+  parser.addVersionOption();
+
+  QCommandLineOption intervalOption("interval", "Polling interval of the idle and healthy units, in minutes", "minutes", "5");
+  QCommandLineOption callTimeoutOption("call-timeout", "Deadline of the UDisks2 calls, in seconds", "seconds",
+                                       QString::number(UDISKS2_DEFAULT_CALL_TIMEOUT / 1000));
+  QCommandLineOption snapshotOption("snapshot", "Shared memory health snapshot, empty to disable", "file", HEALTH_SNAPSHOT_FILE);
+  QCommandLineOption historyOption("history", "Time series of the SMART attributes and raid counters, empty to disable", "file",
+                                   HISTORY_STORE_FILE);
+  QCommandLineOption failingRuleOption("failing-rule", "Health rule reporting the matching units as failing, "
+                                       "the rules of the users' settings not being read by the daemon", "rule");
+  QCommandLineOption warningRuleOption("warning-rule", "Health rule reporting the matching units as warning, "
+                                       "the rules of the users' settings not being read by the daemon", "rule");
+
+  parser.addOptions({ intervalOption, callTimeoutOption, snapshotOption, historyOption, failingRuleOption, warningRuleOption });
+  parser.process(app);
+
+  int interval = qMax(parser.value(intervalOption).toInt(), 1);
+  int callTimeout = qBound(1, parser.value(callTimeoutOption).toInt(), 120);
+
+  //shared by every user, the daemon only applies the rules of its command line
+  HealthRuleEngine::instance() -> setRules(parser.value(failingRuleOption), parser.value(warningRuleOption));
+
+  DiskMonitorDaemon daemon(interval * 60 * 1000, callTimeout * 1000, parser.value(snapshotOption), parser.value(historyOption));
+  if(!daemon.registerOnBus())
+    return 1;
+
+  return app.exec();
+}
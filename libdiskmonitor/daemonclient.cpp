@@ -0,0 +1,217 @@
+/****************************************************************************
+ * DisKMonitor, KDE tools to monitor SMART and MDRaid health status         *
+ * Copyright (C) 2014-2015 Michaël Lhomme <papylhomme@gmail.com>            *
+ *                                                                          *
+ * This program is free software; you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation; either version 2 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License along  *
+ * with this program; if not, write to the Free Software Foundation, Inc.,  *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.              *
+ ****************************************************************************/
+
+
+
+#include "daemonclient.h"
+
+#include "diskmonitor_proxy.h"
+
+#include <QDBusConnection>
+#include <QDBusConnectionInterface>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDBusServiceWatcher>
+#include <QDebug>
+
+
+
+/*
+ * Constructor. Retrieve the daemon's snapshot and follow its changes
+ */
+DaemonClient::DaemonClient(QObject* parent) : QObject(parent)
+{
+  qRegisterMetaType<UnitHealthList>("UnitHealthList");
+  qDBusRegisterMetaType<UnitHealthList>();
+
+  QDBusConnection bus = QDBusConnection::systemBus();
+  proxy = new DiskMonitorProxy(DISKMONITORD_SERVICE, DISKMONITORD_PATH, bus, this);
+
+  connect(proxy, SIGNAL(UnitChanged(QDBusObjectPath, QVariantMap)), this, SLOT(daemonUnitChanged(QDBusObjectPath, QVariantMap)));
+  connect(proxy, SIGNAL(UnitRemoved(QDBusObjectPath)), this, SLOT(daemonUnitRemoved(QDBusObjectPath)));
+  connect(proxy, SIGNAL(Refreshed()), this, SLOT(daemonRefreshed()));
+
+  //fetch the snapshot again when the daemon is restarted, and report its exit
+  serviceWatcher = new QDBusServiceWatcher(DISKMONITORD_SERVICE, bus,
+                                           QDBusServiceWatcher::WatchForRegistration | QDBusServiceWatcher::WatchForUnregistration, this);
+  connect(serviceWatcher, &QDBusServiceWatcher::serviceRegistered, this, &DaemonClient::fetchUnits);
+  connect(serviceWatcher, &QDBusServiceWatcher::serviceUnregistered, this, &DaemonClient::daemonUnregistered);
+
+  fetchUnits();
+}
+
+
+
+/*
+ * Destructor
+ */
+DaemonClient::~DaemonClient()
+{
+  qDeleteAll(units);
+}
+
+
+
+/*
+ * Test if diskmonitord is running on the system bus
+ */
+bool DaemonClient::isDaemonRunning()
+{
+  QDBusConnectionInterface* bus = QDBusConnection::systemBus().interface();
+  return bus != nullptr && bus -> isServiceRegistered(DISKMONITORD_SERVICE);
+}
+
+
+
+/*
+ * Get the list of units known by the daemon
+ */
+QList<StorageUnit*> DaemonClient::listStorageUnits() const
+{
+  QList<StorageUnit*> result;
+
+  foreach(RemoteUnit* unit, units)
+    result << unit;
+
+  return result;
+}
+
+
+
+/*
+ * Ask the daemon to refresh every unit, storageUnitsRefreshed() being emitted
+ * at the end of the daemon's cycle
+ */
+void DaemonClient::refreshStorageUnits()
+{
+  refreshing = true;
+  proxy -> Refresh();
+}
+
+
+
+/*
+ * Test if a refresh cycle requested by DaemonClient::refreshStorageUnits() is running
+ */
+bool DaemonClient::isRefreshing() const
+{
+  return refreshing;
+}
+
+
+
+/*
+ * Request the daemon's snapshot, handled by DaemonClient::unitsFetched()
+ */
+void DaemonClient::fetchUnits()
+{
+  QDBusPendingCallWatcher* watcher = new QDBusPendingCallWatcher(proxy -> GetUnits(), this);
+  connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)), this, SLOT(unitsFetched(QDBusPendingCallWatcher*)));
+}
+
+
+
+/*
+ * Synchronize the units with the daemon's snapshot
+ */
+void DaemonClient::unitsFetched(QDBusPendingCallWatcher* call)
+{
+  QDBusPendingReply<UnitHealthList> reply = *call;
+  call -> deleteLater();
+
+  if(reply.isError()) {
+    qWarning() << "DaemonClient => Unable to retrieve the snapshot: " << reply.error().message();
+    return;
+  }
+
+  UnitHealthList snapshot = reply.value();
+
+  foreach(QDBusObjectPath objectPath, units.keys()) {
+    if(!snapshot.contains(objectPath))
+      daemonUnitRemoved(objectPath);
+  }
+
+  foreach(QDBusObjectPath objectPath, snapshot.keys())
+    daemonUnitChanged(objectPath, snapshot[objectPath]);
+}
+
+
+
+/*
+ * Handle the daemon's "UnitChanged" signal, creating the unit if needed
+ *
+ * @param objectPath The UDisks2 node of the unit
+ * @param health The new health snapshot of the unit
+ */
+void DaemonClient::daemonUnitChanged(const QDBusObjectPath& objectPath, const QVariantMap& health)
+{
+  RemoteUnit* unit = units.value(objectPath, nullptr);
+
+  if(unit == nullptr) {
+    unit = new RemoteUnit(objectPath, health);
+    units[objectPath] = unit;
+    emit storageUnitAdded(unit);
+
+  } else if(unit -> readSnapshot(health)) {
+    emit unit -> updated(unit);
+    emit unitChanged(objectPath);
+  }
+}
+
+
+
+/*
+ * Handle the daemon's "UnitRemoved" signal
+ *
+ * @param objectPath The UDisks2 node of the unit
+ */
+void DaemonClient::daemonUnitRemoved(const QDBusObjectPath& objectPath)
+{
+  RemoteUnit* unit = units.take(objectPath);
+  if(unit == nullptr)
+    return;
+
+  emit storageUnitRemoved(unit);
+  unit -> deleteLater();
+}
+
+
+
+/*
+ * Handle the end of a refresh cycle of the daemon
+ */
+void DaemonClient::daemonRefreshed()
+{
+  refreshing = false;
+  emit storageUnitsRefreshed();
+}
+
+
+
+/*
+ * Handle the exit of the daemon. The mirrored units are left as they are, the
+ * owner being expected to switch to local polling on daemonLost()
+ */
+void DaemonClient::daemonUnregistered()
+{
+  qWarning() << "DaemonClient => diskmonitord left the bus";
+
+  refreshing = false;
+  emit daemonLost();
+}
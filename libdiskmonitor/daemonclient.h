@@ -0,0 +1,91 @@
+/****************************************************************************
+ * DisKMonitor, KDE tools to monitor SMART and MDRaid health status         *
+ * Copyright (C) 2014-2015 Michaël Lhomme <papylhomme@gmail.com>            *
+ *                                                                          *
+ * This program is free software; you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation; either version 2 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License along  *
+ * with this program; if not, write to the Free Software Foundation, Inc.,  *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.              *
+ ****************************************************************************/
+
+
+
+#ifndef DAEMONCLIENT_H
+#define DAEMONCLIENT_H
+
+#include <QObject>
+#include <QMap>
+
+#include "dbus_metatypes.h"
+
+#include "remoteunit.h"
+
+
+#define DISKMONITORD_SERVICE "org.papylhomme.DiskMonitor"
+#define DISKMONITORD_PATH "/org/papylhomme/DiskMonitor"
+
+
+class DiskMonitorProxy;
+class QDBusPendingCallWatcher;
+class QDBusServiceWatcher;
+
+
+/*
+ * Client of diskmonitord, the daemon polling the storage units once
+ * for every user
+ *
+ * Mirror the daemon's health snapshot as a list of RemoteUnit, with
+ * the same signals as UDisks2Wrapper
+ */
+class DaemonClient : public QObject
+{
+  Q_OBJECT
+
+public:
+  explicit DaemonClient(QObject* parent = nullptr);
+  ~DaemonClient();
+
+  static bool isDaemonRunning();
+
+  QList<StorageUnit*> listStorageUnits() const;
+  void refreshStorageUnits();
+  bool isRefreshing() const;
+
+private:
+  DiskMonitorProxy* proxy;
+  QDBusServiceWatcher* serviceWatcher;
+
+  QMap<QDBusObjectPath, RemoteUnit*> units;
+  bool refreshing = false;
+
+  void fetchUnits();
+
+private slots:
+  void unitsFetched(QDBusPendingCallWatcher* call);
+  void daemonUnitChanged(const QDBusObjectPath& objectPath, const QVariantMap& health);
+  void daemonUnitRemoved(const QDBusObjectPath& objectPath);
+  void daemonRefreshed();
+  void daemonUnregistered();
+
+signals:
+  void storageUnitAdded(StorageUnit* unit);
+  void storageUnitRemoved(StorageUnit* unit);
+  void storageUnitsRefreshed();
+
+  //the daemon left the bus, the units must then be polled locally
+  void daemonLost();
+
+  //notify a change of the unit's health, with the path to the UDisks2 node
+  void unitChanged(const QDBusObjectPath& objectPath);
+};
+
+#endif // DAEMONCLIENT_H
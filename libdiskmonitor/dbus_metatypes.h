@@ -41,6 +41,14 @@ Q_DECLARE_METATYPE(ManagedObjectList)
 
 
 
+/*
+ * A map of unit (key) with their health snapshot, as exported by diskmonitord
+ */
+typedef QMap<QDBusObjectPath, QVariantMap> UnitHealthList;
+Q_DECLARE_METATYPE(UnitHealthList)
+
+
+
 /*
  * Structure mapping a SMART attribute on UDisks2
  */
@@ -96,4 +104,15 @@ extern QDBusArgument &operator<<(QDBusArgument &argument, const MDRaidMember& sm
 extern const QDBusArgument &operator>>(const QDBusArgument &argument, MDRaidMember& smartAttribue);
 
 
+
+/*
+ * Compare the fields of two members, the expansion data (unused, and holding
+ * QDBusArgument values compared by identity) being ignored
+ */
+inline bool operator==(const MDRaidMember& a, const MDRaidMember& b)
+{
+  return a.block == b.block && a.slot == b.slot && a.state == b.state && a.numReadErrors == b.numReadErrors;
+}
+
+
 #endif // METATYPES_H
@@ -0,0 +1,39 @@
+/****************************************************************************
+ * DisKMonitor, KDE tools to monitor SMART and MDRaid health status         *
+ * Copyright (C) 2014-2015 Michaël Lhomme <papylhomme@gmail.com>            *
+ *                                                                          *
+ * This program is free software; you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation; either version 2 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License along  *
+ * with this program; if not, write to the Free Software Foundation, Inc.,  *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.              *
+ ****************************************************************************/
+
+
+
+#ifndef DISKMONITOR_DEBUG_H
+#define DISKMONITOR_DEBUG_H
+
+#include <QLoggingCategory>
+
+
+
+/*
+ * Logging categories of libdiskmonitor and its clients, filtered at runtime
+ * with QT_LOGGING_RULES (ie. "diskmonitor.udisks2.debug=false")
+ *
+ * Defining QT_NO_DEBUG_OUTPUT compiles the qCDebug() statements out
+ */
+Q_DECLARE_LOGGING_CATEGORY(DISKMONITOR_UDISKS2)
+Q_DECLARE_LOGGING_CATEGORY(DISKMONITOR_MODEL)
+Q_DECLARE_LOGGING_CATEGORY(DISKMONITOR_RULES)
+
+#endif // DISKMONITOR_DEBUG_H
@@ -31,15 +31,19 @@
  *
  * @param objectPath The DBus object path to the UDisks2 node represented by this drive
  * @param device A string identifying the underlying Linux device (/dev/sdX)
- * @param hasATAIface boolean to set if the drive has the UDisks2 ATA interface present
+ * @param interfaces The interfaces of the drive node with their properties, as provided by
+ *                   UDisks2 ObjectManager. Used to fill the properties without calling UDisks2.
+ *                   The SMART attributes are not retrieved here, call Drive::update() to fill them
  *
  * http://udisks.freedesktop.org/docs/latest/gdbus-org.freedesktop.UDisks2.Drive.html
  * http://udisks.freedesktop.org/docs/latest/gdbus-org.freedesktop.UDisks2.Drive.Ata.html
  */
-Drive::Drive(QDBusObjectPath objectPath, QString device, bool hasATAIface) : StorageUnit(objectPath, device)
+Drive::Drive(QDBusObjectPath objectPath, QString device, const InterfaceList& interfaces) : StorageUnit(objectPath, device)
 {
-  this -> hasATAIface = hasATAIface;
-  update();
+  readInterfaces(interfaces);
+
+  if(!interfaces.isEmpty())
+    this -> refreshedAt = QDateTime::currentMSecsSinceEpoch();
 }
 
 
@@ -138,54 +142,198 @@ const SmartAttributesList& Drive::getSMARTAttributes() const
 
 
 /*
- * Update the cached property and SMART attributes of this Drive
+ * Get the cached SMART attributes for the drive, indexed by attribute id
+ */
+const SmartAttributeTable& Drive::getSMARTAttributeTable() const
+{
+  return this -> attributeTable;
+}
+
+
+
+/*
+ * Replace the cached SMART attributes
+ *
+ * @param attributes The attributes retrieved from UDisks2
+ */
+void Drive::setSMARTAttributes(const SmartAttributesList& attributes)
+{
+  this -> attributes = attributes;
+  this -> attributeTable.assign(attributes);
+  this -> attributesOutdated = false;
+}
+
+
+
+/*
+ * Forget the cached SMART attributes
+ */
+void Drive::clearSMARTAttributes()
+{
+  this -> attributes.clear();
+  this -> attributeTable.clear();
+}
+
+
+
+/*
+ * Test if the drive was in standby on the last update, the cached data being
+ * kept to avoid waking it up
+ */
+bool Drive::isStandby() const
+{
+  return this -> standby;
+}
+
+
+
+/*
+ * Get the time the cached data was last refreshed, or an invalid QDateTime
+ * if nothing was retrieved yet
+ */
+QDateTime Drive::getStaleSince() const
+{
+  if(this -> refreshedAt == 0)
+    return QDateTime();
+
+  return QDateTime::fromMSecsSinceEpoch(this -> refreshedAt);
+}
+
+
+
+/*
+ * Test if a SMART SelfTest is running on the drive
+ */
+bool Drive::isOperationRunning() const
+{
+  return this -> selfTestStatus == "inprogress";
+}
+
+
+
+/*
+ * Request an update of the cached properties and SMART attributes of this Drive
+ *
+ * Properties are retrieved with one call per interface, the SMART attributes
+ * are retrieved only when UDisks2 collected new SMART data. A drive in standby
+ * is not woken up and keeps its cached data. The update is done
+ * asynchronously by the wrapper's worker, completion is notified by updated()
+ * Skipped while the unit is unresponsive
+ *
+ * @see Drive::readProperties()
+ * @see Drive::finishUpdate()
  */
 void Drive::update()
 {
-  attributes.clear();
+  //unresponsive unit, only report the cached state until the backoff expires
+  if(isPollingSuspended()) {
+    StorageUnit::update();
+    return;
+  }
 
+  UDisks2Wrapper::instance() -> requestUpdate(this);
+}
 
-  /*
-   * retrieve general properties from the DRIVE_IFACE
-   */
-  QDBusInterface* driveIface = UDisks2Wrapper::instance() -> driveIface(objectPath);
-  this -> removable = getBoolProperty(driveIface, "Removable");
-  this -> shortName = getStringProperty(driveIface, "Model");
-  delete driveIface;
 
-  //Skip smart properties if ATA_IFACE is not present
-  if(!hasATAIface) {
-    this -> failingStatusKnown = false;
+
+/*
+ * Complete an update of the drive
+ *
+ * @param failedInterfaces The interfaces which couldn't be read
+ */
+void Drive::finishUpdate(const QStringList& failedInterfaces)
+{
+  //sleeping drive, keep the last snapshot
+  if(this -> standby) {
+    StorageUnit::finishUpdate(failedInterfaces);
     return;
   }
 
+  if(failedInterfaces.isEmpty())
+    this -> refreshedAt = QDateTime::currentMSecsSinceEpoch();
 
-  /*
-   * retrieve SMART properties from the ATA_IFACE
-   */
-  QDBusInterface* ataIface = UDisks2Wrapper::instance() -> ataIface(objectPath);
-  this -> smartSupported = getBoolProperty(ataIface, "SmartSupported");
-  this -> smartEnabled = getBoolProperty(ataIface, "SmartEnabled");
+  //SMART properties can't be trusted without the ATA_IFACE
+  if(!hasATAIface || failedInterfaces.contains(UDISKS2_ATA_IFACE))
+    this -> failingStatusKnown = false;
 
-  if(this -> smartSupported && this -> smartEnabled) {
-    this -> failing = getBoolProperty(ataIface, "SmartFailing");
-    this -> failingStatusKnown = true;
+  if(!this -> failingStatusKnown)
+    clearSMARTAttributes();
 
+  StorageUnit::finishUpdate(failedInterfaces);
+}
 
-    QDBusReply<SmartAttributesList> res = ataIface -> call("SmartGetAttributes", QVariantMap());
-    if(!res.isValid())
-      qCritical() << "Error calling SmartGetAttributes for drive '" << getPath() << "':" << res.error();
-    else
-      attributes = res.value();
 
-    this -> selfTestStatus = getStringProperty(ataIface, "SmartSelftestStatus");
-    this -> selfTestPercentRemaining = getIntProperty(ataIface, "SmartSelftestPercentRemaining");
 
-  } else {
-    this -> failingStatusKnown = false;
+/*
+ * Read the properties of the DRIVE_IFACE and ATA_IFACE into the cached fields
+ *
+ * The SMART attributes are marked as outdated when UDisks2 reports
+ * a new collection of the SMART data (SmartUpdated)
+ *
+ * @see StorageUnit::applyProperties()
+ */
+bool Drive::readProperties(const QString& interface, const QVariantMap& properties)
+{
+  bool changed = false;
+
+  if(interface == UDISKS2_DRIVE_IFACE) {
+    if(properties.contains("Removable"))
+      changed |= updateField(removable, properties["Removable"].toBool());
+
+    if(properties.contains("Model"))
+      changed |= updateField(shortName, properties["Model"].toString());
+
+  } else if(interface == UDISKS2_ATA_IFACE) {
+    //properties received for the interface, it is present
+    changed |= updateField(hasATAIface, true);
+
+    if(properties.contains("SmartSupported"))
+      changed |= updateField(smartSupported, properties["SmartSupported"].toBool());
+
+    if(properties.contains("SmartEnabled"))
+      changed |= updateField(smartEnabled, properties["SmartEnabled"].toBool());
+
+    if(properties.contains("SmartFailing"))
+      changed |= updateField(failing, properties["SmartFailing"].toBool());
+
+    if(properties.contains("SmartSelftestStatus"))
+      changed |= updateField(selfTestStatus, properties["SmartSelftestStatus"].toString());
+
+    if(properties.contains("SmartSelftestPercentRemaining"))
+      changed |= updateField(selfTestPercentRemaining, properties["SmartSelftestPercentRemaining"].toInt());
+
+    if(properties.contains("PmSupported"))
+      changed |= updateField(pmSupported, properties["PmSupported"].toBool());
+
+    changed |= updateField(failingStatusKnown, smartSupported && smartEnabled);
+
+    //new SMART data collected by UDisks2, the attributes need to be retrieved again
+    if(properties.contains("SmartUpdated") &&
+       updateField(smartUpdated, properties["SmartUpdated"].toULongLong())) {
+
+      changed = true;
+      attributesOutdated = true;
+    }
   }
 
-  delete ataIface;
+  return changed;
+}
+
+
+
+/*
+ * Request the SMART attributes if they have been outdated by the last properties read
+ *
+ * The attributes stay outdated until received, to retry on next update
+ */
+void Drive::fetchOutdatedData()
+{
+  //no SMART data available
+  if(!this -> failingStatusKnown) {
+    clearSMARTAttributes();
+    return;
+  }
 
-  StorageUnit::update();
+  if(attributesOutdated)
+    UDisks2Wrapper::instance() -> requestSMARTAttributes(this);
 }
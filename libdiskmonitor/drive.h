@@ -23,6 +23,9 @@
 
 #include "storageunit.h"
 #include "dbus_metatypes.h"
+#include "smartattributetable.h"
+
+#include <QDateTime>
 
 
 /*
@@ -32,12 +35,14 @@ class Drive : public StorageUnit
 {
   Q_OBJECT
 
+  friend class UDisks2Wrapper;
+
 
 public:
-  explicit Drive(QDBusObjectPath objectPath, QString device, bool hasATAIface);
+  explicit Drive(QDBusObjectPath objectPath, QString device, const InterfaceList& interfaces);
   ~Drive();
 
-  bool isRemovable() const;
+  virtual bool isRemovable() const override;
 
   bool isSmartSupported() const;
   bool isSmartEnabled() const;
@@ -47,13 +52,23 @@ public:
   const QString& getSelfTestStatus() const;
 
   const SmartAttributesList& getSMARTAttributes() const;
+  const SmartAttributeTable& getSMARTAttributeTable() const;
+
+  bool isStandby() const;
+  QDateTime getStaleSince() const;
 
   virtual void update() override;
   virtual bool isDrive() const override { return true; }
+  virtual bool isOperationRunning() const override;
 
 protected:
   bool removable = false;
   bool hasATAIface = false;
+  bool pmSupported = false;
+  bool standby = false;
+  qint64 refreshedAt = 0;
+  qulonglong smartUpdated = 0;
+  bool attributesOutdated = true;
 
   bool smartSupported = false;
   bool smartEnabled = false;
@@ -63,6 +78,14 @@ protected:
   QString selfTestStatus;
 
   SmartAttributesList attributes;
+  SmartAttributeTable attributeTable;
+
+  void setSMARTAttributes(const SmartAttributesList& attributes);
+  void clearSMARTAttributes();
+
+  virtual bool readProperties(const QString& interface, const QVariantMap& properties) override;
+  virtual void fetchOutdatedData() override;
+  virtual void finishUpdate(const QStringList& failedInterfaces) override;
 
 signals:
 
@@ -0,0 +1,585 @@
+/****************************************************************************
+ * DisKMonitor, KDE tools to monitor SMART and MDRaid health status         *
+ * Copyright (C) 2014-2015 Michaël Lhomme <papylhomme@gmail.com>            *
+ *                                                                          *
+ * This program is free software; you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation; either version 2 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License along  *
+ * with this program; if not, write to the Free Software Foundation, Inc.,  *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.              *
+ ****************************************************************************/
+
+
+
+#include "healthrule.h"
+
+#include <QtNumeric>
+
+
+
+/*
+ * Test if a value is considered true: non zero and known
+ */
+static inline bool isTrue(double value)
+{
+  return value != 0 && !qIsNaN(value);
+}
+
+
+
+/*
+ * Recursive descent parser of the rules, emitting the bytecode of a HealthRule
+ *
+ * Grammar, from the lowest to the highest precedence:
+ *
+ *   or         := and ( "||" and )*
+ *   and        := comparison ( "&&" comparison )*
+ *   comparison := sum ( ( "<" | "<=" | ">" | ">=" | "==" | "!=" ) sum )?
+ *   sum        := term ( ( "+" | "-" ) term )*
+ *   term       := unary ( ( "*" | "/" ) unary )*
+ *   unary      := ( "!" | "-" ) unary | primary
+ *   primary    := number | "(" or ")" | operand | "delta" "(" attribute "," duration ")"
+ */
+class HealthRuleParser
+{
+public:
+  HealthRuleParser(HealthRule& rule) : rule(rule), pos(0), depth(0), nesting(0) { }
+
+  bool parse()
+  {
+    if(!parseOr())
+      return false;
+
+    skipSpaces();
+    if(pos < rule.source.size())
+      return fail("unexpected '" + QString(rule.source.at(pos)) + "'");
+
+    return true;
+  }
+
+private:
+  HealthRule& rule;
+  int pos;
+  int depth;
+  int nesting;
+
+
+  bool fail(const QString& message)
+  {
+    if(rule.error.isEmpty())
+      rule.error = QString("%1 at position %2").arg(message).arg(pos + 1);
+
+    return false;
+  }
+
+
+  void skipSpaces()
+  {
+    while(pos < rule.source.size() && rule.source.at(pos).isSpace())
+      pos++;
+  }
+
+
+  //consume the given token if it comes next
+  bool accept(const char* token)
+  {
+    skipSpaces();
+
+    QLatin1String t(token);
+    if(!rule.source.midRef(pos).startsWith(t))
+      return false;
+
+    pos += t.size();
+    return true;
+  }
+
+
+  bool expect(const char* token)
+  {
+    if(accept(token))
+      return true;
+
+    return fail(QString("expected '%1'").arg(token));
+  }
+
+
+  QString identifier()
+  {
+    skipSpaces();
+
+    int start = pos;
+    while(pos < rule.source.size() && (rule.source.at(pos).isLetterOrNumber() || rule.source.at(pos) == '_'))
+      pos++;
+
+    return rule.source.mid(start, pos - start);
+  }
+
+
+  bool number(double& value)
+  {
+    skipSpaces();
+
+    int start = pos;
+    while(pos < rule.source.size() && (rule.source.at(pos).isDigit() || rule.source.at(pos) == '.'))
+      pos++;
+
+    bool ok = false;
+    value = rule.source.mid(start, pos - start).toDouble(&ok);
+    if(!ok) {
+      pos = start;
+      return fail("expected a number");
+    }
+
+    return true;
+  }
+
+
+  //emit an instruction, tracking the depth of the stack
+  bool generate(int op, quint8 field = 0, quint16 arg = 0, double constant = 0)
+  {
+    HealthRule::Instruction instruction;
+    instruction.op = op;
+    instruction.field = field;
+    instruction.arg = arg;
+    instruction.constant = constant;
+    rule.code.append(instruction);
+
+    if(op <= HealthRule::PushFailing)
+      depth++;
+    else if(op >= HealthRule::Add)
+      depth--;
+
+    if(depth > HEALTH_RULE_MAX_STACK)
+      return fail("expression too complex");
+
+    return true;
+  }
+
+
+  bool parseOr()
+  {
+    if(!parseAnd())
+      return false;
+
+    while(accept("||")) {
+      if(!parseAnd() || !generate(HealthRule::Or))
+        return false;
+    }
+
+    return true;
+  }
+
+
+  bool parseAnd()
+  {
+    if(!parseComparison())
+      return false;
+
+    while(accept("&&")) {
+      if(!parseComparison() || !generate(HealthRule::And))
+        return false;
+    }
+
+    return true;
+  }
+
+
+  bool parseComparison()
+  {
+    if(!parseSum())
+      return false;
+
+    int op;
+    if(accept("<="))
+      op = HealthRule::LessOrEqual;
+    else if(accept(">="))
+      op = HealthRule::GreaterOrEqual;
+    else if(accept("=="))
+      op = HealthRule::Equal;
+    else if(accept("!="))
+      op = HealthRule::NotEqual;
+    else if(accept("<"))
+      op = HealthRule::Less;
+    else if(accept(">"))
+      op = HealthRule::Greater;
+    else
+      return true;
+
+    return parseSum() && generate(op);
+  }
+
+
+  bool parseSum()
+  {
+    if(!parseTerm())
+      return false;
+
+    forever {
+      int op;
+      if(accept("+"))
+        op = HealthRule::Add;
+      else if(accept("-"))
+        op = HealthRule::Subtract;
+      else
+        return true;
+
+      if(!parseTerm() || !generate(op))
+        return false;
+    }
+  }
+
+
+  bool parseTerm()
+  {
+    if(!parseUnary())
+      return false;
+
+    forever {
+      int op;
+      if(accept("*"))
+        op = HealthRule::Multiply;
+      else if(accept("/"))
+        op = HealthRule::Divide;
+      else
+        return true;
+
+      if(!parseUnary() || !generate(op))
+        return false;
+    }
+  }
+
+
+  //every recursion (parenthesis and unary operators) goes through here, bound it
+  //to keep hostile rules from exhausting the stack of the parser
+  bool parseUnary()
+  {
+    if(nesting >= HEALTH_RULE_MAX_NESTING)
+      return fail("expression too complex");
+
+    nesting++;
+    bool result = parseUnaryOperand();
+    nesting--;
+
+    return result;
+  }
+
+
+  bool parseUnaryOperand()
+  {
+    //"!=" is only valid after an operand
+    if(accept("!"))
+      return parseUnary() && generate(HealthRule::Not);
+
+    if(accept("-"))
+      return parseUnary() && generate(HealthRule::Negate);
+
+    return parsePrimary();
+  }
+
+
+  bool parsePrimary()
+  {
+    if(accept("(")) {
+      return parseOr() && expect(")");
+    }
+
+    skipSpaces();
+    if(pos < rule.source.size() && (rule.source.at(pos).isDigit() || rule.source.at(pos) == '.')) {
+      double value;
+      return number(value) && generate(HealthRule::PushConstant, 0, 0, value);
+    }
+
+    int start = pos;
+    QString name = identifier();
+
+    if(name == "attr") {
+      quint8 id;
+      quint8 field;
+      return parseAttribute(id, field) && generate(HealthRule::PushAttribute, field, id);
+
+    } else if(name == "delta") {
+      HealthRule::DeltaSource source;
+      if(!expect("(") || !expect("attr") || !parseAttribute(source.id, source.field) ||
+         !expect(",") || !parseDuration(source.window) || !expect(")"))
+        return false;
+
+      rule.deltaSources.append(source);
+      return generate(HealthRule::PushDelta, 0, rule.deltaSources.size() - 1);
+
+    } else if(name == "member") {
+      if(!expect("."))
+        return false;
+
+      QString field = identifier();
+      if(field == "numReadErrors")
+        return generate(HealthRule::PushMemberReadErrors);
+      else if(field == "faulty")
+        return generate(HealthRule::PushFaultyMembers);
+
+      return fail("unknown member field '" + field + "'");
+
+    } else if(name == "failing") {
+      return generate(HealthRule::PushFailing);
+    }
+
+    pos = start;
+    if(name.isEmpty())
+      return fail("expected an operand");
+
+    return fail("unknown operand '" + name + "'");
+  }
+
+
+  //"[ID].field" following "attr"
+  bool parseAttribute(quint8& id, quint8& field)
+  {
+    double value;
+    if(!expect("[") || !number(value))
+      return false;
+
+    if(value < 0 || value >= SMART_ATTRIBUTE_SLOTS || value != (int) value)
+      return fail("invalid attribute id");
+
+    if(!expect("]") || !expect("."))
+      return false;
+
+    id = value;
+
+    QString name = identifier();
+    if(name == "pretty")
+      field = HealthRule::Pretty;
+    else if(name == "value")
+      field = HealthRule::Value;
+    else if(name == "worst")
+      field = HealthRule::Worst;
+    else if(name == "threshold")
+      field = HealthRule::Threshold;
+    else
+      return fail("unknown attribute field '" + name + "'");
+
+    return true;
+  }
+
+
+  //number followed by a unit (s, m, h or d), in milliseconds
+  bool parseDuration(qint64& window)
+  {
+    double value;
+    if(!number(value))
+      return false;
+
+    QString unit = identifier();
+    if(unit == "s")
+      window = value * 1000;
+    else if(unit == "m")
+      window = value * 60 * 1000;
+    else if(unit == "h")
+      window = value * 3600 * 1000;
+    else if(unit == "d")
+      window = value * 24 * 3600 * 1000;
+    else
+      return fail("expected a duration unit (s, m, h or d)");
+
+    return true;
+  }
+};
+
+
+
+/*
+ * Constructor. Create an empty rule, never matching
+ */
+HealthRule::HealthRule()
+{
+}
+
+
+
+/*
+ * Parse a rule and compile it to bytecode
+ *
+ * @param source The rule's expression, empty for a rule never matching
+ * @return true on success, the error being available from getError() otherwise
+ */
+bool HealthRule::compile(const QString& source)
+{
+  this -> source = source.trimmed();
+  this -> error.clear();
+  this -> code.clear();
+  this -> deltaSources.clear();
+
+  if(this -> source.isEmpty())
+    return true;
+
+  HealthRuleParser parser(*this);
+  if(!parser.parse()) {
+    code.clear();
+    deltaSources.clear();
+    return false;
+  }
+
+  code.squeeze();
+  return true;
+}
+
+
+
+/*
+ * Test if the rule has been compiled without error
+ */
+bool HealthRule::isValid() const
+{
+  return error.isEmpty();
+}
+
+
+
+/*
+ * Test if the rule has no expression, never matching
+ */
+bool HealthRule::isEmpty() const
+{
+  return code.isEmpty();
+}
+
+
+
+/*
+ * Get the expression of the rule
+ */
+QString HealthRule::getSource() const
+{
+  return source;
+}
+
+
+
+/*
+ * Get the compilation error, empty if the rule is valid
+ */
+QString HealthRule::getError() const
+{
+  return error;
+}
+
+
+
+/*
+ * Get the size of the bytecode
+ */
+int HealthRule::getInstructionCount() const
+{
+  return code.size();
+}
+
+
+
+/*
+ * Get the attribute fields whose change over time is used by the rule, the
+ * value of delta N being read from HealthRuleInput::deltas[N]
+ */
+const QList<HealthRule::DeltaSource>& HealthRule::getDeltaSources() const
+{
+  return deltaSources;
+}
+
+
+
+/*
+ * Read a field of an attribute, NaN if the attribute is not reported
+ * or its value is unknown
+ */
+double HealthRule::attributeField(const SmartAttributeTable& table, quint8 id, int field)
+{
+  if(!table.contains(id))
+    return qQNaN();
+
+  switch(field) {
+    case Pretty: return table.pretty(id);
+    case Value: return table.value(id) == -1 ? qQNaN() : table.value(id);
+    case Worst: return table.worst(id) == -1 ? qQNaN() : table.worst(id);
+    case Threshold: return table.threshold(id) == -1 ? qQNaN() : table.threshold(id);
+    default: return qQNaN();
+  }
+}
+
+
+
+/*
+ * Evaluate the rule
+ *
+ * @param input The values of the unit
+ * @return true if the rule matches
+ */
+bool HealthRule::evaluate(const HealthRuleInput& input) const
+{
+  if(code.isEmpty())
+    return false;
+
+  double stack[HEALTH_RULE_MAX_STACK];
+  int top = -1;
+
+  const Instruction* instruction = code.constData();
+  const Instruction* end = instruction + code.size();
+
+  for(; instruction != end; instruction++) {
+    switch(instruction -> op) {
+      case PushConstant:
+        stack[++top] = instruction -> constant;
+        break;
+
+      case PushAttribute:
+        stack[++top] = input.attributes != nullptr ?
+                       attributeField(*input.attributes, instruction -> arg, instruction -> field) : qQNaN();
+        break;
+
+      case PushDelta:
+        stack[++top] = input.deltas != nullptr ? input.deltas[instruction -> arg] : qQNaN();
+        break;
+
+      case PushMemberReadErrors: stack[++top] = input.memberReadErrors; break;
+      case PushFaultyMembers: stack[++top] = input.faultyMembers; break;
+      case PushFailing: stack[++top] = input.failing; break;
+
+      case Negate:
+        stack[top] = -stack[top];
+        break;
+
+      case Not:
+        if(!qIsNaN(stack[top]))
+          stack[top] = stack[top] == 0 ? 1 : 0;
+        break;
+
+      default: {
+        double b = stack[top--];
+        double a = stack[top];
+
+        switch(instruction -> op) {
+          case Add: stack[top] = a + b; break;
+          case Subtract: stack[top] = a - b; break;
+          case Multiply: stack[top] = a * b; break;
+          case Divide: stack[top] = a / b; break;
+          case Less: stack[top] = a < b ? 1 : 0; break;
+          case LessOrEqual: stack[top] = a <= b ? 1 : 0; break;
+          case Greater: stack[top] = a > b ? 1 : 0; break;
+          case GreaterOrEqual: stack[top] = a >= b ? 1 : 0; break;
+          case Equal: stack[top] = a == b ? 1 : 0; break;
+          case NotEqual: stack[top] = a != b && !qIsNaN(a) && !qIsNaN(b) ? 1 : 0; break;
+          case And: stack[top] = isTrue(a) && isTrue(b) ? 1 : 0; break;
+          case Or: stack[top] = isTrue(a) || isTrue(b) ? 1 : 0; break;
+          default: break;
+        }
+      }
+    }
+  }
+
+  return isTrue(stack[top]);
+}
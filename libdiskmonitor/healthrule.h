@@ -0,0 +1,160 @@
+/****************************************************************************
+ * DisKMonitor, KDE tools to monitor SMART and MDRaid health status         *
+ * Copyright (C) 2014-2015 Michaël Lhomme <papylhomme@gmail.com>            *
+ *                                                                          *
+ * This program is free software; you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation; either version 2 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License along  *
+ * with this program; if not, write to the Free Software Foundation, Inc.,  *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.              *
+ ****************************************************************************/
+
+
+
+#ifndef HEALTHRULE_H
+#define HEALTHRULE_H
+
+#include <QList>
+#include <QString>
+#include <QVector>
+
+#include "smartattributetable.h"
+
+
+
+//maximum depth of the evaluation stack, deeper expressions are rejected by the compiler
+#define HEALTH_RULE_MAX_STACK 32
+
+//maximum nesting of parenthesis and unary operators, deeper expressions are rejected by the parser
+#define HEALTH_RULE_MAX_NESTING 64
+
+
+
+/*
+ * Values read by a rule, gathered from a unit before the evaluation
+ *
+ * Missing values (attributes not reported, member counters of a drive...) are NaN,
+ * making every comparison involving them false
+ */
+struct HealthRuleInput {
+  const SmartAttributeTable* attributes = nullptr;
+  const double* deltas = nullptr;
+  double memberReadErrors;
+  double faultyMembers;
+  double failing;
+};
+
+
+
+/*
+ * A health rule, compiled once to a compact stack bytecode
+ *
+ * Syntax, C-like expressions of numbers and operands:
+ *
+ *   attr[ID].pretty, attr[ID].value, attr[ID].worst, attr[ID].threshold
+ *                           SMART attribute ID of a drive (value interpreted by
+ *                           UDisks2 in its pretty unit: ms, mK, sectors..., not
+ *                           the raw value; normalized value, worst value, threshold)
+ *   delta(OPERAND, DURATION)  change of an attribute operand over DURATION, a number
+ *                           followed by s, m, h or d (ie. delta(attr[197].pretty, 24h))
+ *   member.numReadErrors    highest read errors count of the members of a raid array
+ *   member.faulty           number of faulty members of a raid array
+ *   failing                 1 if UDisks2 reports the unit as failing, 0 otherwise
+ *
+ * combined with + - * / ! < <= > >= == != && || and parenthesis. The rule
+ * matches if the expression is non zero
+ */
+class HealthRule
+{
+public:
+
+  /*
+   * Field of a SMART attribute
+   */
+  enum Field {
+    Pretty = 0,
+    Value = 1,
+    Worst = 2,
+    Threshold = 3
+  };
+
+  /*
+   * Attribute field whose change over a window is used by the rule
+   */
+  struct DeltaSource {
+    quint8 id;
+    quint8 field;
+    qint64 window;
+  };
+
+  HealthRule();
+
+  bool compile(const QString& source);
+
+  bool isValid() const;
+  bool isEmpty() const;
+  QString getSource() const;
+  QString getError() const;
+  int getInstructionCount() const;
+  const QList<DeltaSource>& getDeltaSources() const;
+
+  bool evaluate(const HealthRuleInput& input) const;
+
+  static double attributeField(const SmartAttributeTable& table, quint8 id, int field);
+
+private:
+
+  /*
+   * Operations of the bytecode, working on a stack of doubles
+   */
+  enum OpCode {
+    PushConstant,
+    PushAttribute,
+    PushDelta,
+    PushMemberReadErrors,
+    PushFaultyMembers,
+    PushFailing,
+    Negate,
+    Not,
+    Add,
+    Subtract,
+    Multiply,
+    Divide,
+    Less,
+    LessOrEqual,
+    Greater,
+    GreaterOrEqual,
+    Equal,
+    NotEqual,
+    And,
+    Or
+  };
+
+  /*
+   * An instruction: its operation, the attribute id and field or the delta
+   * index for the operands, and the value of the constants
+   */
+  struct Instruction {
+    quint8 op;
+    quint8 field;
+    quint16 arg;
+    double constant;
+  };
+
+  QString source;
+  QString error;
+  QVector<Instruction> code;
+  QList<DeltaSource> deltaSources;
+
+  friend class HealthRuleParser;
+};
+
+#endif // HEALTHRULE_H
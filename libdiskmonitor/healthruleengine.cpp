@@ -0,0 +1,288 @@
+/****************************************************************************
+ * DisKMonitor, KDE tools to monitor SMART and MDRaid health status         *
+ * Copyright (C) 2014-2015 Michaël Lhomme <papylhomme@gmail.com>            *
+ *                                                                          *
+ * This program is free software; you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation; either version 2 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License along  *
+ * with this program; if not, write to the Free Software Foundation, Inc.,  *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.              *
+ ****************************************************************************/
+
+
+
+#include "healthruleengine.h"
+
+#include <QDateTime>
+#include <QtNumeric>
+
+#include "diskmonitor_debug.h"
+#include "drive.h"
+#include "mdraid.h"
+#include "tracer.h"
+
+
+
+/*
+ * Singleton instance
+ */
+Q_GLOBAL_STATIC(HealthRuleEngine, myHealthRuleEngineInstance)
+
+
+
+/*
+ * Key of an attribute field in the history
+ */
+static inline int fieldKey(quint8 id, quint8 field)
+{
+  return (id << 8) | field;
+}
+
+
+
+/*
+ * Constructor
+ */
+HealthRuleEngine::HealthRuleEngine()
+{
+}
+
+
+
+/*
+ * Singleton pattern
+ */
+HealthRuleEngine* HealthRuleEngine::instance()
+{
+  return myHealthRuleEngineInstance;
+}
+
+
+
+/*
+ * Compile the rules applied to the units, an empty rule never matching.
+ * A rule failing to compile is reported and ignored
+ *
+ * @param failingRule The expression of the rule reporting a unit as failing
+ * @param warningRule The expression of the rule reporting a unit as warning
+ */
+void HealthRuleEngine::setRules(const QString& failingRule, const QString& warningRule)
+{
+  if(failingRule.trimmed() == this -> failingRule.getSource() && warningRule.trimmed() == this -> warningRule.getSource())
+    return;
+
+  if(!this -> failingRule.compile(failingRule))
+    qCWarning(DISKMONITOR_RULES) << "HealthRuleEngine => Invalid failing rule:" << this -> failingRule.getError();
+
+  if(!this -> warningRule.compile(warningRule))
+    qCWarning(DISKMONITOR_RULES) << "HealthRuleEngine => Invalid warning rule:" << this -> warningRule.getError();
+
+  windows.clear();
+  foreach(const HealthRule::DeltaSource& source, this -> failingRule.getDeltaSources() + this -> warningRule.getDeltaSources()) {
+    int key = fieldKey(source.id, source.field);
+    windows[key] = qMax(windows.value(key, 0), source.window);
+  }
+
+  //drop the fields no longer used
+  for(QHash<QString, UnitHistory>::iterator it = history.begin(); it != history.end(); ++it) {
+    foreach(int key, it.value().keys()) {
+      if(!windows.contains(key))
+        it.value().remove(key);
+    }
+  }
+}
+
+
+
+/*
+ * Get the compiled failing rule
+ */
+const HealthRule& HealthRuleEngine::getFailingRule() const
+{
+  return failingRule;
+}
+
+
+
+/*
+ * Get the compiled warning rule
+ */
+const HealthRule& HealthRuleEngine::getWarningRule() const
+{
+  return warningRule;
+}
+
+
+
+/*
+ * Test if at least one rule is defined
+ */
+bool HealthRuleEngine::hasRules() const
+{
+  return !failingRule.isEmpty() || !warningRule.isEmpty();
+}
+
+
+
+/*
+ * Apply the rules to a unit, updating its failing and warning status
+ *
+ * @param unit The unit, freshly updated
+ */
+void HealthRuleEngine::evaluate(StorageUnit* unit)
+{
+  evaluate(unit, QDateTime::currentMSecsSinceEpoch());
+}
+
+
+
+/*
+ * Apply the rules to a unit at the given time
+ *
+ * @param unit The unit, freshly updated
+ * @param now The time of the update, in milliseconds since epoch
+ */
+void HealthRuleEngine::evaluate(StorageUnit* unit, qint64 now)
+{
+  //remote units only carry the snapshot, the rules being applied by diskmonitord
+  Drive* drive = qobject_cast<Drive*>(unit);
+  MDRaid* raid = qobject_cast<MDRaid*>(unit);
+  if(drive == nullptr && raid == nullptr)
+    return;
+
+  if(!hasRules()) {
+    unit -> ruleFailing = false;
+    unit -> warning = false;
+    return;
+  }
+
+  TRACE_SCOPE("rules", unit -> getName());
+
+  HealthRuleInput input;
+  input.memberReadErrors = qQNaN();
+  input.faultyMembers = qQNaN();
+  input.failing = unit -> failing ? 1 : 0;
+
+  UnitHistory* unitHistory = nullptr;
+  if(drive != nullptr) {
+    input.attributes = &drive -> getSMARTAttributeTable();
+
+    if(!windows.isEmpty()) {
+      unitHistory = &history[unit -> getPath()];
+      recordSamples(*unitHistory, *input.attributes, now);
+    }
+
+  } else {
+    qint64 readErrors = 0;
+    int faulty = 0;
+
+    foreach(const MDRaidMember& member, raid -> getMembers()) {
+      readErrors = qMax(readErrors, member.numReadErrors);
+      if(member.state.contains("faulty"))
+        faulty++;
+    }
+
+    input.memberReadErrors = readErrors;
+    input.faultyMembers = faulty;
+  }
+
+  QVector<double> deltas;
+
+  computeDeltas(failingRule, unitHistory != nullptr ? *unitHistory : UnitHistory(), input.attributes, now, deltas);
+  input.deltas = deltas.constData();
+  unit -> ruleFailing = failingRule.evaluate(input);
+
+  computeDeltas(warningRule, unitHistory != nullptr ? *unitHistory : UnitHistory(), input.attributes, now, deltas);
+  input.deltas = deltas.constData();
+  unit -> warning = warningRule.evaluate(input);
+}
+
+
+
+/*
+ * Forget the recorded values of a removed unit
+ *
+ * @param path The unit's object path
+ */
+void HealthRuleEngine::forget(const QString& path)
+{
+  history.remove(path);
+}
+
+
+
+/*
+ * Record the values of the attribute fields used by delta(), only keeping
+ * their changes. Changes older than the window are dropped, except the last
+ * one giving the value at the start of the window
+ */
+void HealthRuleEngine::recordSamples(UnitHistory& unitHistory, const SmartAttributeTable& table, qint64 now)
+{
+  for(QMap<int, qint64>::const_iterator it = windows.constBegin(); it != windows.constEnd(); ++it) {
+    double value = HealthRule::attributeField(table, it.key() >> 8, it.key() & 0xff);
+    if(qIsNaN(value))
+      continue;
+
+    QVector<Sample>& samples = unitHistory[it.key()];
+    if(samples.isEmpty() || samples.last().value != value) {
+      Sample sample;
+      sample.time = now;
+      sample.value = value;
+      samples.append(sample);
+    }
+
+    qint64 start = now - it.value();
+    int expired = 0;
+    while(expired + 1 < samples.size() && samples.at(expired + 1).time <= start)
+      expired++;
+
+    if(expired > 0)
+      samples.remove(0, expired);
+  }
+}
+
+
+
+/*
+ * Compute the change of the attribute fields used by the rule over their window,
+ * NaN when the attribute is not reported. Without a value at the start of the
+ * window, the change is measured from the oldest recorded value
+ */
+void HealthRuleEngine::computeDeltas(const HealthRule& rule, const UnitHistory& unitHistory, const SmartAttributeTable* table,
+                                     qint64 now, QVector<double>& deltas) const
+{
+  const QList<HealthRule::DeltaSource>& sources = rule.getDeltaSources();
+  deltas.resize(sources.size());
+
+  for(int i = 0; i < sources.size(); i++) {
+    const HealthRule::DeltaSource& source = sources.at(i);
+
+    double current = table != nullptr ? HealthRule::attributeField(*table, source.id, source.field) : qQNaN();
+    QVector<Sample> samples = unitHistory.value(fieldKey(source.id, source.field));
+
+    if(qIsNaN(current) || samples.isEmpty()) {
+      deltas[i] = qQNaN();
+      continue;
+    }
+
+    //value at the start of the window: last change before it
+    qint64 start = now - source.window;
+    double initial = samples.first().value;
+    foreach(const Sample& sample, samples) {
+      if(sample.time > start)
+        break;
+
+      initial = sample.value;
+    }
+
+    deltas[i] = current - initial;
+  }
+}
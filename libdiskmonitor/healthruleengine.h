@@ -0,0 +1,85 @@
+/****************************************************************************
+ * DisKMonitor, KDE tools to monitor SMART and MDRaid health status         *
+ * Copyright (C) 2014-2015 Michaël Lhomme <papylhomme@gmail.com>            *
+ *                                                                          *
+ * This program is free software; you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation; either version 2 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License along  *
+ * with this program; if not, write to the Free Software Foundation, Inc.,  *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.              *
+ ****************************************************************************/
+
+
+
+#ifndef HEALTHRULEENGINE_H
+#define HEALTHRULEENGINE_H
+
+#include <QHash>
+#include <QMap>
+#include <QString>
+#include <QVector>
+
+#include "healthrule.h"
+
+class StorageUnit;
+
+
+
+/*
+ * Apply the user defined health rules to the units after each update
+ *
+ * A unit matching the failing rule is reported as failing, one matching the
+ * warning rule as warning. The values of the attributes used by the delta()
+ * operands are kept per unit, only their changes being recorded
+ */
+class HealthRuleEngine
+{
+public:
+  HealthRuleEngine();
+
+  static HealthRuleEngine* instance();
+
+  void setRules(const QString& failingRule, const QString& warningRule);
+  const HealthRule& getFailingRule() const;
+  const HealthRule& getWarningRule() const;
+  bool hasRules() const;
+
+  void evaluate(StorageUnit* unit);
+  void evaluate(StorageUnit* unit, qint64 now);
+  void forget(const QString& path);
+
+private:
+
+  /*
+   * Value of an attribute field from the given time
+   */
+  struct Sample {
+    qint64 time;
+    double value;
+  };
+
+  //attribute field (id << 8 | field) -> changes of the value, oldest first
+  typedef QMap<int, QVector<Sample> > UnitHistory;
+
+  HealthRule failingRule;
+  HealthRule warningRule;
+
+  //longest window of each attribute field used by delta()
+  QMap<int, qint64> windows;
+
+  QHash<QString, UnitHistory> history;
+
+  void recordSamples(UnitHistory& unitHistory, const SmartAttributeTable& table, qint64 now);
+  void computeDeltas(const HealthRule& rule, const UnitHistory& unitHistory, const SmartAttributeTable* table,
+                     qint64 now, QVector<double>& deltas) const;
+};
+
+#endif // HEALTHRULEENGINE_H
@@ -0,0 +1,300 @@
+/****************************************************************************
+ * DisKMonitor, KDE tools to monitor SMART and MDRaid health status         *
+ * Copyright (C) 2014-2015 Michaël Lhomme <papylhomme@gmail.com>            *
+ *                                                                          *
+ * This program is free software; you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation; either version 2 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License along  *
+ * with this program; if not, write to the Free Software Foundation, Inc.,  *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.              *
+ ****************************************************************************/
+
+
+
+#include "healthsnapshot.h"
+
+#include "drive.h"
+#include "mdraid.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+
+#include <cstring>
+
+
+
+/*
+ * Total size of the snapshot file
+ */
+static qint64 snapshotSize()
+{
+  return sizeof(HealthSnapshotHeader) + HEALTH_SNAPSHOT_CAPACITY * sizeof(HealthRecord);
+}
+
+
+
+/*
+ * Copy a string into a fixed size, null terminated field
+ */
+template<size_t N> static void copyString(char (&field)[N], const QString& value)
+{
+  QByteArray data = value.toUtf8();
+  size_t size = qMin((size_t) data.size(), N - 1);
+
+  memcpy(field, data.constData(), size);
+  memset(field + size, 0, N - size);
+}
+
+
+
+/*
+ * Constructor
+ *
+ * @param fileName The snapshot file, created if needed
+ */
+HealthSnapshotWriter::HealthSnapshotWriter(const QString& fileName) : file(fileName)
+{
+
+}
+
+
+
+/*
+ * Destructor
+ */
+HealthSnapshotWriter::~HealthSnapshotWriter()
+{
+  if(header != nullptr)
+    file.unmap(reinterpret_cast<uchar*>(header));
+}
+
+
+
+/*
+ * Create and map the snapshot file, publishing an empty snapshot
+ *
+ * @return true on success
+ */
+bool HealthSnapshotWriter::open()
+{
+  QDir().mkpath(QFileInfo(file).absolutePath());
+
+  if(!file.open(QIODevice::ReadWrite) || !file.resize(snapshotSize())) {
+    qWarning() << "HealthSnapshotWriter => Unable to create '" << file.fileName() << "': " << file.errorString();
+    return false;
+  }
+
+  file.setPermissions(QFile::ReadOwner | QFile::WriteOwner | QFile::ReadGroup | QFile::ReadOther);
+
+  uchar* data = file.map(0, snapshotSize());
+  if(data == nullptr) {
+    qWarning() << "HealthSnapshotWriter => Unable to map '" << file.fileName() << "': " << file.errorString();
+    return false;
+  }
+
+  header = reinterpret_cast<HealthSnapshotHeader*>(data);
+  records = reinterpret_cast<HealthRecord*>(data + sizeof(HealthSnapshotHeader));
+
+  //readers reject the file until the layout is written
+  header -> magic = 0;
+  header -> version = HEALTH_SNAPSHOT_VERSION;
+  header -> recordSize = sizeof(HealthRecord);
+  header -> capacity = HEALTH_SNAPSHOT_CAPACITY;
+  header -> sequence.store(0, std::memory_order_relaxed);
+  header -> count = 0;
+  header -> publishedAt = QDateTime::currentMSecsSinceEpoch();
+  std::atomic_thread_fence(std::memory_order_release);
+  header -> magic = HEALTH_SNAPSHOT_MAGIC;
+
+  return true;
+}
+
+
+
+/*
+ * Replace the snapshot with the health records of the given units
+ *
+ * @param units The units to publish, truncated to HEALTH_SNAPSHOT_CAPACITY
+ */
+void HealthSnapshotWriter::publish(const QList<StorageUnit*>& units)
+{
+  if(header == nullptr)
+    return;
+
+  if(units.size() > HEALTH_SNAPSHOT_CAPACITY)
+    qWarning() << "HealthSnapshotWriter => Too many units, only the first " << HEALTH_SNAPSHOT_CAPACITY << " are published";
+
+  //build the records before taking the lock, to keep the readers' window small
+  QVector<HealthRecord> newRecords;
+  foreach(StorageUnit* unit, units.mid(0, HEALTH_SNAPSHOT_CAPACITY))
+    newRecords << record(unit);
+
+  quint64 sequence = header -> sequence.load(std::memory_order_relaxed);
+  header -> sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  for(int i = 0; i < newRecords.size(); i++)
+    records[i] = newRecords[i];
+
+  header -> count = newRecords.size();
+  header -> publishedAt = QDateTime::currentMSecsSinceEpoch();
+
+  header -> sequence.store(sequence + 2, std::memory_order_release);
+}
+
+
+
+/*
+ * Build the health record of a unit
+ */
+HealthRecord HealthSnapshotWriter::record(const StorageUnit* unit)
+{
+  HealthRecord r;
+  memset(&r, 0, sizeof(HealthRecord));
+
+  copyString(r.path, unit -> getPath());
+  copyString(r.device, unit -> getDevice());
+
+  if(unit -> isFailing()) r.flags |= HealthRecord::Failing;
+  if(unit -> isFailingStatusKnown()) r.flags |= HealthRecord::FailingStatusKnown;
+  if(unit -> isWarning()) r.flags |= HealthRecord::Warning;
+  if(unit -> isUnresponsive()) r.flags |= HealthRecord::Unresponsive;
+  if(unit -> isOperationRunning()) r.flags |= HealthRecord::OperationRunning;
+  if(unit -> isRemovable()) r.flags |= HealthRecord::Removable;
+
+  r.lastChangeTime = unit -> getLastChangeTime();
+  r.reallocatedSectors = -1;
+  r.pendingSectors = -1;
+  r.offlineUncorrectable = -1;
+  r.powerOnTime = -1;
+  r.temperature = -1;
+
+  if(unit -> isDrive()) {
+    const Drive* drive = static_cast<const Drive*>(unit);
+    const SmartAttributeTable& attributes = drive -> getSMARTAttributeTable();
+
+    r.type = HealthRecord::DriveType;
+    if(drive -> isStandby()) r.flags |= HealthRecord::Standby;
+
+    r.selfTestPercentRemaining = drive -> isOperationRunning() ? drive -> getSelfTestPercentRemaining() : 0;
+
+    r.reallocatedSectors = attributes.pretty(5);
+    r.powerOnTime = attributes.pretty(9);
+    r.temperature = attributes.pretty(194);
+    r.pendingSectors = attributes.pretty(197);
+    r.offlineUncorrectable = attributes.pretty(198);
+
+  } else if(unit -> isMDRaid()) {
+    const MDRaid* raid = static_cast<const MDRaid*>(unit);
+
+    r.type = HealthRecord::MDRaidType;
+    copyString(r.syncAction, raid -> getSyncAction());
+    r.syncCompleted = raid -> getSyncCompleted();
+    r.syncRemainingTime = raid -> getSyncRemainingTime();
+  }
+
+  return r;
+}
+
+
+
+/*
+ * Constructor
+ *
+ * @param fileName The snapshot file
+ */
+HealthSnapshotReader::HealthSnapshotReader(const QString& fileName) : file(fileName)
+{
+
+}
+
+
+
+/*
+ * Destructor
+ */
+HealthSnapshotReader::~HealthSnapshotReader()
+{
+  if(header != nullptr)
+    file.unmap(reinterpret_cast<uchar*>(const_cast<HealthSnapshotHeader*>(header)));
+}
+
+
+
+/*
+ * Map the snapshot file, checking its layout
+ *
+ * @return true if the file is a snapshot readable by this version
+ */
+bool HealthSnapshotReader::open()
+{
+  if(!file.open(QIODevice::ReadOnly) || file.size() < snapshotSize())
+    return false;
+
+  uchar* data = file.map(0, snapshotSize());
+  if(data == nullptr)
+    return false;
+
+  header = reinterpret_cast<const HealthSnapshotHeader*>(data);
+  records = reinterpret_cast<const HealthRecord*>(data + sizeof(HealthSnapshotHeader));
+
+  if(header -> magic != HEALTH_SNAPSHOT_MAGIC || header -> version != HEALTH_SNAPSHOT_VERSION ||
+     header -> recordSize != sizeof(HealthRecord) || header -> capacity != HEALTH_SNAPSHOT_CAPACITY) {
+    qWarning() << "HealthSnapshotReader => Incompatible snapshot '" << file.fileName() << "'";
+    file.unmap(data);
+    header = nullptr;
+    records = nullptr;
+    return false;
+  }
+
+  return true;
+}
+
+
+
+/*
+ * Copy a consistent snapshot of the records
+ *
+ * @param snapshot Filled with the records of the snapshot, reusing its storage
+ * @param publishedAt If not null, set to the time of the snapshot in milliseconds since epoch
+ * @return false if the snapshot is not mapped or the writer kept modifying it
+ */
+bool HealthSnapshotReader::read(QVector<HealthRecord>& snapshot, qint64* publishedAt) const
+{
+  if(header == nullptr)
+    return false;
+
+  for(int attempt = 0; attempt < HEALTH_SNAPSHOT_READ_RETRIES; attempt++) {
+    quint64 sequence = header -> sequence.load(std::memory_order_acquire);
+    if(sequence & 1)
+      continue;
+
+    quint32 count = qMin(header -> count, (quint32) HEALTH_SNAPSHOT_CAPACITY);
+    qint64 time = header -> publishedAt;
+
+    snapshot.resize(count);
+    memcpy(snapshot.data(), this -> records, count * sizeof(HealthRecord));
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if(header -> sequence.load(std::memory_order_relaxed) != sequence)
+      continue;
+
+    if(publishedAt != nullptr)
+      *publishedAt = time;
+
+    return true;
+  }
+
+  snapshot.clear();
+  return false;
+}
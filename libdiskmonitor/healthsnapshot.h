@@ -0,0 +1,160 @@
+/****************************************************************************
+ * DisKMonitor, KDE tools to monitor SMART and MDRaid health status         *
+ * Copyright (C) 2014-2015 Michaël Lhomme <papylhomme@gmail.com>            *
+ *                                                                          *
+ * This program is free software; you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation; either version 2 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License along  *
+ * with this program; if not, write to the Free Software Foundation, Inc.,  *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.              *
+ ****************************************************************************/
+
+
+
+#ifndef HEALTHSNAPSHOT_H
+#define HEALTHSNAPSHOT_H
+
+#include <QFile>
+#include <QList>
+#include <QVector>
+
+#include <atomic>
+
+#include "storageunit.h"
+
+
+
+//default location of the snapshot published by diskmonitord
+#define HEALTH_SNAPSHOT_FILE "/run/diskmonitor/health"
+
+//layout identification, VERSION must be incremented on each change of the records
+#define HEALTH_SNAPSHOT_MAGIC 0x53484d44
+#define HEALTH_SNAPSHOT_VERSION 1
+
+//maximum number of records in the snapshot
+#define HEALTH_SNAPSHOT_CAPACITY 256
+
+//number of attempts of a reader racing with the writer before giving up
+#define HEALTH_SNAPSHOT_READ_RETRIES 100
+
+
+
+/*
+ * Fixed layout health record of a unit
+ *
+ * SMART values are -1 if the attribute is not reported by the drive,
+ * self test and sync fields are zeroed for the units they don't apply to
+ */
+struct HealthRecord {
+  enum Flags {
+    Failing = 0x01,
+    FailingStatusKnown = 0x02,
+    Unresponsive = 0x04,
+    Standby = 0x08,
+    OperationRunning = 0x10,
+    Removable = 0x20,
+    Warning = 0x40
+  };
+
+  enum Type {
+    DriveType = 1,
+    MDRaidType = 2
+  };
+
+  char path[128];
+  char device[32];
+  char syncAction[16];
+
+  quint8 type;
+  quint8 flags;
+  qint16 selfTestPercentRemaining;
+  quint32 reserved;
+
+  double syncCompleted;
+  quint64 syncRemainingTime;
+
+  qint64 lastChangeTime;
+
+  //values of key SMART attributes, as interpreted by UDisks2 (sector
+  //counts, power on time in milliseconds, temperature in millikelvin)
+  qint64 reallocatedSectors;
+  qint64 pendingSectors;
+  qint64 offlineUncorrectable;
+  qint64 powerOnTime;
+  qint64 temperature;
+};
+
+
+
+/*
+ * Header of the snapshot file, followed by HEALTH_SNAPSHOT_CAPACITY records
+ *
+ * The records are protected by a sequence lock: the writer makes sequence odd
+ * before modifying them and even again once done. Readers copy the records and
+ * retry if sequence was odd or changed in the meantime
+ */
+struct HealthSnapshotHeader {
+  quint32 magic;
+  quint32 version;
+  quint32 recordSize;
+  quint32 capacity;
+
+  std::atomic<quint64> sequence;
+
+  quint32 count;
+  quint32 reserved;
+  qint64 publishedAt;
+};
+
+
+
+/*
+ * Publish the health snapshot of the units in a memory mapped file
+ */
+class HealthSnapshotWriter
+{
+public:
+  HealthSnapshotWriter(const QString& fileName = HEALTH_SNAPSHOT_FILE);
+  ~HealthSnapshotWriter();
+
+  bool open();
+  void publish(const QList<StorageUnit*>& units);
+
+  static HealthRecord record(const StorageUnit* unit);
+
+private:
+  QFile file;
+  HealthSnapshotHeader* header = nullptr;
+  HealthRecord* records = nullptr;
+};
+
+
+
+/*
+ * Read a consistent health snapshot from the file published by HealthSnapshotWriter,
+ * without any IPC
+ */
+class HealthSnapshotReader
+{
+public:
+  HealthSnapshotReader(const QString& fileName = HEALTH_SNAPSHOT_FILE);
+  ~HealthSnapshotReader();
+
+  bool open();
+  bool read(QVector<HealthRecord>& snapshot, qint64* publishedAt = nullptr) const;
+
+private:
+  QFile file;
+  const HealthSnapshotHeader* header = nullptr;
+  const HealthRecord* records = nullptr;
+};
+
+#endif // HEALTHSNAPSHOT_H
@@ -0,0 +1,353 @@
+/****************************************************************************
+ * DisKMonitor, KDE tools to monitor SMART and MDRaid health status         *
+ * Copyright (C) 2014-2015 Michaël Lhomme <papylhomme@gmail.com>            *
+ *                                                                          *
+ * This program is free software; you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation; either version 2 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License along  *
+ * with this program; if not, write to the Free Software Foundation, Inc.,  *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.              *
+ ****************************************************************************/
+
+
+
+#include "historycodec.h"
+
+#include <cstring>
+
+
+
+/*
+ * Bit pattern of a double
+ */
+static inline quint64 toBits(double value)
+{
+  quint64 bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+
+
+/*
+ * Double of a bit pattern
+ */
+static inline double fromBits(quint64 bits)
+{
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+
+
+/*
+ * Constructor. The encoder must be started before appending
+ */
+HistoryEncoder::HistoryEncoder()
+{
+}
+
+
+
+/*
+ * Start encoding into an empty buffer, the last time being kept from the previous one
+ *
+ * @param data The buffer, zeroed
+ * @param size The size of the buffer in bytes
+ */
+void HistoryEncoder::start(uchar* data, int size)
+{
+  this -> data = data;
+  this -> capacity = size * 8;
+  this -> position = 0;
+  this -> count = 0;
+  this -> lastLeading = -1;
+}
+
+
+
+/*
+ * Continue encoding into a buffer already holding samples
+ *
+ * @param data The buffer
+ * @param size The size of the buffer in bytes
+ * @param count The number of samples of the buffer
+ * @return false if the samples couldn't be decoded
+ */
+bool HistoryEncoder::resume(uchar* data, int size, int count)
+{
+  start(data, size);
+
+  HistoryDecoder decoder(data, size, count);
+  qint64 time;
+  double value;
+  while(decoder.next(time, value))
+    this -> count++;
+
+  if(this -> count != count)
+    return false;
+
+  //empty buffer, keep the time of the previous one
+  if(count == 0)
+    return true;
+
+  this -> position = decoder.position;
+  this -> lastTime = decoder.lastTime;
+  this -> lastDelta = decoder.lastDelta;
+  this -> lastValue = decoder.lastValue;
+  this -> lastLeading = decoder.lastLeading;
+  this -> lastTrailing = decoder.lastTrailing;
+
+  return true;
+}
+
+
+
+/*
+ * Append a sample
+ *
+ * @param time The time of the sample
+ * @param value The value
+ * @return false if the buffer is full
+ */
+bool HistoryEncoder::append(qint64 time, double value)
+{
+  if(data == nullptr || position + HISTORY_CODEC_MAX_BITS > capacity)
+    return false;
+
+  quint64 bits = toBits(value);
+
+  if(count == 0) {
+    writeBits(time, 64);
+    writeBits(bits, 64);
+
+    lastTime = time;
+    lastDelta = 0;
+    lastValue = bits;
+    count++;
+    return true;
+  }
+
+  //time, delta of delta in buckets of increasing size
+  qint64 delta = time - lastTime;
+  qint64 dod = delta - lastDelta;
+
+  if(dod == 0) {
+    writeBits(0, 1);
+  } else if(dod >= -255 && dod <= 256) {
+    writeBits(0x2, 2);
+    writeBits(dod + 255, 9);
+  } else if(dod >= -8191 && dod <= 8192) {
+    writeBits(0x6, 3);
+    writeBits(dod + 8191, 14);
+  } else if(dod >= -524287 && dod <= 524288) {
+    writeBits(0xe, 4);
+    writeBits(dod + 524287, 20);
+  } else {
+    writeBits(0xf, 4);
+    writeBits(dod, 64);
+  }
+
+  //value, meaningful bits of the XOR with the previous one
+  quint64 x = bits ^ lastValue;
+
+  if(x == 0) {
+    writeBits(0, 1);
+  } else {
+    int leading = qMin(__builtin_clzll(x), 31);
+    int trailing = __builtin_ctzll(x);
+
+    if(lastLeading != -1 && leading >= lastLeading && trailing >= lastTrailing) {
+      writeBits(0x2, 2);
+      writeBits(x >> lastTrailing, 64 - lastLeading - lastTrailing);
+    } else {
+      int meaningful = 64 - leading - trailing;
+      writeBits(0x3, 2);
+      writeBits(leading, 5);
+      writeBits(meaningful - 1, 6);
+      writeBits(x >> trailing, meaningful);
+
+      lastLeading = leading;
+      lastTrailing = trailing;
+    }
+  }
+
+  lastTime = time;
+  lastDelta = delta;
+  lastValue = bits;
+  count++;
+
+  return true;
+}
+
+
+
+/*
+ * Get the number of encoded samples
+ */
+int HistoryEncoder::getCount() const
+{
+  return count;
+}
+
+
+
+/*
+ * Get the size of the encoded samples, in bits
+ */
+int HistoryEncoder::getBitCount() const
+{
+  return position;
+}
+
+
+
+/*
+ * Get the time of the last encoded sample, in this buffer or a previous one.
+ * The lowest qint64 if nothing was encoded
+ */
+qint64 HistoryEncoder::getLastTime() const
+{
+  return lastTime;
+}
+
+
+
+/*
+ * Write the low bits of a value, most significant first. The buffer being zeroed,
+ * the bits are ORed without touching the ones already written
+ */
+void HistoryEncoder::writeBits(quint64 value, int bits)
+{
+  while(bits > 0) {
+    int offset = position & 7;
+    int n = qMin(8 - offset, bits);
+    quint8 chunk = (value >> (bits - n)) & ((1 << n) - 1);
+
+    data[position >> 3] |= chunk << (8 - offset - n);
+
+    position += n;
+    bits -= n;
+  }
+}
+
+
+
+/*
+ * Constructor
+ *
+ * @param data The buffer written by HistoryEncoder
+ * @param size The size of the buffer in bytes
+ * @param count The number of samples to decode
+ */
+HistoryDecoder::HistoryDecoder(const uchar* data, int size, int count) :
+  data(data),
+  capacity(size * 8),
+  remaining(count)
+{
+}
+
+
+
+/*
+ * Decode the next sample
+ *
+ * @param time Set to the time of the sample
+ * @param value Set to the value of the sample
+ * @return false once every sample has been decoded, or if the buffer is corrupted
+ */
+bool HistoryDecoder::next(qint64& time, double& value)
+{
+  if(remaining <= 0 || position + (started ? 2 : 128) > capacity)
+    return false;
+
+  if(!started) {
+    lastTime = readBits(64);
+    lastValue = readBits(64);
+    started = true;
+
+  } else {
+    qint64 dod;
+    if(readBits(1) == 0)
+      dod = 0;
+    else if(readBits(1) == 0)
+      dod = (qint64) readBits(9) - 255;
+    else if(readBits(1) == 0)
+      dod = (qint64) readBits(14) - 8191;
+    else if(readBits(1) == 0)
+      dod = (qint64) readBits(20) - 524287;
+    else
+      dod = readBits(64);
+
+    lastDelta += dod;
+    lastTime += lastDelta;
+
+    if(readBits(1) != 0) {
+      if(readBits(1) == 0) {
+        if(lastLeading == -1)
+          return false;
+
+        lastValue ^= readBits(64 - lastLeading - lastTrailing) << lastTrailing;
+      } else {
+        lastLeading = readBits(5);
+        int meaningful = readBits(6) + 1;
+        lastTrailing = 64 - lastLeading - meaningful;
+        if(lastTrailing < 0)
+          return false;
+
+        lastValue ^= readBits(meaningful) << lastTrailing;
+      }
+    }
+
+    if(position > capacity)
+      return false;
+  }
+
+  time = lastTime;
+  value = fromBits(lastValue);
+  remaining--;
+
+  return true;
+}
+
+
+
+/*
+ * Get the number of samples left to decode
+ */
+int HistoryDecoder::getRemaining() const
+{
+  return remaining;
+}
+
+
+
+/*
+ * Read bits, most significant first. Reading past the buffer returns zeros
+ */
+quint64 HistoryDecoder::readBits(int bits)
+{
+  quint64 value = 0;
+
+  while(bits > 0) {
+    int offset = position & 7;
+    int n = qMin(8 - offset, bits);
+    quint8 byte = position < capacity ? data[position >> 3] : 0;
+
+    value = (value << n) | ((byte >> (8 - offset - n)) & ((1 << n) - 1));
+
+    position += n;
+    bits -= n;
+  }
+
+  return value;
+}
@@ -0,0 +1,109 @@
+/****************************************************************************
+ * DisKMonitor, KDE tools to monitor SMART and MDRaid health status         *
+ * Copyright (C) 2014-2015 Michaël Lhomme <papylhomme@gmail.com>            *
+ *                                                                          *
+ * This program is free software; you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation; either version 2 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License along  *
+ * with this program; if not, write to the Free Software Foundation, Inc.,  *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.              *
+ ****************************************************************************/
+
+
+
+#ifndef HISTORYCODEC_H
+#define HISTORYCODEC_H
+
+#include <QtGlobal>
+
+#include <limits>
+
+
+
+//largest encoding of a sample, in bits: 4 + 64 for the time, 2 + 5 + 6 + 64 for the value
+#define HISTORY_CODEC_MAX_BITS 145
+
+
+
+/*
+ * Encode samples into a buffer, compressed the way of Facebook's Gorilla:
+ *
+ *  - the first sample is stored as is
+ *  - the time as the delta of the delta with the previous sample, in 1 bit when
+ *    the interval is unchanged, 11 bits for a jitter of a few hundred milliseconds
+ *  - the value as the XOR with the previous value, in 1 bit when unchanged and
+ *    only the meaningful bits otherwise, reusing the previous leading and trailing
+ *    zeros count when they fit
+ *
+ * Slowly changing values sampled at a regular interval (power on time, temperature,
+ * counters...) take a few bits per sample. The buffer must be zeroed before the first
+ * sample, encoded bits are never modified by the following appends
+ */
+class HistoryEncoder
+{
+public:
+  HistoryEncoder();
+
+  void start(uchar* data, int size);
+  bool resume(uchar* data, int size, int count);
+  bool append(qint64 time, double value);
+
+  int getCount() const;
+  int getBitCount() const;
+  qint64 getLastTime() const;
+
+private:
+  uchar* data = nullptr;
+  int capacity = 0;
+  int position = 0;
+  int count = 0;
+
+  qint64 lastTime = std::numeric_limits<qint64>::min();
+  qint64 lastDelta = 0;
+  quint64 lastValue = 0;
+  int lastLeading = -1;
+  int lastTrailing = 0;
+
+  void writeBits(quint64 value, int bits);
+};
+
+
+
+/*
+ * Stream the samples encoded by HistoryEncoder, oldest first
+ */
+class HistoryDecoder
+{
+  friend class HistoryEncoder;
+
+public:
+  HistoryDecoder(const uchar* data, int size, int count);
+
+  bool next(qint64& time, double& value);
+  int getRemaining() const;
+
+private:
+  const uchar* data;
+  int capacity;
+  int position = 0;
+  int remaining;
+  bool started = false;
+
+  qint64 lastTime = 0;
+  qint64 lastDelta = 0;
+  quint64 lastValue = 0;
+  int lastLeading = -1;
+  int lastTrailing = 0;
+
+  quint64 readBits(int bits);
+};
+
+#endif // HISTORYCODEC_H
@@ -0,0 +1,746 @@
+/****************************************************************************
+ * DisKMonitor, KDE tools to monitor SMART and MDRaid health status         *
+ * Copyright (C) 2014-2015 Michaël Lhomme <papylhomme@gmail.com>            *
+ *                                                                          *
+ * This program is free software; you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation; either version 2 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License along  *
+ * with this program; if not, write to the Free Software Foundation, Inc.,  *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.              *
+ ****************************************************************************/
+
+
+
+#include "historystore.h"
+
+#include "drive.h"
+#include "mdraid.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+
+#include <algorithm>
+#include <cstring>
+
+static_assert(sizeof(HistoryBlock) == HISTORY_BLOCK_SIZE, "HistoryBlock must fill a block");
+
+
+
+/*
+ * Size of the header and tables, rounded to a block
+ */
+static qint64 metadataSize()
+{
+  qint64 size = sizeof(HistoryHeader) + HISTORY_MAX_UNITS * sizeof(HistoryUnit) + HISTORY_MAX_SERIES * sizeof(HistorySeries);
+  return (size + HISTORY_BLOCK_SIZE - 1) / HISTORY_BLOCK_SIZE * HISTORY_BLOCK_SIZE;
+}
+
+
+
+/*
+ * Size of a segment of blocks
+ */
+static qint64 segmentSize()
+{
+  return (qint64) HISTORY_SEGMENT_BLOCKS * HISTORY_BLOCK_SIZE;
+}
+
+
+
+/*
+ * Constructor
+ *
+ * @param fileName The history file, created if needed
+ */
+HistoryStore::HistoryStore(const QString& fileName) : file(fileName)
+{
+
+}
+
+
+
+/*
+ * Destructor
+ */
+HistoryStore::~HistoryStore()
+{
+  foreach(uchar* segment, segments)
+    file.unmap(segment);
+
+  if(header != nullptr)
+    file.unmap(reinterpret_cast<uchar*>(header));
+}
+
+
+
+/*
+ * Map the history file, creating it if needed
+ *
+ * @param readOnly true to only read the history, recorded by another process
+ * @return true on success
+ */
+bool HistoryStore::open(bool readOnly)
+{
+  this -> readOnly = readOnly;
+
+  if(!readOnly)
+    QDir().mkpath(QFileInfo(file).absolutePath());
+
+  if(!file.open(readOnly ? QIODevice::ReadOnly : QIODevice::ReadWrite)) {
+    qWarning() << "HistoryStore => Unable to open '" << file.fileName() << "': " << file.errorString();
+    return false;
+  }
+
+  bool created = file.size() == 0;
+  if(created && (readOnly || !file.resize(metadataSize()))) {
+    qWarning() << "HistoryStore => Unable to create '" << file.fileName() << "': " << file.errorString();
+    return false;
+  }
+
+  uchar* data = file.size() >= metadataSize() ? file.map(0, metadataSize()) : nullptr;
+  if(data == nullptr) {
+    qWarning() << "HistoryStore => Unable to map '" << file.fileName() << "': " << file.errorString();
+    return false;
+  }
+
+  header = reinterpret_cast<HistoryHeader*>(data);
+  units = reinterpret_cast<HistoryUnit*>(data + sizeof(HistoryHeader));
+  series = reinterpret_cast<HistorySeries*>(data + sizeof(HistoryHeader) + HISTORY_MAX_UNITS * sizeof(HistoryUnit));
+
+  //a writer interrupted while creating the file left it without magic
+  if(header -> magic == 0 && !readOnly) {
+    header -> version = HISTORY_STORE_VERSION;
+    header -> blockSize = HISTORY_BLOCK_SIZE;
+    header -> unitCount.store(0, std::memory_order_relaxed);
+    header -> seriesCount.store(0, std::memory_order_relaxed);
+    header -> blockCount.store(0, std::memory_order_relaxed);
+    header -> createdAt = QDateTime::currentMSecsSinceEpoch();
+    std::atomic_thread_fence(std::memory_order_release);
+    header -> magic = HISTORY_STORE_MAGIC;
+  }
+
+  if(header -> magic != HISTORY_STORE_MAGIC || header -> version != HISTORY_STORE_VERSION ||
+     header -> blockSize != HISTORY_BLOCK_SIZE) {
+    qWarning() << "HistoryStore => Incompatible history '" << file.fileName() << "'";
+    file.unmap(data);
+    header = nullptr;
+    units = nullptr;
+    series = nullptr;
+    return false;
+  }
+
+  updateIndexes();
+  if(!mapSegments(header -> blockCount.load(std::memory_order_acquire)))
+    return false;
+
+  if(!readOnly)
+    recover();
+
+  return true;
+}
+
+
+
+/*
+ * Test if the history file is mapped
+ */
+bool HistoryStore::isOpen() const
+{
+  return header != nullptr;
+}
+
+
+
+/*
+ * Record the current values of a unit: the interpreted and normalized values of
+ * the SMART attributes of a drive, the sync progress and read errors of a raid array
+ *
+ * Sleeping drives and drives without a known SMART status are skipped, their
+ * attributes not being fresh
+ *
+ * @param unit The unit, freshly updated
+ * @param time The time of the samples, in milliseconds since epoch
+ */
+void HistoryStore::record(const StorageUnit* unit, qint64 time)
+{
+  if(header == nullptr || readOnly)
+    return;
+
+  QString path = unit -> getPath();
+
+  const Drive* drive = qobject_cast<const Drive*>(unit);
+  if(drive != nullptr) {
+    if(drive -> isStandby() || !drive -> isFailingStatusKnown())
+      return;
+
+    const SmartAttributeTable& table = drive -> getSMARTAttributeTable();
+    for(int id = 0; id < SMART_ATTRIBUTE_SLOTS; id++) {
+      if(!table.contains(id))
+        continue;
+
+      if(table.pretty(id) != -1)
+        append(path, AttributePretty, id, time, table.pretty(id));
+
+      if(table.value(id) != -1)
+        append(path, AttributeValue, id, time, table.value(id));
+    }
+
+    return;
+  }
+
+  const MDRaid* raid = qobject_cast<const MDRaid*>(unit);
+  if(raid != nullptr) {
+    qint64 readErrors = 0;
+    foreach(const MDRaidMember& member, raid -> getMembers())
+      readErrors += member.numReadErrors;
+
+    append(path, SyncCompleted, 0, time, raid -> getSyncCompleted());
+    append(path, ReadErrors, 0, time, readErrors);
+  }
+}
+
+
+
+/*
+ * Append a sample to a series, created if needed. The head block is sealed
+ * once full
+ *
+ * The sample is written before the count of its block is incremented, a crash
+ * in between losing only this sample
+ *
+ * @param path The unit's object path
+ * @param kind The recorded value, see HistoryStore::Kind
+ * @param id The SMART attribute id, 0 for the raid counters
+ * @param time The time of the sample, in milliseconds since epoch
+ * @param value The value
+ * @return false if the store is not writable or full, or the sample is not newer than the last one
+ */
+bool HistoryStore::append(const QString& path, int kind, quint8 id, qint64 time, double value)
+{
+  if(header == nullptr || readOnly)
+    return false;
+
+  int unit = findUnit(path);
+  int index = unit == -1 ? -1 : findSeries(unit, kind, id);
+  if(index == -1) {
+    index = addSeries(path, kind, id);
+    if(index == -1)
+      return false;
+  }
+
+  HistorySeries& entry = series[index];
+
+  quint32 head = entry.headBlock.load(std::memory_order_relaxed);
+  if(head == HISTORY_NO_BLOCK) {
+    head = addBlock(index, 0);
+    if(head == HISTORY_NO_BLOCK)
+      return false;
+
+    entry.headBlock.store(head, std::memory_order_release);
+  }
+
+  HistoryBlock* b = block(head);
+  quint32 count = b -> count.load(std::memory_order_relaxed);
+
+  //a head left full by an interrupted seal
+  if(count >= HISTORY_BLOCK_SAMPLES) {
+    if(!seal(index))
+      return false;
+
+    count = 0;
+  }
+
+  //the clock went backward, wait for it to catch up
+  qint64 last = count > 0 ? b -> samples[count - 1].time : encoder(index).getLastTime();
+  if(time <= last)
+    return false;
+
+  b -> samples[count].time = time;
+  b -> samples[count].value = value;
+  b -> count.store(count + 1, std::memory_order_release);
+
+  if(count + 1 == HISTORY_BLOCK_SAMPLES)
+    seal(index);
+
+  return true;
+}
+
+
+
+/*
+ * Get the object path of the recorded units
+ */
+QStringList HistoryStore::getUnits() const
+{
+  updateIndexes();
+
+  QStringList paths;
+  for(quint32 i = 0; i < indexedUnits; i++)
+    paths << QString::fromUtf8(units[i].path);
+
+  return paths;
+}
+
+
+
+/*
+ * Get the series recorded for a unit
+ *
+ * @param path The unit's object path
+ * @return The kind and attribute id of each series
+ */
+QList<QPair<int, quint8> > HistoryStore::getSeries(const QString& path) const
+{
+  QList<QPair<int, quint8> > list;
+
+  int unit = findUnit(path);
+  if(unit == -1)
+    return list;
+
+  for(quint32 i = 0; i < indexedSeries; i++) {
+    if(series[i].unit == unit)
+      list << qMakePair((int) series[i].kind, series[i].id);
+  }
+
+  return list;
+}
+
+
+
+/*
+ * Get the sealed blocks of a series, oldest first. The blocks are the mapped memory,
+ * valid as long as the store is open, their first HistoryBlock::count samples
+ * (acquire load) being decoded by HistoryDecoder
+ *
+ * @param path The unit's object path
+ * @param kind The recorded value, see HistoryStore::Kind
+ * @param id The SMART attribute id, 0 for the raid counters
+ * @return The blocks, empty if nothing was sealed or the chain is corrupted
+ */
+QVector<const HistoryBlock*> HistoryStore::getSealedBlocks(const QString& path, int kind, quint8 id) const
+{
+  QVector<const HistoryBlock*> blocks;
+
+  int unit = findUnit(path);
+  int index = unit == -1 ? -1 : findSeries(unit, kind, id);
+  if(index == -1)
+    return blocks;
+
+  quint32 blockCount = header -> blockCount.load(std::memory_order_acquire);
+  if(!mapSegments(blockCount))
+    return blocks;
+
+  //a chain can't hold more blocks than allocated, a longer one loops
+  quint32 b = series[index].lastBlock.load(std::memory_order_acquire);
+  while(b != HISTORY_NO_BLOCK && b < blockCount) {
+    if((quint32) blocks.size() >= blockCount) {
+      qWarning() << "HistoryStore => Corrupted block chain for '" << path << "', ignoring its history";
+      blocks.clear();
+      return blocks;
+    }
+
+    const HistoryBlock* current = block(b);
+    blocks.append(current);
+    b = current -> previous;
+  }
+
+  std::reverse(blocks.begin(), blocks.end());
+  return blocks;
+}
+
+
+
+/*
+ * Copy the samples of the head block of a series, not sealed yet
+ *
+ * The head being emptied when sealed, the copy is retried if the writer
+ * sealed it in the meantime
+ *
+ * @param path The unit's object path
+ * @param kind The recorded value, see HistoryStore::Kind
+ * @param id The SMART attribute id, 0 for the raid counters
+ * @param samples Filled with the samples, reusing its storage
+ * @return false if the writer kept sealing the head
+ */
+bool HistoryStore::readHead(const QString& path, int kind, quint8 id, QVector<HistorySample>& samples) const
+{
+  samples.clear();
+
+  int unit = findUnit(path);
+  int index = unit == -1 ? -1 : findSeries(unit, kind, id);
+  if(index == -1)
+    return true;
+
+  const HistorySeries& entry = series[index];
+
+  quint32 blockCount = header -> blockCount.load(std::memory_order_acquire);
+  quint32 head = entry.headBlock.load(std::memory_order_acquire);
+  if(head == HISTORY_NO_BLOCK || head >= blockCount || !mapSegments(blockCount))
+    return true;
+
+  const HistoryBlock* b = block(head);
+
+  for(int attempt = 0; attempt < HISTORY_READ_RETRIES; attempt++) {
+    quint32 sequence = entry.sequence.load(std::memory_order_acquire);
+    if(sequence & 1)
+      continue;
+
+    quint32 count = qMin(b -> count.load(std::memory_order_acquire), (quint32) HISTORY_BLOCK_SAMPLES);
+    samples.resize(count);
+    memcpy(samples.data(), b -> samples, count * sizeof(HistorySample));
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if(entry.sequence.load(std::memory_order_relaxed) == sequence)
+      return true;
+  }
+
+  samples.clear();
+  return false;
+}
+
+
+
+/*
+ * Get the samples of a series in a time range, decoding the sealed blocks
+ * then reading the head
+ *
+ * @param path The unit's object path
+ * @param kind The recorded value, see HistoryStore::Kind
+ * @param id The SMART attribute id, 0 for the raid counters
+ * @param from The start of the range, in milliseconds since epoch
+ * @param to The end of the range, included
+ * @return The samples, oldest first
+ */
+QVector<HistorySample> HistoryStore::getSamples(const QString& path, int kind, quint8 id, qint64 from, qint64 to) const
+{
+  QVector<HistorySample> samples;
+  qint64 sealedUntil = std::numeric_limits<qint64>::min();
+
+  HistorySample sample;
+  foreach(const HistoryBlock* b, getSealedBlocks(path, kind, id)) {
+    HistoryDecoder decoder(b -> data, sizeof(b -> data), b -> count.load(std::memory_order_acquire));
+
+    while(decoder.next(sample.time, sample.value)) {
+      if(sample.time >= from && sample.time <= to)
+        samples.append(sample);
+
+      sealedUntil = sample.time;
+    }
+  }
+
+  //skip the samples of a head being sealed
+  QVector<HistorySample> head;
+  readHead(path, kind, id, head);
+  foreach(const HistorySample& s, head) {
+    if(s.time > sealedUntil && s.time >= from && s.time <= to)
+      samples.append(s);
+  }
+
+  return samples;
+}
+
+
+
+/*
+ * Get the number of blocks allocated in the file
+ */
+int HistoryStore::getBlockCount() const
+{
+  return header != nullptr ? header -> blockCount.load(std::memory_order_acquire) : 0;
+}
+
+
+
+/*
+ * Key of a series in the index
+ */
+quint32 HistoryStore::seriesKey(int unit, int kind, quint8 id)
+{
+  return ((quint32) unit << 16) | ((quint32) kind << 8) | id;
+}
+
+
+
+/*
+ * Index the units and series added since the last call, by this store or
+ * by the writer of the file
+ */
+void HistoryStore::updateIndexes() const
+{
+  if(header == nullptr)
+    return;
+
+  quint32 unitCount = qMin(header -> unitCount.load(std::memory_order_acquire), (quint32) HISTORY_MAX_UNITS);
+  for(; indexedUnits < unitCount; indexedUnits++) {
+    const HistoryUnit& u = units[indexedUnits];
+    unitIndex[QString::fromUtf8(u.path, qstrnlen(u.path, sizeof(u.path)))] = indexedUnits;
+  }
+
+  quint32 seriesCount = qMin(header -> seriesCount.load(std::memory_order_acquire), (quint32) HISTORY_MAX_SERIES);
+  for(; indexedSeries < seriesCount; indexedSeries++) {
+    const HistorySeries& s = series[indexedSeries];
+    seriesIndex[seriesKey(s.unit, s.kind, s.id)] = indexedSeries;
+  }
+}
+
+
+
+/*
+ * Map the segments holding the given number of blocks, growing the file if needed
+ *
+ * @param blocks The number of blocks to reach
+ * @return false if the file couldn't be grown or mapped
+ */
+bool HistoryStore::mapSegments(quint32 blocks) const
+{
+  int needed = (blocks + HISTORY_SEGMENT_BLOCKS - 1) / HISTORY_SEGMENT_BLOCKS;
+
+  while(segments.size() < needed) {
+    qint64 offset = metadataSize() + segments.size() * segmentSize();
+
+    if(file.size() < offset + segmentSize()) {
+      if(readOnly || !file.resize(offset + segmentSize())) {
+        qWarning() << "HistoryStore => Unable to grow '" << file.fileName() << "': " << file.errorString();
+        return false;
+      }
+    }
+
+    uchar* data = file.map(offset, segmentSize());
+    if(data == nullptr) {
+      qWarning() << "HistoryStore => Unable to map '" << file.fileName() << "': " << file.errorString();
+      return false;
+    }
+
+    segments.append(data);
+  }
+
+  return true;
+}
+
+
+
+/*
+ * Get a block from its index, its segment being mapped
+ */
+HistoryBlock* HistoryStore::block(quint32 index) const
+{
+  uchar* segment = segments.at(index / HISTORY_SEGMENT_BLOCKS);
+  return reinterpret_cast<HistoryBlock*>(segment + (index % HISTORY_SEGMENT_BLOCKS) * HISTORY_BLOCK_SIZE);
+}
+
+
+
+/*
+ * Find a unit in the index, -1 if not recorded
+ */
+int HistoryStore::findUnit(const QString& path) const
+{
+  updateIndexes();
+  return unitIndex.value(path, -1);
+}
+
+
+
+/*
+ * Find a series in the index, -1 if not recorded
+ */
+int HistoryStore::findSeries(int unit, int kind, quint8 id) const
+{
+  return seriesIndex.value(seriesKey(unit, kind, id), -1);
+}
+
+
+
+/*
+ * Add a series, and its unit if needed. The entries are written before
+ * being published by incrementing the counts
+ *
+ * @return The index of the series, -1 if a table is full
+ */
+int HistoryStore::addSeries(const QString& path, int kind, quint8 id)
+{
+  int unit = findUnit(path);
+
+  if(unit == -1) {
+    quint32 count = header -> unitCount.load(std::memory_order_relaxed);
+    if(count >= HISTORY_MAX_UNITS) {
+      qWarning() << "HistoryStore => Too many units, '" << path << "' is not recorded";
+      return -1;
+    }
+
+    QByteArray data = path.toUtf8();
+    qstrncpy(units[count].path, data.constData(), sizeof(units[count].path));
+
+    header -> unitCount.store(count + 1, std::memory_order_release);
+    updateIndexes();
+    unit = count;
+  }
+
+  quint32 count = header -> seriesCount.load(std::memory_order_relaxed);
+  if(count >= HISTORY_MAX_SERIES) {
+    qWarning() << "HistoryStore => Too many series, '" << path << "' is not fully recorded";
+    return -1;
+  }
+
+  HistorySeries& s = series[count];
+  s.unit = unit;
+  s.kind = kind;
+  s.id = id;
+  s.headBlock.store(HISTORY_NO_BLOCK, std::memory_order_relaxed);
+  s.lastBlock.store(HISTORY_NO_BLOCK, std::memory_order_relaxed);
+  s.sequence.store(0, std::memory_order_relaxed);
+
+  header -> seriesCount.store(count + 1, std::memory_order_release);
+  updateIndexes();
+
+  return count;
+}
+
+
+
+/*
+ * Allocate a new block for a series, the caller linking it
+ *
+ * The block is initialized before being published in the header. A crash
+ * before the block is linked leaves it unused
+ *
+ * @param entry The series
+ * @param flags HISTORY_BLOCK_COMPRESSED for a sealed block, chained to the
+ *              previous sealed block, 0 for a head block
+ * @return The index of the block, HISTORY_NO_BLOCK if the file couldn't grow
+ */
+quint32 HistoryStore::addBlock(int entry, quint32 flags)
+{
+  quint32 index = header -> blockCount.load(std::memory_order_relaxed);
+  if(index == HISTORY_NO_BLOCK || !mapSegments(index + 1))
+    return HISTORY_NO_BLOCK;
+
+  HistoryBlock* b = block(index);
+  b -> series = entry;
+  b -> previous = flags & HISTORY_BLOCK_COMPRESSED ? series[entry].lastBlock.load(std::memory_order_relaxed) : HISTORY_NO_BLOCK;
+  b -> count.store(0, std::memory_order_relaxed);
+  b -> flags = flags;
+  memset(b -> data, 0, sizeof(b -> data));
+
+  header -> blockCount.store(index + 1, std::memory_order_release);
+
+  return index;
+}
+
+
+
+/*
+ * Get the encoder of the last sealed block of a series, resuming it from the
+ * file on first use
+ */
+HistoryEncoder& HistoryStore::encoder(int entry)
+{
+  QHash<int, HistoryEncoder>::iterator it = encoders.find(entry);
+  if(it != encoders.end())
+    return it.value();
+
+  HistoryEncoder& encoder = encoders[entry];
+
+  quint32 last = series[entry].lastBlock.load(std::memory_order_relaxed);
+  if(last == HISTORY_NO_BLOCK)
+    return encoder;
+
+  HistoryBlock* b = block(last);
+
+  //block allocated by an interrupted seal, the time of the last sealed sample is in the previous one
+  if(b -> count.load(std::memory_order_relaxed) == 0 && b -> previous != HISTORY_NO_BLOCK) {
+    HistoryBlock* previous = block(b -> previous);
+    encoder.resume(previous -> data, sizeof(previous -> data), previous -> count.load(std::memory_order_relaxed));
+  }
+
+  if(!encoder.resume(b -> data, sizeof(b -> data), b -> count.load(std::memory_order_relaxed))) {
+    qWarning() << "HistoryStore => Corrupted block " << last << " in '" << file.fileName() << "'";
+    encoder = HistoryEncoder();
+  }
+
+  return encoder;
+}
+
+
+
+/*
+ * Compress the samples of the head block into the sealed blocks, then empty it
+ *
+ * Samples already sealed by an interrupted seal are skipped, a crash at any
+ * point neither losing nor duplicating samples
+ *
+ * @return false if the file couldn't grow
+ */
+bool HistoryStore::seal(int entry)
+{
+  HistorySeries& s = series[entry];
+  HistoryBlock* head = block(s.headBlock.load(std::memory_order_relaxed));
+  HistoryEncoder& e = encoder(entry);
+
+  quint32 last = s.lastBlock.load(std::memory_order_relaxed);
+  HistoryBlock* sealed = last == HISTORY_NO_BLOCK ? nullptr : block(last);
+
+  quint32 count = head -> count.load(std::memory_order_relaxed);
+  for(quint32 i = 0; i < count; i++) {
+    const HistorySample& sample = head -> samples[i];
+    if(sample.time <= e.getLastTime())
+      continue;
+
+    //current sealed block full, chain a new one
+    if(!e.append(sample.time, sample.value)) {
+      last = addBlock(entry, HISTORY_BLOCK_COMPRESSED);
+      if(last == HISTORY_NO_BLOCK)
+        return false;
+
+      s.lastBlock.store(last, std::memory_order_release);
+      sealed = block(last);
+
+      e.start(sealed -> data, sizeof(sealed -> data));
+      e.append(sample.time, sample.value);
+    }
+
+    sealed -> count.store(e.getCount(), std::memory_order_release);
+  }
+
+  quint32 sequence = s.sequence.load(std::memory_order_relaxed);
+  s.sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  head -> count.store(0, std::memory_order_relaxed);
+
+  s.sequence.store(sequence + 2, std::memory_order_release);
+
+  return true;
+}
+
+
+
+/*
+ * Complete the seals interrupted by a crash of the previous writer
+ */
+void HistoryStore::recover()
+{
+  quint32 blockCount = header -> blockCount.load(std::memory_order_relaxed);
+
+  for(quint32 i = 0; i < indexedSeries; i++) {
+    quint32 head = series[i].headBlock.load(std::memory_order_relaxed);
+    if(head == HISTORY_NO_BLOCK || head >= blockCount)
+      continue;
+
+    const HistoryBlock* b = block(head);
+    quint32 count = b -> count.load(std::memory_order_relaxed);
+
+    if(count >= HISTORY_BLOCK_SAMPLES || (count > 0 && b -> samples[0].time <= encoder(i).getLastTime()))
+      seal(i);
+  }
+}
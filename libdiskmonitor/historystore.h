@@ -0,0 +1,224 @@
+/****************************************************************************
+ * DisKMonitor, KDE tools to monitor SMART and MDRaid health status         *
+ * Copyright (C) 2014-2015 Michaël Lhomme <papylhomme@gmail.com>            *
+ *                                                                          *
+ * This program is free software; you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation; either version 2 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License along  *
+ * with this program; if not, write to the Free Software Foundation, Inc.,  *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.              *
+ ****************************************************************************/
+
+
+
+#ifndef HISTORYSTORE_H
+#define HISTORYSTORE_H
+
+#include <QFile>
+#include <QHash>
+#include <QPair>
+#include <QStringList>
+#include <QVector>
+
+#include <atomic>
+
+#include "historycodec.h"
+#include "storageunit.h"
+
+
+
+//default location of the history recorded by diskmonitord
+#define HISTORY_STORE_FILE "/var/lib/diskmonitor/history"
+
+//layout identification, VERSION must be incremented on each change of the records
+#define HISTORY_STORE_MAGIC 0x53484d48
+#define HISTORY_STORE_VERSION 2
+
+//capacity of the unit and series tables
+#define HISTORY_MAX_UNITS 256
+#define HISTORY_MAX_SERIES 16384
+
+//size of the blocks holding the samples, and number of blocks added when the file grows
+#define HISTORY_BLOCK_SIZE 4096
+#define HISTORY_SEGMENT_BLOCKS 256
+
+//no block, ending the chain of blocks of a series
+#define HISTORY_NO_BLOCK 0xffffffff
+
+//flag of the blocks holding sealed samples compressed by HistoryEncoder
+#define HISTORY_BLOCK_COMPRESSED 0x01
+
+//number of attempts of a reader racing with the writer before giving up
+#define HISTORY_READ_RETRIES 100
+
+
+
+/*
+ * A sample of a series, the time in milliseconds since epoch
+ */
+struct HistorySample {
+  qint64 time;
+  double value;
+};
+
+//number of samples of a block
+#define HISTORY_BLOCK_SAMPLES ((HISTORY_BLOCK_SIZE - 16) / sizeof(HistorySample))
+
+
+
+/*
+ * Fixed size block of a single series: the samples being appended, oldest first,
+ * or the samples sealed once the former was full, compressed in data
+ *
+ * count is only incremented once the sample is written, a sample beyond
+ * count (interrupted append) is never read
+ */
+struct HistoryBlock {
+  quint32 series;
+  quint32 previous;
+  std::atomic<quint32> count;
+  quint32 flags;
+
+  union {
+    HistorySample samples[HISTORY_BLOCK_SAMPLES];
+    uchar data[HISTORY_BLOCK_SIZE - 16];
+  };
+};
+
+
+
+/*
+ * A recorded unit, identified by its object path
+ */
+struct HistoryUnit {
+  char path[128];
+};
+
+
+
+/*
+ * A series of values: a field of a SMART attribute or a counter of a raid array
+ *
+ * New samples go to the head block. Once full, its samples are sealed: compressed
+ * into the chain of blocks ending with lastBlock, then the head is emptied under
+ * the sequence lock
+ */
+struct HistorySeries {
+  quint16 unit;
+  quint8 kind;
+  quint8 id;
+  std::atomic<quint32> headBlock;
+  std::atomic<quint32> lastBlock;
+  std::atomic<quint32> sequence;
+};
+
+
+
+/*
+ * Header of the history file, followed by the unit and series tables, then the blocks
+ *
+ * Entries are written before being published by incrementing the counts, so a file
+ * left by a crashed writer only loses the sample being appended
+ */
+struct HistoryHeader {
+  quint32 magic;
+  quint32 version;
+  quint32 blockSize;
+  quint32 reserved;
+
+  std::atomic<quint32> unitCount;
+  std::atomic<quint32> seriesCount;
+  std::atomic<quint32> blockCount;
+  quint32 reserved2;
+
+  qint64 createdAt;
+};
+
+
+
+/*
+ * Append-only time series store of the SMART attributes and raid counters,
+ * kept in a memory mapped file
+ *
+ * Every series is a head block of raw samples and a chain of sealed blocks,
+ * compressed by HistoryEncoder, indexed by unit and by attribute. The sealed
+ * blocks are decoded in place from the mapping, without any copy. The file grows
+ * by segments of HISTORY_SEGMENT_BLOCKS blocks, each mapped on its own so the
+ * blocks never move
+ *
+ * The samples of a series must be appended in time order
+ */
+class HistoryStore
+{
+public:
+
+  /*
+   * Recorded values
+   */
+  enum Kind {
+    AttributePretty = 0,  //value of the SMART attribute id interpreted by UDisks2
+    AttributeValue = 1,   //normalized value of the SMART attribute id
+    SyncCompleted = 2,    //sync progress of a raid array
+    ReadErrors = 3        //read errors of the members of a raid array
+  };
+
+  HistoryStore(const QString& fileName = HISTORY_STORE_FILE);
+  ~HistoryStore();
+
+  bool open(bool readOnly = false);
+  bool isOpen() const;
+
+  void record(const StorageUnit* unit, qint64 time);
+  bool append(const QString& path, int kind, quint8 id, qint64 time, double value);
+
+  QStringList getUnits() const;
+  QList<QPair<int, quint8> > getSeries(const QString& path) const;
+  QVector<const HistoryBlock*> getSealedBlocks(const QString& path, int kind, quint8 id) const;
+  bool readHead(const QString& path, int kind, quint8 id, QVector<HistorySample>& samples) const;
+  QVector<HistorySample> getSamples(const QString& path, int kind, quint8 id,
+                                    qint64 from = 0, qint64 to = std::numeric_limits<qint64>::max()) const;
+  int getBlockCount() const;
+
+private:
+  mutable QFile file;
+  bool readOnly = false;
+
+  HistoryHeader* header = nullptr;
+  HistoryUnit* units = nullptr;
+  HistorySeries* series = nullptr;
+  mutable QVector<uchar*> segments;
+
+  //in memory indexes: path -> unit, (unit, kind, id) -> series
+  mutable QHash<QString, int> unitIndex;
+  mutable QHash<quint32, int> seriesIndex;
+  mutable quint32 indexedUnits = 0;
+  mutable quint32 indexedSeries = 0;
+
+  //encoders of the last sealed block of the series, resumed on the first seal
+  QHash<int, HistoryEncoder> encoders;
+
+  static quint32 seriesKey(int unit, int kind, quint8 id);
+
+  void updateIndexes() const;
+  bool mapSegments(quint32 blocks) const;
+  HistoryBlock* block(quint32 index) const;
+
+  int findUnit(const QString& path) const;
+  int findSeries(int unit, int kind, quint8 id) const;
+  int addSeries(const QString& path, int kind, quint8 id);
+  quint32 addBlock(int entry, quint32 flags);
+
+  HistoryEncoder& encoder(int entry);
+  bool seal(int entry);
+  void recover();
+};
+
+#endif // HISTORYSTORE_H
@@ -30,12 +30,15 @@
  *
  * @param objectPath The DBus object path to the UDisks2 node represented by this mdraid
  * @param device A string identifying the underlying Linux device (/dev/mdX)
+ * @param interfaces The interfaces of the raid node with their properties, as provided by
+ *                   UDisks2 ObjectManager. Used to fill the properties without calling UDisks2
  *
  * http://udisks.freedesktop.org/docs/latest/gdbus-org.freedesktop.UDisks2.MDRaid.html
  */
-MDRaid::MDRaid(QDBusObjectPath objectPath, QString device) : StorageUnit(objectPath, device)
+MDRaid::MDRaid(QDBusObjectPath objectPath, QString device, const InterfaceList& interfaces) : StorageUnit(objectPath, device)
 {
-  update();
+  this -> shortName = this -> device.split("/").last().toUpper();
+  readInterfaces(interfaces);
 }
 
 
@@ -50,58 +53,102 @@ MDRaid::~MDRaid()
 
 
 /*
- * Update the cached property of this MDRaid
+ * Test if a sync action (check, repair, resync...) is running on the raid array
+ */
+bool MDRaid::isOperationRunning() const
+{
+  return !this -> syncAction.isEmpty() && this -> syncAction != "idle";
+}
+
+
+
+/*
+ * Request an update of the cached property of this MDRaid
+ *
+ * Properties, including the members, are retrieved with a single call. The update
+ * is done asynchronously by the wrapper's worker, completion is notified by updated()
+ * Skipped while the unit is unresponsive
+ *
+ * @see MDRaid::readProperties()
  */
 void MDRaid::update()
 {
-  /*
-   * Retrieve raid properties
-   */
-  QDBusInterface* raidIface = UDisks2Wrapper::instance() -> mdraidIface(objectPath);
+  //unresponsive unit, only report the cached state until the backoff expires
+  if(isPollingSuspended()) {
+    StorageUnit::update();
+    return;
+  }
 
-  this -> failing = getBoolProperty(raidIface, "Degraded");
-  //only set failingStatusKnown if DBus access hasn't failed
-  this -> failingStatusKnown = !raidIface -> lastError().isValid();
+  UDisks2Wrapper::instance() -> requestUpdate(this);
+}
 
-  this -> name = getStringProperty(raidIface, "Name");
-  this -> shortName = this -> device.split("/").last().toUpper();
-  this -> uuid = getStringProperty(raidIface, "UUID");
+
+
+/*
+ * Complete an update of the raid array
+ *
+ * @param failedInterfaces The interfaces which couldn't be read
+ */
+void MDRaid::finishUpdate(const QStringList& failedInterfaces)
+{
+  //only keep failingStatusKnown if DBus access hasn't failed
+  if(failedInterfaces.contains(UDISKS2_MDRAID_IFACE))
+    this -> failingStatusKnown = false;
+
+  StorageUnit::finishUpdate(failedInterfaces);
+}
+
+
+
+/*
+ * Read the properties of the MDRAID_IFACE into the cached fields
+ *
+ * @see StorageUnit::applyProperties()
+ */
+bool MDRaid::readProperties(const QString& interface, const QVariantMap& properties)
+{
+  if(interface != UDISKS2_MDRAID_IFACE)
+    return false;
+
+  bool changed = false;
+
+  if(properties.contains("Degraded")) {
+    changed |= updateField(failing, properties["Degraded"].toBool());
+    changed |= updateField(failingStatusKnown, true);
+  }
+
+  if(properties.contains("UUID"))
+    changed |= updateField(uuid, properties["UUID"].toString());
 
   //always set a name (used in the UI)
-  if(this -> name.isEmpty())
-    this -> name = this -> uuid;
-
-  this -> level = getStringProperty(raidIface, "Level");
-  this -> numDevices = getIntProperty(raidIface, "NumDevices");
-  this -> size = getULongLongProperty(raidIface, "Size");
-  this -> syncAction = getStringProperty(raidIface, "SyncAction");
-  this -> syncCompleted = getDoubleProperty(raidIface, "SyncCompleted");
-  this -> syncRemainingTime = getULongLongProperty(raidIface, "SyncRemainingTime");
-
-  delete raidIface;
-
-
-  /*
-   * Retrieve members properties
-   */
-  QDBusInterface* propIface = UDisks2Wrapper::instance() -> propertiesIface(objectPath);
-
-  //handle ActiveDevices properties using DBus Properties interface as a direct read fails
-  members.clear();
-  QDBusMessage reply = propIface -> call("Get", UDISKS2_MDRAID_IFACE, "ActiveDevices");
-  QVariant v = reply.arguments().first();
-  QDBusArgument arg = v.value<QDBusVariant>().variant().value<QDBusArgument>();
-
-  arg.beginArray();
-  while(!arg.atEnd()) {
-    MDRaidMember m;
-    arg >> m;
-    members << m;
+  if(properties.contains("Name")) {
+    QString newName = properties["Name"].toString();
+    changed |= updateField(name, newName.isEmpty() ? uuid : newName);
   }
 
-  delete propIface;
+  if(properties.contains("Level"))
+    changed |= updateField(level, properties["Level"].toString());
+
+  if(properties.contains("NumDevices"))
+    changed |= updateField(numDevices, properties["NumDevices"].toInt());
+
+  if(properties.contains("Size"))
+    changed |= updateField(size, properties["Size"].toULongLong());
+
+  if(properties.contains("SyncAction"))
+    changed |= updateField(syncAction, properties["SyncAction"].toString());
+
+  if(properties.contains("SyncCompleted"))
+    changed |= updateField(syncCompleted, properties["SyncCompleted"].toDouble());
+
+  if(properties.contains("SyncRemainingTime"))
+    changed |= updateField(syncRemainingTime, properties["SyncRemainingTime"].toULongLong());
+
+  //complex type, received as a QDBusArgument: compare the demarshalled list
+  if(properties.contains("ActiveDevices"))
+    changed |= updateField(members, qdbus_cast<MDRaidMemberList>(properties["ActiveDevices"]));
 
-  StorageUnit::update();
+  return changed;
 }
 
 
@@ -34,7 +34,7 @@ class MDRaid : public StorageUnit
   Q_OBJECT
 
 public:
-  explicit MDRaid(QDBusObjectPath objectPath, QString device);
+  explicit MDRaid(QDBusObjectPath objectPath, QString device, const InterfaceList& interfaces);
   ~MDRaid() override;
 
   int getNumDevices() const;
@@ -53,6 +53,7 @@ public:
 
 
   virtual bool isMDRaid() const override { return true; }
+  virtual bool isOperationRunning() const override;
 
 protected:
   int numDevices = 0;
@@ -66,6 +67,9 @@ protected:
   QString syncAction;
 
   MDRaidMemberList members;
+
+  virtual bool readProperties(const QString& interface, const QVariantMap& properties) override;
+  virtual void finishUpdate(const QStringList& failedInterfaces) override;
 };
 
 #endif // MDRAID_H
@@ -0,0 +1,116 @@
+/****************************************************************************
+ * DisKMonitor, KDE tools to monitor SMART and MDRaid health status         *
+ * Copyright (C) 2014-2015 Michaël Lhomme <papylhomme@gmail.com>            *
+ *                                                                          *
+ * This program is free software; you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation; either version 2 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License along  *
+ * with this program; if not, write to the Free Software Foundation, Inc.,  *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.              *
+ ****************************************************************************/
+
+
+
+#include "remoteunit.h"
+
+#include "drive.h"
+
+
+
+/*
+ * Initialize a new RemoteUnit
+ *
+ * @param objectPath The DBus object path to the UDisks2 node represented by this unit
+ * @param health The unit's health snapshot
+ */
+RemoteUnit::RemoteUnit(QDBusObjectPath objectPath, const QVariantMap& health) :
+  StorageUnit(objectPath, health["Device"].toString())
+{
+  readSnapshot(health);
+}
+
+
+
+/*
+ * Destructor
+ */
+RemoteUnit::~RemoteUnit()
+{
+
+}
+
+
+
+/*
+ * Test if the drive was in standby on its last refresh by the daemon
+ */
+bool RemoteUnit::isStandby() const
+{
+  return this -> standby;
+}
+
+
+
+/*
+ * Build the health snapshot of a unit, as exported by diskmonitord
+ *
+ * @param unit The unit
+ * @return A map of the health values, see org.papylhomme.DiskMonitor.xml
+ */
+QVariantMap RemoteUnit::snapshot(const StorageUnit* unit)
+{
+  QVariantMap health;
+
+  health["Device"] = unit -> getDevice();
+  health["Name"] = unit -> getName();
+  health["ShortName"] = unit -> getShortName();
+  health["Type"] = unit -> isMDRaid() ? "mdraid" : "drive";
+  health["Removable"] = unit -> isRemovable();
+  health["Failing"] = unit -> isFailing();
+  health["FailingStatusKnown"] = unit -> isFailingStatusKnown();
+  health["Warning"] = unit -> isWarning();
+  health["Unresponsive"] = unit -> isUnresponsive();
+  health["Standby"] = unit -> isDrive() && static_cast<const Drive*>(unit) -> isStandby();
+  health["OperationRunning"] = unit -> isOperationRunning();
+  health["LastChangeTime"] = unit -> getLastChangeTime();
+
+  return health;
+}
+
+
+
+/*
+ * Read a health snapshot into the cached fields
+ *
+ * @param health The unit's health snapshot, as built by RemoteUnit::snapshot()
+ * @return true if something changed
+ */
+bool RemoteUnit::readSnapshot(const QVariantMap& health)
+{
+  bool changed = false;
+
+  changed |= updateField(this -> name, health["Name"].toString());
+  changed |= updateField(this -> shortName, health["ShortName"].toString());
+  changed |= updateField(this -> type, health["Type"].toString());
+  changed |= updateField(this -> removable, health["Removable"].toBool());
+  changed |= updateField(this -> failing, health["Failing"].toBool());
+  changed |= updateField(this -> failingStatusKnown, health["FailingStatusKnown"].toBool());
+  changed |= updateField(this -> warning, health["Warning"].toBool());
+  changed |= updateField(this -> standby, health["Standby"].toBool());
+  changed |= updateField(this -> operationRunning, health["OperationRunning"].toBool());
+  changed |= updateField(this -> lastChangeTime, health["LastChangeTime"].toLongLong());
+
+  //the daemon owns the circuit breaker, mirror its outcome
+  int timeouts = health["Unresponsive"].toBool() ? UNRESPONSIVE_TIMEOUT_COUNT : 0;
+  changed |= updateField(this -> consecutiveTimeouts, timeouts);
+
+  return changed;
+}
@@ -0,0 +1,62 @@
+/****************************************************************************
+ * DisKMonitor, KDE tools to monitor SMART and MDRaid health status         *
+ * Copyright (C) 2014-2015 Michaël Lhomme <papylhomme@gmail.com>            *
+ *                                                                          *
+ * This program is free software; you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation; either version 2 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License along  *
+ * with this program; if not, write to the Free Software Foundation, Inc.,  *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.              *
+ ****************************************************************************/
+
+
+
+#ifndef REMOTEUNIT_H
+#define REMOTEUNIT_H
+
+#include "storageunit.h"
+
+#include "dbus_metatypes.h"
+
+
+/*
+ * Represent a unit monitored by diskmonitord, built from the health
+ * snapshot exported by the daemon
+ */
+class RemoteUnit : public StorageUnit
+{
+  Q_OBJECT
+
+  friend class DaemonClient;
+
+public:
+  explicit RemoteUnit(QDBusObjectPath objectPath, const QVariantMap& health);
+  ~RemoteUnit() override;
+
+  bool isStandby() const;
+
+  virtual bool isDrive() const override { return type == "drive"; }
+  virtual bool isMDRaid() const override { return type == "mdraid"; }
+  virtual bool isRemovable() const override { return removable; }
+  virtual bool isOperationRunning() const override { return operationRunning; }
+
+  static QVariantMap snapshot(const StorageUnit* unit);
+
+protected:
+  QString type;
+  bool removable = false;
+  bool standby = false;
+  bool operationRunning = false;
+
+  bool readSnapshot(const QVariantMap& health);
+};
+
+#endif // REMOTEUNIT_H
@@ -0,0 +1,275 @@
+/****************************************************************************
+ * DisKMonitor, KDE tools to monitor SMART and MDRaid health status         *
+ * Copyright (C) 2014-2015 Michaël Lhomme <papylhomme@gmail.com>            *
+ *                                                                          *
+ * This program is free software; you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation; either version 2 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License along  *
+ * with this program; if not, write to the Free Software Foundation, Inc.,  *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.              *
+ ****************************************************************************/
+
+
+
+#include "smartattributetable.h"
+
+#include <QHash>
+#include <QMutex>
+#include <QStringList>
+
+#include <string.h>
+
+
+
+/*
+ * Names of the SMART attributes, shared by every table
+ */
+struct SmartAttributeNames {
+  QMutex mutex;
+  QStringList names;
+  QHash<QString, quint16> indexes;
+};
+
+Q_GLOBAL_STATIC(SmartAttributeNames, smartAttributeNames)
+
+
+
+/*
+ * Constructor. Create an empty table
+ */
+SmartAttributeTable::SmartAttributeTable()
+{
+  clear();
+}
+
+
+
+/*
+ * Remove every attribute. The normalized values, worst values and thresholds
+ * of the free slots are unknown (-1)
+ */
+void SmartAttributeTable::clear()
+{
+  memset(present, 0, sizeof(present));
+  count = 0;
+
+  for(int id = 0; id < SMART_ATTRIBUTE_SLOTS; id++) {
+    valueSlots[id] = -1;
+    worstSlots[id] = -1;
+    thresholdSlots[id] = -1;
+  }
+
+  memset(prettySlots, 0, sizeof(prettySlots));
+  memset(flagsSlots, 0, sizeof(flagsSlots));
+  memset(nameSlots, 0, sizeof(nameSlots));
+  memset(unitSlots, 0, sizeof(unitSlots));
+}
+
+
+
+/*
+ * Replace the content of the table with the given attributes
+ *
+ * @param attributes The attributes, as retrieved from UDisks2
+ */
+void SmartAttributeTable::assign(const SmartAttributesList& attributes)
+{
+  clear();
+
+  foreach(const SmartAttribute& attr, attributes) {
+    quint8 id = attr.id;
+
+    if(!contains(id))
+      count++;
+
+    present[id / 64] |= Q_UINT64_C(1) << (id % 64);
+    valueSlots[id] = attr.value;
+    worstSlots[id] = attr.worst;
+    thresholdSlots[id] = attr.threshold;
+    prettySlots[id] = attr.pretty;
+    flagsSlots[id] = attr.flags;
+    nameSlots[id] = internName(attr.name);
+    unitSlots[id] = attr.pretty_unit;
+  }
+}
+
+
+
+/*
+ * Get the number of attributes in the table
+ */
+int SmartAttributeTable::size() const
+{
+  return count;
+}
+
+
+
+/*
+ * Test if the drive reports the given attribute
+ */
+bool SmartAttributeTable::contains(quint8 id) const
+{
+  return present[id / 64] & (Q_UINT64_C(1) << (id % 64));
+}
+
+
+
+/*
+ * Get the 256 bits mask of the reported attributes, as 4 words, bit n of the
+ * mask (bit n % 64 of word n / 64) being set if attribute n is reported
+ */
+const quint64* SmartAttributeTable::presenceMask() const
+{
+  return present;
+}
+
+
+
+/*
+ * Get the name of an attribute, empty if not reported
+ */
+QString SmartAttributeTable::name(quint8 id) const
+{
+  return contains(id) ? internedName(nameSlots[id]) : QString();
+}
+
+
+
+/*
+ * Get the flags of an attribute
+ */
+quint16 SmartAttributeTable::flags(quint8 id) const
+{
+  return flagsSlots[id];
+}
+
+
+
+/*
+ * Get the normalized value of an attribute, -1 if unknown
+ */
+qint32 SmartAttributeTable::value(quint8 id) const
+{
+  return valueSlots[id];
+}
+
+
+
+/*
+ * Get the worst normalized value of an attribute, -1 if unknown
+ */
+qint32 SmartAttributeTable::worst(quint8 id) const
+{
+  return worstSlots[id];
+}
+
+
+
+/*
+ * Get the threshold of an attribute, -1 if unknown
+ */
+qint32 SmartAttributeTable::threshold(quint8 id) const
+{
+  return thresholdSlots[id];
+}
+
+
+
+/*
+ * Get the value of an attribute interpreted by UDisks2, -1 if not reported
+ */
+qint64 SmartAttributeTable::pretty(quint8 id) const
+{
+  return contains(id) ? prettySlots[id] : -1;
+}
+
+
+
+/*
+ * Get the unit of the interpreted value (see SmartAttribute::pretty_unit)
+ */
+quint8 SmartAttributeTable::unit(quint8 id) const
+{
+  return unitSlots[id];
+}
+
+
+
+/*
+ * Get the SMART_ATTRIBUTE_SLOTS normalized values, indexed by attribute id
+ */
+const qint32* SmartAttributeTable::values() const
+{
+  return valueSlots;
+}
+
+
+
+/*
+ * Get the SMART_ATTRIBUTE_SLOTS thresholds, indexed by attribute id
+ */
+const qint32* SmartAttributeTable::thresholds() const
+{
+  return thresholdSlots;
+}
+
+
+
+/*
+ * Get the SMART_ATTRIBUTE_SLOTS interpreted values, indexed by attribute id
+ */
+const qint64* SmartAttributeTable::prettyValues() const
+{
+  return prettySlots;
+}
+
+
+
+/*
+ * Get the index of a name in the shared table, adding it if needed
+ *
+ * Drives report the same few dozens of names, each one being stored once
+ */
+quint16 SmartAttributeTable::internName(const QString& name)
+{
+  SmartAttributeNames* table = smartAttributeNames;
+  QMutexLocker locker(&table -> mutex);
+
+  QHash<QString, quint16>::const_iterator it = table -> indexes.constFind(name);
+  if(it != table -> indexes.constEnd())
+    return it.value();
+
+  //the table is full, names are shared by the drives and this should never happen
+  if(table -> names.size() > 0xffff)
+    return 0;
+
+  quint16 index = table -> names.size();
+  table -> names << name;
+  table -> indexes[name] = index;
+
+  return index;
+}
+
+
+
+/*
+ * Get a name from the shared table
+ *
+ * @param index The index returned by SmartAttributeTable::internName()
+ */
+QString SmartAttributeTable::internedName(quint16 index)
+{
+  SmartAttributeNames* table = smartAttributeNames;
+  QMutexLocker locker(&table -> mutex);
+
+  return table -> names.value(index);
+}
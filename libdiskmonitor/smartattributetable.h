@@ -0,0 +1,84 @@
+/****************************************************************************
+ * DisKMonitor, KDE tools to monitor SMART and MDRaid health status         *
+ * Copyright (C) 2014-2015 Michaël Lhomme <papylhomme@gmail.com>            *
+ *                                                                          *
+ * This program is free software; you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation; either version 2 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License along  *
+ * with this program; if not, write to the Free Software Foundation, Inc.,  *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.              *
+ ****************************************************************************/
+
+
+
+#ifndef SMARTATTRIBUTETABLE_H
+#define SMARTATTRIBUTETABLE_H
+
+#include <QString>
+
+#include "dbus_metatypes.h"
+
+
+
+//one slot per possible attribute id
+#define SMART_ATTRIBUTE_SLOTS 256
+
+
+
+/*
+ * Dense storage of the SMART attributes of a drive, indexed by attribute id
+ *
+ * Each field is kept in its own array of SMART_ATTRIBUTE_SLOTS values, the presence
+ * of an attribute being given by a 256 bits mask. Names are interned in a table shared
+ * by every drive. Evaluating a field over a whole fleet of drives only reads
+ * contiguous memory, without allocation
+ */
+class SmartAttributeTable
+{
+public:
+  SmartAttributeTable();
+
+  void assign(const SmartAttributesList& attributes);
+  void clear();
+
+  int size() const;
+  bool contains(quint8 id) const;
+  const quint64* presenceMask() const;
+
+  QString name(quint8 id) const;
+  quint16 flags(quint8 id) const;
+  qint32 value(quint8 id) const;
+  qint32 worst(quint8 id) const;
+  qint32 threshold(quint8 id) const;
+  qint64 pretty(quint8 id) const;
+  quint8 unit(quint8 id) const;
+
+  const qint32* values() const;
+  const qint32* thresholds() const;
+  const qint64* prettyValues() const;
+
+  static quint16 internName(const QString& name);
+  static QString internedName(quint16 index);
+
+private:
+  quint64 present[SMART_ATTRIBUTE_SLOTS / 64];
+  int count;
+
+  qint32 valueSlots[SMART_ATTRIBUTE_SLOTS];
+  qint32 worstSlots[SMART_ATTRIBUTE_SLOTS];
+  qint32 thresholdSlots[SMART_ATTRIBUTE_SLOTS];
+  qint64 prettySlots[SMART_ATTRIBUTE_SLOTS];
+  quint16 flagsSlots[SMART_ATTRIBUTE_SLOTS];
+  quint16 nameSlots[SMART_ATTRIBUTE_SLOTS];
+  quint8 unitSlots[SMART_ATTRIBUTE_SLOTS];
+};
+
+#endif // SMARTATTRIBUTETABLE_H
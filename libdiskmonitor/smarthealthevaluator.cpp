@@ -0,0 +1,243 @@
+/****************************************************************************
+ * DisKMonitor, KDE tools to monitor SMART and MDRaid health status         *
+ * Copyright (C) 2014-2015 Michaël Lhomme <papylhomme@gmail.com>            *
+ *                                                                          *
+ * This program is free software; you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation; either version 2 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License along  *
+ * with this program; if not, write to the Free Software Foundation, Inc.,  *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.              *
+ ****************************************************************************/
+
+
+
+#include "smarthealthevaluator.h"
+
+#include "drive.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) && !defined(DISKMONITOR_NO_SIMD)
+#define SMART_HEALTH_SSE2
+#include <emmintrin.h>
+#endif
+
+
+
+/*
+ * Test if the value of an attribute is at or below its threshold
+ */
+bool SmartHealth::isBelowThreshold(quint8 id) const
+{
+  return belowThreshold[id / 64] & (Q_UINT64_C(1) << (id % 64));
+}
+
+
+
+/*
+ * Test if a sensitive attribute has a non zero value
+ */
+bool SmartHealth::isSensitiveNonZero(quint8 id) const
+{
+  return sensitiveNonZero[id / 64] & (Q_UINT64_C(1) << (id % 64));
+}
+
+
+
+/*
+ * Test if any attribute is at or below its threshold, the drive being failing
+ */
+bool SmartHealth::hasBelowThreshold() const
+{
+  return (belowThreshold[0] | belowThreshold[1] | belowThreshold[2] | belowThreshold[3]) != 0;
+}
+
+
+
+/*
+ * Test if any sensitive attribute has a non zero value, the drive deserving a warning
+ */
+bool SmartHealth::hasSensitiveNonZero() const
+{
+  return (sensitiveNonZero[0] | sensitiveNonZero[1] | sensitiveNonZero[2] | sensitiveNonZero[3]) != 0;
+}
+
+
+
+/*
+ * Constructor. No attribute is sensitive
+ */
+SmartHealthEvaluator::SmartHealthEvaluator()
+{
+  memset(sensitive, 0, sizeof(sensitive));
+}
+
+
+
+/*
+ * Set the sensitive attributes, whose non zero values deserve a warning
+ *
+ * @param ids The ids of the attributes, as configured in the settings
+ */
+void SmartHealthEvaluator::setSensitiveAttributes(const QList<int>& ids)
+{
+  memset(sensitive, 0, sizeof(sensitive));
+
+  foreach(int id, ids) {
+    if(id >= 0 && id < SMART_ATTRIBUTE_SLOTS)
+      sensitive[id / 64] |= Q_UINT64_C(1) << (id % 64);
+  }
+}
+
+
+
+/*
+ * Test if an attribute is sensitive
+ */
+bool SmartHealthEvaluator::isSensitive(quint8 id) const
+{
+  return sensitive[id / 64] & (Q_UINT64_C(1) << (id % 64));
+}
+
+
+
+/*
+ * Get the 256 bits mask of the sensitive attributes
+ */
+const quint64* SmartHealthEvaluator::sensitiveMask() const
+{
+  return sensitive;
+}
+
+
+
+/*
+ * Test if the comparisons are vectorized
+ */
+bool SmartHealthEvaluator::isSimdEnabled()
+{
+#ifdef SMART_HEALTH_SSE2
+  return true;
+#else
+  return false;
+#endif
+}
+
+
+
+/*
+ * Evaluate the attributes of a drive, one attribute at a time
+ *
+ * Reference implementation, used when SIMD is not available
+ */
+SmartHealth SmartHealthEvaluator::evaluateScalar(const SmartAttributeTable& table) const
+{
+  SmartHealth health;
+  memset(&health, 0, sizeof(health));
+
+  const qint32* values = table.values();
+  const qint32* thresholds = table.thresholds();
+  const qint64* pretty = table.prettyValues();
+  const quint64* present = table.presenceMask();
+
+  for(int id = 0; id < SMART_ATTRIBUTE_SLOTS; id++) {
+    quint64 bit = Q_UINT64_C(1) << (id % 64);
+    if(!(present[id / 64] & bit) || values[id] == -1)
+      continue;
+
+    if(values[id] <= thresholds[id])
+      health.belowThreshold[id / 64] |= bit;
+
+    if(pretty[id] != 0 && (sensitive[id / 64] & bit))
+      health.sensitiveNonZero[id / 64] |= bit;
+  }
+
+  return health;
+}
+
+
+
+/*
+ * Evaluate the attributes of a drive
+ *
+ * With SSE2, 4 values are compared to their thresholds at once, and 2 interpreted
+ * values to zero, the lanes being gathered in the masks with movemask. The masks
+ * are then restricted to the reported attributes
+ */
+SmartHealth SmartHealthEvaluator::evaluate(const SmartAttributeTable& table) const
+{
+#ifdef SMART_HEALTH_SSE2
+  SmartHealth health;
+  memset(&health, 0, sizeof(health));
+
+  quint64 nonZero[SMART_ATTRIBUTE_SLOTS / 64] = { 0, 0, 0, 0 };
+  quint64 known[SMART_ATTRIBUTE_SLOTS / 64] = { 0, 0, 0, 0 };
+
+  const qint32* values = table.values();
+  const qint32* thresholds = table.thresholds();
+  const qint64* pretty = table.prettyValues();
+  const quint64* present = table.presenceMask();
+
+  const __m128i unknownValue = _mm_set1_epi32(-1);
+  const __m128i zero = _mm_setzero_si128();
+
+  for(int id = 0; id < SMART_ATTRIBUTE_SLOTS; id += 4) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + id));
+    __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i*>(thresholds + id));
+
+    //value <= threshold is !(value > threshold)
+    int above = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(v, t)));
+    int unknown = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, unknownValue)));
+
+    health.belowThreshold[id / 64] |= (quint64) (~above & 0xf) << (id % 64);
+    known[id / 64] |= (quint64) (~unknown & 0xf) << (id % 64);
+  }
+
+  for(int id = 0; id < SMART_ATTRIBUTE_SLOTS; id += 2) {
+    __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pretty + id));
+
+    //64 bits equality from the 32 bits one, both halves being zero
+    __m128i z = _mm_cmpeq_epi32(r, zero);
+    z = _mm_and_si128(z, _mm_shuffle_epi32(z, _MM_SHUFFLE(2, 3, 0, 1)));
+
+    int isZero = _mm_movemask_pd(_mm_castsi128_pd(z));
+    nonZero[id / 64] |= (quint64) (~isZero & 0x3) << (id % 64);
+  }
+
+  for(int w = 0; w < SMART_ATTRIBUTE_SLOTS / 64; w++) {
+    quint64 valid = present[w] & known[w];
+    health.belowThreshold[w] &= valid;
+    health.sensitiveNonZero[w] = nonZero[w] & sensitive[w] & valid;
+  }
+
+  return health;
+#else
+  return evaluateScalar(table);
+#endif
+}
+
+
+
+/*
+ * Evaluate the attributes of a fleet of drives
+ *
+ * @param drives The drives to evaluate
+ * @return The health of each drive, in the order of the list
+ */
+QVector<SmartHealth> SmartHealthEvaluator::evaluate(const QList<Drive*>& drives) const
+{
+  QVector<SmartHealth> result(drives.size());
+
+  for(int i = 0; i < drives.size(); i++)
+    result[i] = evaluate(drives.at(i) -> getSMARTAttributeTable());
+
+  return result;
+}
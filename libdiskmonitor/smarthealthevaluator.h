@@ -0,0 +1,80 @@
+/****************************************************************************
+ * DisKMonitor, KDE tools to monitor SMART and MDRaid health status         *
+ * Copyright (C) 2014-2015 Michaël Lhomme <papylhomme@gmail.com>            *
+ *                                                                          *
+ * This program is free software; you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation; either version 2 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License along  *
+ * with this program; if not, write to the Free Software Foundation, Inc.,  *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.              *
+ ****************************************************************************/
+
+
+
+#ifndef SMARTHEALTHEVALUATOR_H
+#define SMARTHEALTHEVALUATOR_H
+
+#include <QList>
+#include <QVector>
+
+#include "smartattributetable.h"
+
+class Drive;
+
+
+
+/*
+ * Health of the SMART attributes of a drive, as 256 bits masks indexed by attribute id
+ */
+struct SmartHealth {
+  //known normalized value at or below the threshold
+  quint64 belowThreshold[SMART_ATTRIBUTE_SLOTS / 64];
+
+  //sensitive attribute with a known value and a non zero interpreted value
+  quint64 sensitiveNonZero[SMART_ATTRIBUTE_SLOTS / 64];
+
+  bool isBelowThreshold(quint8 id) const;
+  bool isSensitiveNonZero(quint8 id) const;
+
+  bool hasBelowThreshold() const;
+  bool hasSensitiveNonZero() const;
+};
+
+
+
+/*
+ * Evaluate the SMART attributes of the drives against their thresholds and
+ * the set of sensitive attributes, a whole fleet at once
+ *
+ * The attribute tables being laid out as structure of arrays, the comparisons
+ * are done with SSE2 when available, a scalar implementation being used otherwise
+ * (or when DISKMONITOR_NO_SIMD is defined)
+ */
+class SmartHealthEvaluator
+{
+public:
+  SmartHealthEvaluator();
+
+  void setSensitiveAttributes(const QList<int>& ids);
+  bool isSensitive(quint8 id) const;
+  const quint64* sensitiveMask() const;
+
+  SmartHealth evaluate(const SmartAttributeTable& table) const;
+  SmartHealth evaluateScalar(const SmartAttributeTable& table) const;
+  QVector<SmartHealth> evaluate(const QList<Drive*>& drives) const;
+
+  static bool isSimdEnabled();
+
+private:
+  quint64 sensitive[SMART_ATTRIBUTE_SLOTS / 64];
+};
+
+#endif // SMARTHEALTHEVALUATOR_H
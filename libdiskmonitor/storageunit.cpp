@@ -20,6 +20,9 @@
 
 #include "storageunit.h"
 
+#include "udisks2wrapper.h"
+#include "healthruleengine.h"
+
 #include <QDebug>
 
 
@@ -128,11 +131,12 @@ QString StorageUnit::getShortName() const
 
 
 /*
- * Test if this unit is considered failing
+ * Test if this unit is considered failing, either reported by UDisks2
+ * or matching the failing health rule
  */
 bool StorageUnit::isFailing() const
 {
-  return this -> failing;
+  return this -> failing || this -> ruleFailing;
 }
 
 
@@ -142,78 +146,253 @@ bool StorageUnit::isFailing() const
  */
 bool StorageUnit::isFailingStatusKnown() const
 {
-  return this -> failingStatusKnown;
+  return this -> failingStatusKnown && !isUnresponsive();
 }
 
 
 
 /*
- * Retrieve a property on the UDisks2 node identified by name
- *
- * @param iface The DBus interface containing the property
- * @param name The name of the property to retrieve
+ * Test if this unit matches the warning health rule
+ */
+bool StorageUnit::isWarning() const
+{
+  return this -> warning;
+}
+
+
+
+/*
+ * Get the time of the last change of the unit's properties, in milliseconds
+ * since epoch. 0 if nothing changed since the unit's creation
+ */
+qint64 StorageUnit::getLastChangeTime() const
+{
+  return this -> lastChangeTime;
+}
+
+
+
+/*
+ * Test if a UDisks2 job (self test, scrubbing...) is running on the unit
+ */
+bool StorageUnit::hasJob() const
+{
+  return !this -> jobPath.path().isEmpty();
+}
+
+
+
+/*
+ * Get the operation of the running job, as reported by UDisks2 (ata-smart-selftest, ...)
+ */
+QString StorageUnit::getJobOperation() const
+{
+  return this -> jobOperation;
+}
+
+
+
+/*
+ * Get the progress of the running job, between 0 and 1. -1 if unknown
+ */
+double StorageUnit::getJobProgress() const
+{
+  return this -> jobProgressValid ? this -> jobProgress : -1;
+}
+
+
+
+/*
+ * Get the rate of the running job in bytes per second. 0 if unknown
+ */
+quint64 StorageUnit::getJobRate() const
+{
+  return this -> jobRate;
+}
+
+
+
+/*
+ * Get the expected end time of the running job. Invalid if unknown
  */
-QVariant StorageUnit::getProperty(QDBusInterface* iface, const char* name)
+QDateTime StorageUnit::getJobExpectedEndTime() const
 {
-  QVariant prop = iface -> property(name);
-  if(!prop.isValid())
-    qCritical() << "Unable to read property '" << name <<
-                "' from interface '" << iface -> interface() << "': " <<
-                iface -> lastError();
+  if(this -> jobExpectedEndTime == 0)
+    return QDateTime();
 
-  return prop;
+  return QDateTime::fromMSecsSinceEpoch(this -> jobExpectedEndTime / 1000);
 }
 
 
 
 /*
- * Convenience wrapper around StorageUnit::getProperty() for bool type (DBus type 'b')
+ * Test if the unit is considered unresponsive, its last
+ * UNRESPONSIVE_TIMEOUT_COUNT updates having timed out
  */
-bool StorageUnit::getBoolProperty(QDBusInterface* iface, const char* name)
+bool StorageUnit::isUnresponsive() const
 {
-  return getProperty(iface, name).toBool();
+  return this -> consecutiveTimeouts >= UNRESPONSIVE_TIMEOUT_COUNT;
 }
 
 
 
 /*
- * Convenience wrapper around StorageUnit::getProperty() for int type (DBus type 'i')
+ * Update the cached properties of the unit from a map of properties
+ * belonging to the given interface, and emit updated() if something changed.
+ *
+ * Used to apply the changes notified by UDisks2 without reading back every property
+ *
+ * @param interface The DBus interface owning the properties
+ * @param properties A map of property names and values, may contain only a subset of the interface's properties
+ */
+void StorageUnit::applyProperties(const QString& interface, const QVariantMap& properties)
+{
+  if(updateProperties(interface, properties)) {
+    fetchOutdatedData();
+    HealthRuleEngine::instance() -> evaluate(this);
+    emit updated(this);
+  }
+}
+
+
+
+/*
+ * Read updated properties into the cached fields, recording the time of the change
+ *
+ * @param interface The DBus interface owning the properties
+ * @param properties A map of property names and values
+ * @return true if something changed
+ */
+bool StorageUnit::updateProperties(const QString& interface, const QVariantMap& properties)
+{
+  if(!readProperties(interface, properties))
+    return false;
+
+  this -> lastChangeTime = QDateTime::currentMSecsSinceEpoch();
+  return true;
+}
+
+
+
+/*
+ * Read the properties of every interface of the node, as provided by
+ * UDisks2 ObjectManager, into the cached fields
+ *
+ * @param interfaces The node's interfaces with their properties
  */
-int StorageUnit::getIntProperty(QDBusInterface* iface, const char* name)
+void StorageUnit::readInterfaces(const InterfaceList& interfaces)
 {
-  return getProperty(iface, name).toInt();
+  foreach(const QString& interface, interfaces.keys())
+    readProperties(interface, interfaces[interface]);
 }
 
 
 
 /*
- * Convenience wrapper around StorageUnit::getProperty() for int ulonglong (DBus type 't')
+ * Called when the worker has completed an update requested by StorageUnit::update(),
+ * the retrieved properties being already read. Apply the health rules and notify
+ * the listeners with updated()
+ *
+ * @param failedInterfaces The interfaces which couldn't be read
  */
-qulonglong StorageUnit::getULongLongProperty(QDBusInterface* iface, const char* name)
+void StorageUnit::finishUpdate(const QStringList& /*failedInterfaces*/)
 {
-  return getProperty(iface, name).toULongLong();
+  HealthRuleEngine::instance() -> evaluate(this);
+  emit updated(this);
 }
 
 
 
 /*
- * Convenience wrapper around StorageUnit::getProperty() for double type (DBus type 'd')
+ * Read the properties of a UDisks2 job running on the unit and emit jobChanged()
+ *
+ * http://udisks.freedesktop.org/docs/latest/gdbus-org.freedesktop.UDisks2.Job.html
+ *
+ * @param jobPath The job's node
+ * @param properties A map of property names and values, may contain only a subset of the job's properties
  */
-double StorageUnit::getDoubleProperty(QDBusInterface* iface, const char* name)
+void StorageUnit::applyJobProperties(const QDBusObjectPath& jobPath, const QVariantMap& properties)
 {
-  return getProperty(iface, name).toDouble();
+  this -> jobPath = jobPath;
+
+  if(properties.contains("Operation"))
+    this -> jobOperation = properties["Operation"].toString();
+
+  if(properties.contains("Progress"))
+    this -> jobProgress = properties["Progress"].toDouble();
+
+  if(properties.contains("ProgressValid"))
+    this -> jobProgressValid = properties["ProgressValid"].toBool();
+
+  if(properties.contains("Rate"))
+    this -> jobRate = properties["Rate"].toULongLong();
+
+  if(properties.contains("ExpectedEndTime"))
+    this -> jobExpectedEndTime = properties["ExpectedEndTime"].toULongLong();
+
+  emit jobChanged(this);
 }
 
 
 
 /*
- * Convenience wrapper around StorageUnit::getProperty() for string type (DBus type 's')
+ * Called when the job running on the unit has completed. Clear the job's state
+ * and update the unit to read the outcome of the operation
+ *
+ * @param jobPath The completed job's node
  */
-QString StorageUnit::getStringProperty(QDBusInterface* iface, const char* name)
+void StorageUnit::finishJob(const QDBusObjectPath& jobPath)
 {
-  return getProperty(iface, name).toString();
+  if(jobPath != this -> jobPath)
+    return;
+
+  this -> jobPath = QDBusObjectPath();
+  this -> jobOperation.clear();
+  this -> jobProgress = 0;
+  this -> jobProgressValid = false;
+  this -> jobRate = 0;
+  this -> jobExpectedEndTime = 0;
+
+  emit jobChanged(this);
+  update();
 }
 
 
 
+/*
+ * Update the circuit breaker with the outcome of the last update
+ *
+ * Once unresponsive, the polling of the unit is suspended for UNRESPONSIVE_BACKOFF_MIN
+ * seconds, doubled on each new timeout up to UNRESPONSIVE_BACKOFF_MAX. A successful
+ * update closes the breaker
+ *
+ * @param timedOut true if a call of the update has timed out
+ */
+void StorageUnit::recordTimeout(bool timedOut)
+{
+  if(!timedOut) {
+    this -> consecutiveTimeouts = 0;
+    this -> suspendedUntil = 0;
+    return;
+  }
+
+  this -> consecutiveTimeouts++;
+  if(!isUnresponsive())
+    return;
+
+  int exponent = qMin(this -> consecutiveTimeouts - UNRESPONSIVE_TIMEOUT_COUNT, 16);
+  qint64 backoff = qMin((qint64) UNRESPONSIVE_BACKOFF_MIN << exponent, (qint64) UNRESPONSIVE_BACKOFF_MAX);
+  this -> suspendedUntil = QDateTime::currentMSecsSinceEpoch() + backoff * 1000;
+
+  qWarning() << "Unit '" << getPath() << "' is unresponsive, polling suspended for " << backoff << "s";
+}
+
 
+
+/*
+ * Test if the polling of the unit is suspended by the circuit breaker
+ */
+bool StorageUnit::isPollingSuspended() const
+{
+  return QDateTime::currentMSecsSinceEpoch() < this -> suspendedUntil;
+}
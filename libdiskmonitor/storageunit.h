@@ -21,8 +21,22 @@
 #ifndef STORAGEUNIT_H
 #define STORAGEUNIT_H
 
+#include <QObject>
+#include <QVariantMap>
 #include <QDBusObjectPath>
-#include <QDBusInterface>
+#include <QDateTime>
+
+#include "dbus_metatypes.h"
+
+
+
+//number of consecutive timeouts before a unit is considered unresponsive
+#define UNRESPONSIVE_TIMEOUT_COUNT 3
+
+//polling backoff of an unresponsive unit in seconds, doubled on each new timeout
+#define UNRESPONSIVE_BACKOFF_MIN 60
+#define UNRESPONSIVE_BACKOFF_MAX 3600
+
 
 
 /*
@@ -32,6 +46,9 @@ class StorageUnit : public QObject
 {
   Q_OBJECT
 
+  friend class UDisks2Wrapper;
+  friend class HealthRuleEngine;
+
 public:
   StorageUnit();
   StorageUnit(QDBusObjectPath objectPath, QString device);
@@ -46,17 +63,33 @@ public:
 
   bool isFailing() const;
   bool isFailingStatusKnown() const;
+  bool isWarning() const;
+  bool isUnresponsive() const;
+
+  qint64 getLastChangeTime() const;
+
+  bool hasJob() const;
+  QString getJobOperation() const;
+  double getJobProgress() const;
+  quint64 getJobRate() const;
+  QDateTime getJobExpectedEndTime() const;
 
 
   //QMETA_TYPE require a public empty constructor, we can't
   //use pure virtual here
-  virtual void update()
+  Q_INVOKABLE virtual void update()
   {
     emit updated(this);
   }
 
   virtual bool isDrive() const { return false; }
   virtual bool isMDRaid() const { return false; }
+  virtual bool isRemovable() const { return false; }
+
+  //test if a long operation (test, scrubbing...) is running on the unit
+  virtual bool isOperationRunning() const { return false; }
+
+  void applyProperties(const QString& interface, const QVariantMap& properties);
 
 protected:
   QDBusObjectPath objectPath;
@@ -67,15 +100,57 @@ protected:
   bool failing = false;
   bool failingStatusKnown = false;
 
-  static QVariant getProperty(QDBusInterface*, const char*);
-  static bool getBoolProperty(QDBusInterface*, const char*);
-  static int getIntProperty(QDBusInterface*, const char*);
-  static qulonglong getULongLongProperty(QDBusInterface*, const char*);
-  static double getDoubleProperty(QDBusInterface*, const char*);
-  static QString getStringProperty(QDBusInterface*, const char*);
+  //outcome of the user defined health rules
+  bool ruleFailing = false;
+  bool warning = false;
+
+  //time of the last change of the cached properties, in milliseconds since epoch
+  qint64 lastChangeTime = 0;
+
+  //UDisks2 job running on the unit, if any
+  QDBusObjectPath jobPath;
+  QString jobOperation;
+  double jobProgress = 0;
+  bool jobProgressValid = false;
+  quint64 jobRate = 0;
+  quint64 jobExpectedEndTime = 0;
+
+  //circuit breaker state
+  int consecutiveTimeouts = 0;
+  qint64 suspendedUntil = 0;
+
+  void readInterfaces(const InterfaceList& interfaces);
+  bool updateProperties(const QString& interface, const QVariantMap& properties);
+
+  //read the given properties into the cached fields, return true if something changed
+  virtual bool readProperties(const QString& /*interface*/, const QVariantMap& /*properties*/) { return false; }
+
+  //retrieve data made outdated by the last properties read
+  virtual void fetchOutdatedData() { }
+
+  virtual void finishUpdate(const QStringList& failedInterfaces);
+
+  void applyJobProperties(const QDBusObjectPath& jobPath, const QVariantMap& properties);
+  void finishJob(const QDBusObjectPath& jobPath);
+
+  void recordTimeout(bool timedOut);
+  bool isPollingSuspended() const;
+
+  /*
+   * Assign value to field, returning true if the value has changed
+   */
+  template<typename T> static bool updateField(T& field, const T& value)
+  {
+    if(field == value)
+      return false;
+
+    field = value;
+    return true;
+  }
 
 signals:
   void updated(StorageUnit* unit);
+  void jobChanged(StorageUnit* unit);
 };
 
 Q_DECLARE_METATYPE(StorageUnit)
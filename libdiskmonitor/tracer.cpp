@@ -0,0 +1,506 @@
+/****************************************************************************
+ * DisKMonitor, KDE tools to monitor SMART and MDRaid health status         *
+ * Copyright (C) 2014-2015 Michaël Lhomme <papylhomme@gmail.com>            *
+ *                                                                          *
+ * This program is free software; you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation; either version 2 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License along  *
+ * with this program; if not, write to the Free Software Foundation, Inc.,  *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.              *
+ ****************************************************************************/
+
+
+
+#include "tracer.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QThread>
+#include <QtMath>
+
+#include "diskmonitor_debug.h"
+
+
+/*
+ * Singleton instance
+ */
+Q_GLOBAL_STATIC(Tracer, myTracerInstance)
+
+
+
+/*
+ * Constructor
+ */
+LatencyHistogram::LatencyHistogram() :
+  counts((LATENCY_HISTOGRAM_MAX_SHIFT + 2) * LATENCY_HISTOGRAM_SUB_BUCKETS, 0),
+  total(0),
+  min(0),
+  max(0),
+  sum(0)
+{
+}
+
+
+
+/*
+ * Get the bucket counting the given value
+ *
+ * Values below 2 * SUB_BUCKETS have their own bucket. Above, the value is shifted
+ * right until it fits in [SUB_BUCKETS, 2 * SUB_BUCKETS[, each shift adding
+ * SUB_BUCKETS buckets of twice the width of the previous ones
+ */
+int LatencyHistogram::bucketIndex(qint64 value)
+{
+  if(value < 0)
+    value = 0;
+
+  quint64 v = value;
+  int shift = 0;
+  while((v >> shift) >= 2 * LATENCY_HISTOGRAM_SUB_BUCKETS && shift < LATENCY_HISTOGRAM_MAX_SHIFT)
+    shift++;
+
+  quint64 subBucket = qMin(v >> shift, (quint64) 2 * LATENCY_HISTOGRAM_SUB_BUCKETS - 1);
+  return shift * LATENCY_HISTOGRAM_SUB_BUCKETS + subBucket;
+}
+
+
+
+/*
+ * Get the highest value counted by a bucket
+ */
+qint64 LatencyHistogram::bucketHighestValue(int index)
+{
+  if(index < 2 * LATENCY_HISTOGRAM_SUB_BUCKETS)
+    return index;
+
+  int shift = index / LATENCY_HISTOGRAM_SUB_BUCKETS - 1;
+  qint64 subBucket = index - shift * LATENCY_HISTOGRAM_SUB_BUCKETS;
+
+  return ((subBucket + 1) << shift) - 1;
+}
+
+
+
+/*
+ * Record a value
+ *
+ * @param value The latency in microseconds
+ */
+void LatencyHistogram::record(qint64 value)
+{
+  counts[bucketIndex(value)]++;
+
+  if(total == 0 || value < min)
+    min = value;
+
+  if(total == 0 || value > max)
+    max = value;
+
+  total++;
+  sum += value;
+}
+
+
+
+/*
+ * Add the values recorded by another histogram
+ */
+void LatencyHistogram::add(const LatencyHistogram& other)
+{
+  if(other.total == 0)
+    return;
+
+  for(int i = 0; i < counts.size(); i++)
+    counts[i] += other.counts[i];
+
+  min = total == 0 ? other.min : qMin(min, other.min);
+  max = total == 0 ? other.max : qMax(max, other.max);
+  total += other.total;
+  sum += other.sum;
+}
+
+
+
+/*
+ * Forget the recorded values
+ */
+void LatencyHistogram::reset()
+{
+  counts.fill(0);
+  total = 0;
+  min = 0;
+  max = 0;
+  sum = 0;
+}
+
+
+
+/*
+ * Get the number of recorded values
+ */
+quint64 LatencyHistogram::getCount() const
+{
+  return total;
+}
+
+
+
+/*
+ * Get the lowest recorded value
+ */
+qint64 LatencyHistogram::getMin() const
+{
+  return min;
+}
+
+
+
+/*
+ * Get the highest recorded value
+ */
+qint64 LatencyHistogram::getMax() const
+{
+  return max;
+}
+
+
+
+/*
+ * Get the mean of the recorded values
+ */
+double LatencyHistogram::getMean() const
+{
+  return total == 0 ? 0 : sum / total;
+}
+
+
+
+/*
+ * Get the value below which the given percentage of the values falls, within
+ * the precision of the buckets
+ *
+ * @param percentile The percentage, between 0 and 100
+ */
+qint64 LatencyHistogram::getValueAtPercentile(double percentile) const
+{
+  if(total == 0)
+    return 0;
+
+  quint64 target = qMax((quint64) 1, (quint64) qCeil(qBound(0.0, percentile, 100.0) / 100 * total));
+  quint64 seen = 0;
+
+  for(int i = 0; i < counts.size(); i++) {
+    seen += counts[i];
+    if(seen >= target)
+      return qMin(bucketHighestValue(i), max);
+  }
+
+  return max;
+}
+
+
+
+/*
+ * Constructor. Start the recording if TRACER_FILE_ENV is set, the
+ * trace being written to this file on destruction
+ */
+Tracer::Tracer() :
+  recording(false)
+{
+  clock.start();
+
+  sessionFile = QString::fromLocal8Bit(qgetenv(TRACER_FILE_ENV));
+  recording = !sessionFile.isEmpty();
+}
+
+
+
+/*
+ * Destructor. Write the trace of the session if requested
+ */
+Tracer::~Tracer()
+{
+  if(!sessionFile.isEmpty())
+    writeChromeTrace(sessionFile);
+}
+
+
+
+/*
+ * Singleton pattern
+ */
+Tracer* Tracer::instance()
+{
+  return myTracerInstance;
+}
+
+
+
+/*
+ * Get the timestamp of the trace events, in microseconds since the creation of the tracer
+ */
+qint64 Tracer::now()
+{
+  return instance() -> clock.nsecsElapsed() / 1000;
+}
+
+
+
+/*
+ * Test if the trace events are recorded
+ */
+bool Tracer::isRecording() const
+{
+  QMutexLocker locker(&mutex);
+  return recording;
+}
+
+
+
+/*
+ * Start or stop the recording of the trace events
+ */
+void Tracer::setRecording(bool recording)
+{
+  QMutexLocker locker(&mutex);
+  this -> recording = recording;
+}
+
+
+
+/*
+ * Append an event to the trace, the mutex being locked
+ *
+ * @param phase The type of event ("X" complete, "b"/"e" async begin/end)
+ * @param category The category of the event, used to filter the trace
+ * @param name The name of the event
+ * @param timestamp The start of the event in microseconds
+ * @param extra Additional fields of the event (dur, id, args)
+ */
+void Tracer::addEvent(const char* phase, const char* category, const QString& name, qint64 timestamp,
+                      const QVariantMap& extra)
+{
+  if(!recording || events.size() >= TRACER_MAX_EVENTS)
+    return;
+
+  QJsonObject event = QJsonObject::fromVariantMap(extra);
+  event["name"] = name;
+  event["cat"] = QString::fromLatin1(category);
+  event["ph"] = QString::fromLatin1(phase);
+  event["ts"] = timestamp;
+  event["pid"] = QCoreApplication::applicationPid();
+  event["tid"] = (qint64) (quintptr) QThread::currentThreadId();
+
+  events.append(event);
+}
+
+
+
+/*
+ * Record a complete event, ending now
+ *
+ * @param category The category of the event
+ * @param name The name of the event
+ * @param start The start of the event, from Tracer::now()
+ * @param args The arguments displayed with the event
+ */
+void Tracer::complete(const char* category, const QString& name, qint64 start, const QVariantMap& args)
+{
+  QVariantMap extra;
+  extra["dur"] = now() - start;
+  if(!args.isEmpty())
+    extra["args"] = args;
+
+  QMutexLocker locker(&mutex);
+  addEvent("X", category, name, start, extra);
+}
+
+
+
+/*
+ * Record the beginning of an asynchronous operation, like a refresh cycle spanning several threads
+ *
+ * @param category The category of the event
+ * @param name The name of the operation
+ * @param id The identifier of the operation, matching the end event
+ */
+void Tracer::asyncBegin(const char* category, const QString& name, quint64 id)
+{
+  QVariantMap extra;
+  extra["id"] = id;
+
+  QMutexLocker locker(&mutex);
+  addEvent("b", category, name, now(), extra);
+}
+
+
+
+/*
+ * Record the end of an asynchronous operation
+ *
+ * @param category The category of the event
+ * @param name The name of the operation
+ * @param id The identifier given to Tracer::asyncBegin()
+ */
+void Tracer::asyncEnd(const char* category, const QString& name, quint64 id)
+{
+  QVariantMap extra;
+  extra["id"] = id;
+
+  QMutexLocker locker(&mutex);
+  addEvent("e", category, name, now(), extra);
+}
+
+
+
+/*
+ * Mark the start of a DBus call on its watcher
+ *
+ * @param watcher The watcher of the pending call
+ * @param method The called method, as "interface.member"
+ * @param caller The caller in libdiskmonitor
+ */
+void Tracer::callStarted(QObject* watcher, const QString& method, const QString& caller)
+{
+  watcher -> setProperty("traceMethod", method);
+  watcher -> setProperty("traceCaller", caller);
+  watcher -> setProperty("traceStart", now());
+}
+
+
+
+/*
+ * Record the latency of a DBus call, and its event if recording
+ *
+ * @param watcher The watcher of the completed call, marked by Tracer::callStarted()
+ */
+void Tracer::callFinished(const QObject* watcher)
+{
+  QString method = watcher -> property("traceMethod").toString();
+  if(method.isEmpty())
+    return;
+
+  qint64 start = watcher -> property("traceStart").toLongLong();
+  qint64 duration = now() - start;
+
+  QVariantMap args;
+  args["caller"] = watcher -> property("traceCaller");
+  args["objectPath"] = watcher -> property("objectPath");
+
+  QVariantMap extra;
+  extra["dur"] = duration;
+  extra["args"] = args;
+
+  QMutexLocker locker(&mutex);
+  latencies[method].record(duration);
+  addEvent("X", "dbus", method.section('.', -1), start, extra);
+}
+
+
+
+/*
+ * Get the latency histograms of the DBus calls, per "interface.member" method
+ */
+QMap<QString, LatencyHistogram> Tracer::getLatencyHistograms() const
+{
+  QMutexLocker locker(&mutex);
+  return latencies;
+}
+
+
+
+/*
+ * Format a summary of the latency histograms, one line per method
+ */
+QString Tracer::latencyReport() const
+{
+  QMap<QString, LatencyHistogram> histograms = getLatencyHistograms();
+
+  QString report = QString("%1 %2 %3 %4 %5 %6\n")
+                   .arg("Method", -60).arg("Count", 8).arg("p50 (ms)", 10)
+                   .arg("p90 (ms)", 10).arg("p99 (ms)", 10).arg("Max (ms)", 10);
+
+  foreach(const QString& method, histograms.keys()) {
+    const LatencyHistogram& h = histograms[method];
+    report += QString("%1 %2 %3 %4 %5 %6\n")
+              .arg(method, -60).arg(h.getCount(), 8)
+              .arg(h.getValueAtPercentile(50) / 1000.0, 10, 'f', 2)
+              .arg(h.getValueAtPercentile(90) / 1000.0, 10, 'f', 2)
+              .arg(h.getValueAtPercentile(99) / 1000.0, 10, 'f', 2)
+              .arg(h.getMax() / 1000.0, 10, 'f', 2);
+  }
+
+  return report;
+}
+
+
+
+/*
+ * Write the recorded events to a file in the Chrome trace event format
+ *
+ * @param fileName The JSON file to write
+ */
+bool Tracer::writeChromeTrace(const QString& fileName) const
+{
+  QJsonObject trace;
+
+  {
+    QMutexLocker locker(&mutex);
+    trace["traceEvents"] = events;
+  }
+
+  trace["displayTimeUnit"] = QString("ms");
+
+  QFile file(fileName);
+  if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    qCWarning(DISKMONITOR_UDISKS2) << "Unable to write trace to '" << fileName << "': " << file.errorString();
+    return false;
+  }
+
+  file.write(QJsonDocument(trace).toJson(QJsonDocument::Compact));
+  return true;
+}
+
+
+
+/*
+ * Forget the recorded events and latencies
+ */
+void Tracer::reset()
+{
+  QMutexLocker locker(&mutex);
+  events = QJsonArray();
+  latencies.clear();
+}
+
+
+
+/*
+ * Start a complete event
+ */
+TraceScope::TraceScope(const char* category, const QString& name) :
+  category(category),
+  name(name),
+  start(Tracer::now())
+{
+}
+
+
+
+/*
+ * End the complete event
+ */
+TraceScope::~TraceScope()
+{
+  Tracer::instance() -> complete(category, name, start);
+}
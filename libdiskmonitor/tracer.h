@@ -0,0 +1,176 @@
+/****************************************************************************
+ * DisKMonitor, KDE tools to monitor SMART and MDRaid health status         *
+ * Copyright (C) 2014-2015 Michaël Lhomme <papylhomme@gmail.com>            *
+ *                                                                          *
+ * This program is free software; you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation; either version 2 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License along  *
+ * with this program; if not, write to the Free Software Foundation, Inc.,  *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.              *
+ ****************************************************************************/
+
+
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QMap>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QVariantMap>
+#include <QVector>
+
+
+
+//file receiving the trace of the whole session when set, the recording starting at once
+#define TRACER_FILE_ENV "DISKMONITOR_TRACE_FILE"
+
+//maximum number of trace events kept in memory, the following ones being dropped
+#define TRACER_MAX_EVENTS 200000
+
+//sub buckets per power of two of the latency histograms, giving a ~3% precision
+#define LATENCY_HISTOGRAM_SUB_BUCKETS 32
+
+//largest recorded latency is (2 * SUB_BUCKETS) << MAX_SHIFT microseconds (about 19 hours)
+#define LATENCY_HISTOGRAM_MAX_SHIFT 30
+
+
+
+/*
+ * HDR style histogram of latencies in microseconds
+ *
+ * Values are counted in LATENCY_HISTOGRAM_SUB_BUCKETS linear buckets per power of two,
+ * the relative error staying constant whatever the magnitude of the value. Recording
+ * is a constant time operation without allocation
+ */
+class LatencyHistogram
+{
+public:
+  LatencyHistogram();
+
+  void record(qint64 value);
+  void add(const LatencyHistogram& other);
+  void reset();
+
+  quint64 getCount() const;
+  qint64 getMin() const;
+  qint64 getMax() const;
+  double getMean() const;
+  qint64 getValueAtPercentile(double percentile) const;
+
+private:
+  QVector<quint64> counts;
+  quint64 total;
+  qint64 min;
+  qint64 max;
+  double sum;
+
+  static int bucketIndex(qint64 value);
+  static qint64 bucketHighestValue(int index);
+};
+
+
+
+/*
+ * Record the trace events of the refresh cycles and the latency of the DBus calls
+ *
+ * Events are exported in the Chrome trace event format, to be loaded in
+ * chrome://tracing or https://ui.perfetto.dev. They are only recorded when
+ * requested, while the latency histograms are filled on every DBus call
+ *
+ * Use the TRACE_* macros, compiled to nothing unless DISKMONITOR_TRACING is defined:
+ * without it neither the events nor the latency histograms are recorded
+ */
+class Tracer
+{
+public:
+  Tracer();
+  ~Tracer();
+
+  static Tracer* instance();
+  static qint64 now();
+
+  bool isRecording() const;
+  void setRecording(bool recording);
+
+  void complete(const char* category, const QString& name, qint64 start, const QVariantMap& args = QVariantMap());
+  void asyncBegin(const char* category, const QString& name, quint64 id);
+  void asyncEnd(const char* category, const QString& name, quint64 id);
+
+  void callStarted(QObject* watcher, const QString& method, const QString& caller);
+  void callFinished(const QObject* watcher);
+
+  QMap<QString, LatencyHistogram> getLatencyHistograms() const;
+  QString latencyReport() const;
+
+  bool writeChromeTrace(const QString& fileName) const;
+  void reset();
+
+private:
+  mutable QMutex mutex;
+  QElapsedTimer clock;
+  QJsonArray events;
+  QMap<QString, LatencyHistogram> latencies;
+  bool recording;
+  QString sessionFile;
+
+  void addEvent(const char* phase, const char* category, const QString& name, qint64 timestamp,
+                const QVariantMap& extra);
+};
+
+
+
+/*
+ * Record a complete event for the enclosing scope
+ */
+class TraceScope
+{
+public:
+  TraceScope(const char* category, const QString& name);
+  ~TraceScope();
+
+private:
+  const char* category;
+  QString name;
+  qint64 start;
+};
+
+
+
+#ifdef DISKMONITOR_TRACING
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#define TRACE_SCOPE(category, name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(category, name)
+#define TRACE_COMPLETE(category, name, start, args) Tracer::instance() -> complete(category, name, start, args)
+#define TRACE_ASYNC_BEGIN(category, name, id) Tracer::instance() -> asyncBegin(category, name, id)
+#define TRACE_ASYNC_END(category, name, id) Tracer::instance() -> asyncEnd(category, name, id)
+#define TRACE_CALL_STARTED(watcher, method, caller) Tracer::instance() -> callStarted(watcher, method, caller)
+#define TRACE_CALL_FINISHED(watcher) Tracer::instance() -> callFinished(watcher)
+#define TRACE_NOW() Tracer::now()
+
+#else
+
+#define TRACE_SCOPE(category, name)
+#define TRACE_COMPLETE(category, name, start, args)
+#define TRACE_ASYNC_BEGIN(category, name, id)
+#define TRACE_ASYNC_END(category, name, id)
+#define TRACE_CALL_STARTED(watcher, method, caller)
+#define TRACE_CALL_FINISHED(watcher)
+#define TRACE_NOW() 0
+
+#endif
+
+#endif // TRACER_H
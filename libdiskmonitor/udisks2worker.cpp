@@ -0,0 +1,898 @@
+/****************************************************************************
+ * DisKMonitor, KDE tools to monitor SMART and MDRaid health status         *
+ * Copyright (C) 2014-2015 Michaël Lhomme <papylhomme@gmail.com>            *
+ *                                                                          *
+ * This program is free software; you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation; either version 2 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License along  *
+ * with this program; if not, write to the Free Software Foundation, Inc.,  *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.              *
+ ****************************************************************************/
+
+
+#include "udisks2worker.h"
+
+#include "udisks2wrapper.h"
+
+#include "properties_proxy.h"
+#include "objectmanager_proxy.h"
+#include "driveata_proxy.h"
+#include "mdraid_proxy.h"
+#include "tracer.h"
+#include "diskmonitor_debug.h"
+
+#include <QDebug>
+
+
+#define UDISKS2_WORKER_CONNECTION "diskmonitor-udisks2-worker"
+
+//address of the bus carrying UDisks2 when set, instead of the system bus (ie. a private bus running a mock service)
+#define UDISKS2_BUS_ENV "DISKMONITOR_UDISKS2_BUS"
+
+
+
+/*
+ * Open the worker's connection to the bus carrying UDisks2, the system bus
+ * unless UDISKS2_BUS_ENV is set
+ */
+static QDBusConnection connectToUDisks2Bus()
+{
+  QString address = QString::fromLocal8Bit(qgetenv(UDISKS2_BUS_ENV));
+  if(address.isEmpty())
+    return QDBusConnection::connectToBus(QDBusConnection::SystemBus, UDISKS2_WORKER_CONNECTION);
+
+  qCDebug(DISKMONITOR_UDISKS2) << "UDisks2Worker => Using bus '" << address << "'";
+  return QDBusConnection::connectToBus(address, UDISKS2_WORKER_CONNECTION);
+}
+
+
+
+/*
+ * UDisks2Worker constructor. Open the worker's connection to the system bus
+ * and subscribe to the UDisks2 signals
+ *
+ * The signals are delivered in the thread the worker has been moved to
+ */
+UDisks2Worker::UDisks2Worker() : QObject(),
+  connection(connectToUDisks2Bus()),
+  attributesCacheHits(0),
+  attributesCacheMisses(0),
+  callTimeout(UDISKS2_DEFAULT_CALL_TIMEOUT)
+{
+  objectManager = new ObjectManagerProxy(UDISKS2_SERVICE, UDISKS2_PATH, connection, this);
+
+
+  //connection to UDisks2 signals
+  bool connected;
+
+  connected = connection.connect(UDISKS2_SERVICE, UDISKS2_PATH, UDISKS2_OBJECT_IFACE, "InterfacesAdded",
+              this, SLOT(dbusInterfacesAdded(QDBusObjectPath, InterfaceList)));
+  if(!connected)
+    qWarning() << "Unable to connect to InterfacesAdded signal, won't handle device insertion !";
+
+  connected = connection.connect(UDISKS2_SERVICE, UDISKS2_PATH, UDISKS2_OBJECT_IFACE, "InterfacesRemoved",
+              this, SLOT(dbusInterfacesRemoved(QDBusObjectPath, QStringList)));
+  if(!connected)
+    qWarning() << "Unable to connect to InterfacesRemoved signal, won't handle device removal !";
+
+  //empty path to receive the changes of every node
+  connected = connection.connect(UDISKS2_SERVICE, QString(), DBUS_PROPERTIES_IFACE, "PropertiesChanged",
+              this, SLOT(dbusPropertiesChanged(QString, QVariantMap, QStringList, QDBusMessage)));
+  if(!connected)
+    qWarning() << "Unable to connect to PropertiesChanged signal, changes will only be seen on refresh !";
+}
+
+
+
+/*
+ * Destructor. The proxies are children of the worker
+ */
+UDisks2Worker::~UDisks2Worker()
+{
+  QDBusConnection::disconnectFromBus(UDISKS2_WORKER_CONNECTION);
+}
+
+
+
+/*
+ * Set the deadline of the calls made through the proxies
+ *
+ * @param msecs The timeout in milliseconds
+ */
+void UDisks2Worker::setCallTimeout(int msecs)
+{
+  callTimeout = msecs;
+  objectManager -> setTimeout(msecs);
+
+  foreach(PropertiesProxy* p, propertiesProxies)
+    p -> setTimeout(msecs);
+
+  foreach(DriveAtaProxy* p, ataProxies)
+    p -> setTimeout(msecs);
+
+  foreach(MDRaidProxy* p, mdraidProxies)
+    p -> setTimeout(msecs);
+}
+
+
+
+/*
+ * Test if the error is caused by a call not answered before its deadline
+ */
+bool UDisks2Worker::isTimeout(const QDBusError& error)
+{
+  return error.type() == QDBusError::NoReply || error.type() == QDBusError::Timeout;
+}
+
+
+
+/*
+ * Get the number of DBus calls sent by the worker since its
+ * creation or the last call to resetCallCounts()
+ */
+quint64 UDisks2Worker::getRoundTripCount() const
+{
+  QMutexLocker locker(&callCountsMutex);
+
+  quint64 total = 0;
+  foreach(quint64 count, callCounts)
+    total += count;
+
+  return total;
+}
+
+
+
+/*
+ * Get the number of DBus calls sent for a method, empty filters matching everything
+ *
+ * @param interface The DBus interface of the method
+ * @param member The method
+ * @param caller The caller in libdiskmonitor (Drive::update, UDisks2Wrapper::enableSMART...)
+ */
+quint64 UDisks2Worker::getCallCount(const QString& interface, const QString& member, const QString& caller) const
+{
+  QMutexLocker locker(&callCountsMutex);
+
+  quint64 total = 0;
+  foreach(const DBusCallCount& c, callCounts.keys()) {
+    if((interface.isEmpty() || c.interface == interface) &&
+       (member.isEmpty() || c.member == member) &&
+       (caller.isEmpty() || c.caller == caller))
+      total += callCounts[c];
+  }
+
+  return total;
+}
+
+
+
+/*
+ * Get the number of DBus calls sent for every method and caller
+ */
+QList<DBusCallCount> UDisks2Worker::getCallCounts() const
+{
+  QMutexLocker locker(&callCountsMutex);
+
+  QList<DBusCallCount> result;
+  foreach(DBusCallCount c, callCounts.keys()) {
+    c.count = callCounts[c];
+    result << c;
+  }
+
+  return result;
+}
+
+
+
+/*
+ * Reset the DBus call counters
+ */
+void UDisks2Worker::resetCallCounts()
+{
+  QMutexLocker locker(&callCountsMutex);
+  callCounts.clear();
+}
+
+
+
+/*
+ * Account for a DBus call sent by the worker
+ *
+ * @param interface The DBus interface of the method
+ * @param member The method
+ * @param caller The caller in libdiskmonitor
+ */
+void UDisks2Worker::countCall(const QString& interface, const QString& member, const QString& caller)
+{
+  DBusCallCount key;
+  key.interface = interface;
+  key.member = member;
+  key.caller = caller;
+  key.count = 0;
+
+  QMutexLocker locker(&callCountsMutex);
+  callCounts[key]++;
+}
+
+
+
+/*
+ * Get the number of drive updates which reused the cached SMART attributes,
+ * UDisks2 not having collected new SMART data
+ */
+quint64 UDisks2Worker::getAttributesCacheHitCount() const
+{
+  return attributesCacheHits.loadAcquire();
+}
+
+
+
+/*
+ * Get the number of SmartGetAttributes calls issued to replace outdated attributes
+ */
+quint64 UDisks2Worker::getAttributesCacheMissCount() const
+{
+  return attributesCacheMisses.loadAcquire();
+}
+
+
+
+/*
+ * Reset the SMART attributes cache statistics
+ */
+void UDisks2Worker::resetAttributesCacheStats()
+{
+  attributesCacheHits.storeRelease(0);
+  attributesCacheMisses.storeRelease(0);
+}
+
+
+
+/*
+ * Get a proxy from the given cache, creating it if needed
+ *
+ * @param cache The cache of proxies for the requested interface
+ * @param objectPath The DBus path identifying the node
+ */
+template<typename T> T* UDisks2Worker::proxy(QMap<QDBusObjectPath, T*>& cache, const QDBusObjectPath& objectPath)
+{
+  T* p = cache.value(objectPath, nullptr);
+
+  if(p == nullptr) {
+    p = new T(UDISKS2_SERVICE, objectPath.path(), connection, this);
+    p -> setTimeout(callTimeout);
+    cache[objectPath] = p;
+  }
+
+  return p;
+}
+
+
+
+/*
+ * Delete the cached proxies of the given node, and drop its queued and follow-up updates
+ *
+ * @param objectPath The DBus path identifying the node
+ */
+void UDisks2Worker::releaseProxies(const QDBusObjectPath& objectPath)
+{
+  delete propertiesProxies.take(objectPath);
+  delete ataProxies.take(objectPath);
+  delete mdraidProxies.take(objectPath);
+
+  for(int i = queuedUpdates.size() - 1; i >= 0; i--) {
+    if(queuedUpdates[i].objectPath == objectPath)
+      queuedUpdates.removeAt(i);
+  }
+
+  followUpUpdates.remove(objectPath);
+}
+
+
+
+/*
+ * Decode the properties of complex types in the worker's thread
+ *
+ * They are received as QDBusArgument, bound to the DBus message, and
+ * are converted to their own type before being published
+ *
+ * @param properties The properties to decode
+ */
+void UDisks2Worker::decodeProperties(QVariantMap& properties)
+{
+  if(properties.contains("ActiveDevices"))
+    properties["ActiveDevices"] = QVariant::fromValue(qdbus_cast<MDRaidMemberList>(properties["ActiveDevices"]));
+
+  if(properties.contains("Objects"))
+    properties["Objects"] = QVariant::fromValue(qdbus_cast< QList<QDBusObjectPath> >(properties["Objects"]));
+}
+
+
+
+/*
+ * Start a call and watch its reply, the watcher carrying the node
+ * and a description of the call. The call is accounted for its caller
+ *
+ * @param call The pending call
+ * @param objectPath The DBus path identifying the node
+ * @param what The interface read by the call, or a description of the action
+ * @param interface The DBus interface of the method
+ * @param member The method
+ * @param caller The caller in libdiskmonitor
+ */
+QDBusPendingCallWatcher* UDisks2Worker::watch(const QDBusPendingCall& call, const QDBusObjectPath& objectPath, const QString& what,
+                                              const QString& interface, const QString& member, const QString& caller)
+{
+  countCall(interface, member, caller);
+
+  QDBusPendingCallWatcher* watcher = new QDBusPendingCallWatcher(call, this);
+  watcher -> setProperty("objectPath", objectPath.path());
+  watcher -> setProperty("what", what);
+
+  TRACE_CALL_STARTED(watcher, interface + "." + member, caller);
+
+  return watcher;
+}
+
+
+
+/*
+ * List the UDisks2 nodes with their interfaces and properties, published by objectsListed()
+ */
+void UDisks2Worker::listObjects()
+{
+  QDBusPendingCallWatcher* watcher = watch(objectManager -> GetManagedObjects(), QDBusObjectPath(UDISKS2_PATH), UDISKS2_OBJECT_IFACE,
+                                           UDISKS2_OBJECT_IFACE, "GetManagedObjects", "UDisks2Wrapper::initialize");
+  connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)), this, SLOT(objectsReceived(QDBusPendingCallWatcher*)));
+}
+
+
+
+/*
+ * Handle the reply to the GetManagedObjects call issued by UDisks2Worker::listObjects()
+ *
+ * @param watcher The watcher of the pending call
+ */
+void UDisks2Worker::objectsReceived(QDBusPendingCallWatcher* watcher)
+{
+  TRACE_CALL_FINISHED(watcher);
+
+  QDBusPendingReply<ManagedObjectList> res = *watcher;
+  watcher -> deleteLater();
+
+  if(res.isError()) {
+    qCritical() << "Error while retrieving UDisks2 objects ! " << res.error();
+    emit objectsListFailed();
+    return;
+  }
+
+  TRACE_SCOPE("enumeration", "decode managed objects");
+
+  ManagedObjectList objects = res.value();
+  foreach(QDBusObjectPath objectPath, objects.keys()) {
+    foreach(QString interface, objects[objectPath].keys())
+      decodeProperties(objects[objectPath][interface]);
+  }
+
+  emit objectsListed(objects);
+}
+
+
+
+/*
+ * Request an update of a drive: its properties, and its SMART attributes if they are
+ * outdated or if UDisks2 collected new SMART data since the cached ones. Completion
+ * is notified by updateFinished()
+ *
+ * Drives supporting power management are first checked for standby, a sleeping drive
+ * being left alone (see UDisks2Worker::powerStateReceived())
+ *
+ * @param objectPath The DBus path identifying the drive
+ * @param hasATAIface true if the drive provides the ATA_IFACE
+ * @param pmSupported true if the drive supports power management
+ * @param attributesOutdated true if the cached attributes must be retrieved again
+ * @param smartUpdated The SmartUpdated value of the cached attributes
+ */
+void UDisks2Worker::updateDrive(const QDBusObjectPath& objectPath, bool hasATAIface, bool pmSupported,
+                                bool attributesOutdated, qulonglong smartUpdated)
+{
+  UnitUpdate update;
+  update.objectPath = objectPath;
+  update.interface = UDISKS2_DRIVE_IFACE;
+  update.caller = "Drive::update";
+  update.hasATAIface = hasATAIface;
+  update.pmSupported = pmSupported;
+  update.attributesOutdated = attributesOutdated;
+  update.smartUpdated = smartUpdated;
+
+  enqueueUpdate(update);
+}
+
+
+
+/*
+ * Request an update of the properties of a raid array, including its
+ * members. Completion is notified by updateFinished()
+ *
+ * @param objectPath The DBus path identifying the raid array
+ */
+void UDisks2Worker::updateMDRaid(const QDBusObjectPath& objectPath)
+{
+  UnitUpdate update;
+  update.objectPath = objectPath;
+  update.interface = UDISKS2_MDRAID_IFACE;
+  update.caller = "MDRaid::update";
+
+  enqueueUpdate(update);
+}
+
+
+
+/*
+ * Request only the SMART attributes of a drive. Completion is notified by updateFinished()
+ *
+ * @param objectPath The DBus path identifying the drive
+ */
+void UDisks2Worker::updateSMARTAttributes(const QDBusObjectPath& objectPath)
+{
+  UnitUpdate update;
+  update.objectPath = objectPath;
+  update.interface = UDISKS2_ATA_IFACE;
+  update.caller = "Drive::fetchOutdatedData";
+
+  enqueueUpdate(update);
+}
+
+
+
+/*
+ * Queue an update request and start it if a slot is available. A request for
+ * a unit already queued is merged into the queued one. A request for a unit
+ * being updated is kept as a follow-up, merged with the other requests received
+ * meanwhile and queued once the running update finishes
+ *
+ * @param update The update request
+ */
+void UDisks2Worker::enqueueUpdate(const UnitUpdate& update)
+{
+  if(runningUpdates.contains(update.objectPath)) {
+    if(followUpUpdates.contains(update.objectPath))
+      mergeUpdate(followUpUpdates[update.objectPath], update);
+    else
+      followUpUpdates[update.objectPath] = update;
+
+    return;
+  }
+
+  for(int i = 0; i < queuedUpdates.size(); i++) {
+    if(queuedUpdates[i].objectPath == update.objectPath) {
+      mergeUpdate(queuedUpdates[i], update);
+      return;
+    }
+  }
+
+  queuedUpdates.append(update);
+  startUpdates();
+}
+
+
+
+/*
+ * Merge an update request into a queued one for the same unit: the callers are
+ * joined, and the queued update retrieves the union of the requested data. A
+ * drive update retrieving the SMART attributes when they are outdated, a request
+ * of the attributes alone is merged by marking them outdated
+ *
+ * @param queued The queued update, modified
+ * @param update The new request
+ */
+void UDisks2Worker::mergeUpdate(UnitUpdate& queued, const UnitUpdate& update)
+{
+  QString caller = queued.caller;
+  if(!caller.split(", ").contains(update.caller))
+    caller += ", " + update.caller;
+
+  if(update.interface == UDISKS2_DRIVE_IFACE) {
+    bool attributesOutdated = queued.attributesOutdated || queued.interface == UDISKS2_ATA_IFACE;
+    queued = update;
+    queued.attributesOutdated |= attributesOutdated;
+  } else if(update.interface == UDISKS2_ATA_IFACE && queued.interface == UDISKS2_DRIVE_IFACE) {
+    queued.attributesOutdated = true;
+  }
+
+  queued.caller = caller;
+}
+
+
+
+/*
+ * Start the queued updates, keeping at most UDISKS2_MAX_UPDATES_IN_FLIGHT running
+ *
+ * The calls of an update are issued together, replies are handled as they come
+ */
+void UDisks2Worker::startUpdates()
+{
+  while(runningUpdates.size() < UDISKS2_MAX_UPDATES_IN_FLIGHT && !queuedUpdates.isEmpty()) {
+    UnitUpdate request = queuedUpdates.takeFirst();
+    UnitUpdate& update = runningUpdates[request.objectPath];
+    update = request;
+    update.startedAt = TRACE_NOW();
+
+    if(update.interface == UDISKS2_ATA_IFACE)
+      callSmartGetAttributes(update);
+    else if(update.interface == UDISKS2_MDRAID_IFACE)
+      callGetAll(update, UDISKS2_MDRAID_IFACE);
+    else if(update.hasATAIface && update.pmSupported)
+      callPmGetState(update);
+    else
+      callDriveGetAll(update);
+  }
+}
+
+
+
+/*
+ * Retrieve the power state of a drive, handled by UDisks2Worker::powerStateReceived()
+ *
+ * @param update The running update
+ */
+void UDisks2Worker::callPmGetState(UnitUpdate& update)
+{
+  update.pendingCalls++;
+
+  QDBusPendingCallWatcher* watcher = watch(proxy(ataProxies, update.objectPath) -> PmGetState(QVariantMap()), update.objectPath, UDISKS2_ATA_IFACE,
+                                           UDISKS2_ATA_IFACE, "PmGetState", update.caller);
+  connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)), this, SLOT(powerStateReceived(QDBusPendingCallWatcher*)));
+}
+
+
+
+/*
+ * Retrieve the properties of the DRIVE_IFACE and ATA_IFACE of a drive
+ *
+ * @param update The running update
+ */
+void UDisks2Worker::callDriveGetAll(UnitUpdate& update)
+{
+  callGetAll(update, UDISKS2_DRIVE_IFACE);
+
+  if(update.hasATAIface)
+    callGetAll(update, UDISKS2_ATA_IFACE);
+}
+
+
+
+/*
+ * Retrieve all the properties of an interface with a single GetAll call,
+ * handled by UDisks2Worker::propertiesReceived()
+ *
+ * @param update The running update
+ * @param interface The DBus interface containing the properties
+ */
+void UDisks2Worker::callGetAll(UnitUpdate& update, const QString& interface)
+{
+  update.pendingCalls++;
+
+  QDBusPendingCallWatcher* watcher = watch(proxy(propertiesProxies, update.objectPath) -> GetAll(interface), update.objectPath, interface,
+                                           DBUS_PROPERTIES_IFACE, "GetAll",
+                                           interface == UDISKS2_ATA_IFACE ? update.caller + " (ATA properties)" : update.caller);
+  connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)), this, SLOT(propertiesReceived(QDBusPendingCallWatcher*)));
+}
+
+
+
+/*
+ * Retrieve the SMART attributes of a drive, handled by UDisks2Worker::attributesReceived()
+ *
+ * @param update The running update
+ */
+void UDisks2Worker::callSmartGetAttributes(UnitUpdate& update)
+{
+  update.pendingCalls++;
+  attributesCacheMisses.fetchAndAddRelaxed(1);
+
+  //never spin up a sleeping drive to read its SMART data
+  QVariantMap options;
+  options["nowakeup"] = true;
+
+  QDBusPendingCallWatcher* watcher = watch(proxy(ataProxies, update.objectPath) -> SmartGetAttributes(options), update.objectPath, UDISKS2_ATA_IFACE,
+                                           UDISKS2_ATA_IFACE, "SmartGetAttributes", update.caller);
+  connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)), this, SLOT(attributesReceived(QDBusPendingCallWatcher*)));
+}
+
+
+
+/*
+ * Account for a completed call of an update, notifying updateFinished() (or
+ * queuing its follow-up) and starting the next queued updates once every call
+ * is completed
+ *
+ * @param update The running update
+ */
+void UDisks2Worker::callFinished(UnitUpdate& update)
+{
+  if(--update.pendingCalls > 0)
+    return;
+
+#ifdef DISKMONITOR_TRACING
+  QVariantMap args;
+  args["objectPath"] = update.objectPath.path();
+  args["caller"] = update.caller;
+  args["failedInterfaces"] = update.failedInterfaces;
+  TRACE_COMPLETE("update", "unit update", update.startedAt, args);
+#endif
+
+  //update is a reference into runningUpdates, the key must outlive the removed node
+  QDBusObjectPath objectPath = update.objectPath;
+
+  //with a follow-up, the completion is only notified once the requested data is retrieved
+  if(followUpUpdates.contains(objectPath))
+    queuedUpdates.append(followUpUpdates.take(objectPath));
+  else
+    emit updateFinished(objectPath, update.failedInterfaces, update.timedOut);
+
+  runningUpdates.remove(objectPath);
+  startUpdates();
+}
+
+
+
+/*
+ * Handle the reply of a PmGetState call, published by powerStateRetrieved()
+ *
+ * A drive in standby is only reported as such, its cached data being kept. The
+ * properties of an active drive are then retrieved. On error the power state
+ * is unknown and the drive is updated as usual
+ *
+ * @param watcher The watcher of the pending call
+ */
+void UDisks2Worker::powerStateReceived(QDBusPendingCallWatcher* watcher)
+{
+  TRACE_CALL_FINISHED(watcher);
+
+  QDBusPendingReply<uchar> res = *watcher;
+  QDBusObjectPath objectPath(watcher -> property("objectPath").toString());
+  watcher -> deleteLater();
+
+  UnitUpdate& update = runningUpdates[objectPath];
+
+  if(res.isError()) {
+    qWarning() << "Unable to read power state of drive '" << objectPath.path() << "': " << res.error();
+
+    if(isTimeout(res.error())) {
+      update.failedInterfaces << UDISKS2_ATA_IFACE;
+      update.timedOut = true;
+    } else {
+      emit powerStateRetrieved(objectPath, false);
+      callDriveGetAll(update);
+    }
+
+  } else {
+    bool standby = res.value() < ATA_PM_STATE_IDLE;
+    emit powerStateRetrieved(objectPath, standby);
+
+    if(!standby)
+      callDriveGetAll(update);
+  }
+
+  callFinished(update);
+}
+
+
+
+/*
+ * Handle the reply of a GetAll call, published by propertiesRetrieved()
+ *
+ * The SMART attributes are requested when the ATA_IFACE properties show new SMART
+ * data, the cached ones being reused otherwise
+ *
+ * @param watcher The watcher of the pending call
+ */
+void UDisks2Worker::propertiesReceived(QDBusPendingCallWatcher* watcher)
+{
+  TRACE_CALL_FINISHED(watcher);
+
+  QDBusPendingReply<QVariantMap> res = *watcher;
+  QDBusObjectPath objectPath(watcher -> property("objectPath").toString());
+  QString interface = watcher -> property("what").toString();
+  watcher -> deleteLater();
+
+  UnitUpdate& update = runningUpdates[objectPath];
+
+  if(res.isError()) {
+    qCritical() << "Unable to read properties from interface '" << interface <<
+                "' of '" << objectPath.path() << "': " << res.error();
+
+    update.failedInterfaces << interface;
+    update.timedOut |= isTimeout(res.error());
+
+  } else {
+    QVariantMap properties = res.value();
+    decodeProperties(properties);
+
+    emit propertiesRetrieved(objectPath, interface, properties);
+
+    //tiered refresh: the attribute table is only retrieved when UDisks2 collected
+    //new SMART data, the scalar properties being enough otherwise
+    if(interface == UDISKS2_ATA_IFACE && properties["SmartSupported"].toBool() && properties["SmartEnabled"].toBool()) {
+      if(update.attributesOutdated || properties["SmartUpdated"].toULongLong() != update.smartUpdated)
+        callSmartGetAttributes(update);
+      else
+        attributesCacheHits.fetchAndAddRelaxed(1);
+    }
+  }
+
+  callFinished(update);
+}
+
+
+
+/*
+ * Handle the reply of a SmartGetAttributes call, published by attributesRetrieved()
+ *
+ * @param watcher The watcher of the pending call
+ */
+void UDisks2Worker::attributesReceived(QDBusPendingCallWatcher* watcher)
+{
+  TRACE_CALL_FINISHED(watcher);
+
+  QDBusPendingReply<SmartAttributesList> res = *watcher;
+  QDBusObjectPath objectPath(watcher -> property("objectPath").toString());
+  watcher -> deleteLater();
+
+  UnitUpdate& update = runningUpdates[objectPath];
+
+  if(res.isError()) {
+    qCritical() << "Error calling SmartGetAttributes for drive '" << objectPath.path() << "':" << res.error();
+
+    update.failedInterfaces << UDISKS2_ATA_IFACE;
+    update.timedOut |= isTimeout(res.error());
+
+  } else {
+    emit attributesRetrieved(objectPath, res.value());
+  }
+
+  callFinished(update);
+}
+
+
+
+/*
+ * Log the failure of an action
+ *
+ * @param watcher The watcher of the pending call
+ */
+void UDisks2Worker::actionFinished(QDBusPendingCallWatcher* watcher)
+{
+  TRACE_CALL_FINISHED(watcher);
+
+  QDBusPendingReply<> res = *watcher;
+  watcher -> deleteLater();
+
+  if(res.isError())
+    qWarning() << "Error sending request to " << watcher -> property("what").toString() <<
+                  " on '" << watcher -> property("objectPath").toString() << "' : " << res.error();
+}
+
+
+
+/*
+ * Request a sync action on a raid array
+ *
+ * @param objectPath The DBus path identifying the raid array
+ * @param action The sync action ('check', 'idle', ...)
+ */
+void UDisks2Worker::requestMDRaidSyncAction(const QDBusObjectPath& objectPath, const QString& action)
+{
+  QDBusPendingCallWatcher* watcher = watch(proxy(mdraidProxies, objectPath) -> RequestSyncAction(action, QVariantMap()),
+                                           objectPath, "request sync action " + action,
+                                           UDISKS2_MDRAID_IFACE, "RequestSyncAction", "UDisks2Wrapper::requestMDRaidSyncAction");
+  connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)), this, SLOT(actionFinished(QDBusPendingCallWatcher*)));
+}
+
+
+
+/*
+ * Enable SMART on a drive
+ *
+ * @param objectPath The DBus path identifying the drive
+ */
+void UDisks2Worker::enableSMART(const QDBusObjectPath& objectPath)
+{
+  QDBusPendingCallWatcher* watcher = watch(proxy(ataProxies, objectPath) -> SmartSetEnabled(true, QVariantMap()),
+                                           objectPath, "enable SMART",
+                                           UDISKS2_ATA_IFACE, "SmartSetEnabled", "UDisks2Wrapper::enableSMART");
+  connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)), this, SLOT(actionFinished(QDBusPendingCallWatcher*)));
+}
+
+
+
+/*
+ * Start a SMART SelfTest on a drive
+ *
+ * @param objectPath The DBus path identifying the drive
+ * @param type The type of SelfTest to run ('short', 'extended' or 'conveyance')
+ */
+void UDisks2Worker::startSMARTSelfTest(const QDBusObjectPath& objectPath, const QString& type)
+{
+  QDBusPendingCallWatcher* watcher = watch(proxy(ataProxies, objectPath) -> SmartSelftestStart(type, QVariantMap()),
+                                           objectPath, "start SMART SelfTest",
+                                           UDISKS2_ATA_IFACE, "SmartSelftestStart", "UDisks2Wrapper::startSMARTSelfTest");
+  connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)), this, SLOT(actionFinished(QDBusPendingCallWatcher*)));
+}
+
+
+
+/*
+ * Cancel a running SMART SelfTest on a drive
+ *
+ * @param objectPath The DBus path identifying the drive
+ */
+void UDisks2Worker::cancelSMARTSelfTest(const QDBusObjectPath& objectPath)
+{
+  QDBusPendingCallWatcher* watcher = watch(proxy(ataProxies, objectPath) -> SmartSelftestAbort(QVariantMap()),
+                                           objectPath, "cancel SMART SelfTest",
+                                           UDISKS2_ATA_IFACE, "SmartSelftestAbort", "UDisks2Wrapper::cancelSMARTSelfTest");
+  connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)), this, SLOT(actionFinished(QDBusPendingCallWatcher*)));
+}
+
+
+
+/*
+ * Forward UDisks2 "InterfacesAdded" signal
+ *
+ * @param objectPath The node being updated
+ * @param interfaces A map of interfaces being added
+ */
+void UDisks2Worker::dbusInterfacesAdded(const QDBusObjectPath& objectPath, const InterfaceList& interfaces)
+{
+  InterfaceList decoded = interfaces;
+  foreach(QString interface, decoded.keys())
+    decodeProperties(decoded[interface]);
+
+  emit interfacesAdded(objectPath, decoded);
+}
+
+
+
+/*
+ * Forward UDisks2 "InterfacesRemoved" signal
+ *
+ * @param objectPath The node being updated
+ * @param interfaces The list of interfaces being removed
+ */
+void UDisks2Worker::dbusInterfacesRemoved(const QDBusObjectPath& objectPath, const QStringList& interfaces)
+{
+  emit interfacesRemoved(objectPath, interfaces);
+}
+
+
+
+/*
+ * Forward "PropertiesChanged" signal for the interfaces used by the storage units and jobs
+ *
+ * @param interface The interface owning the properties
+ * @param changedProperties The properties that changed with their new values
+ * @param message The signal message, used to retrieve the node's path
+ */
+void UDisks2Worker::dbusPropertiesChanged(const QString& interface, const QVariantMap& changedProperties,
+                                          const QStringList& /*invalidatedProperties*/, const QDBusMessage& message)
+{
+  if(interface != UDISKS2_DRIVE_IFACE && interface != UDISKS2_ATA_IFACE &&
+     interface != UDISKS2_MDRAID_IFACE && interface != UDISKS2_JOB_IFACE)
+    return;
+
+  QVariantMap properties = changedProperties;
+  decodeProperties(properties);
+
+  emit propertiesChanged(QDBusObjectPath(message.path()), interface, properties);
+}
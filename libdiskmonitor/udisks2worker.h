@@ -0,0 +1,201 @@
+/****************************************************************************
+ * DisKMonitor, KDE tools to monitor SMART and MDRaid health status         *
+ * Copyright (C) 2014-2015 Michaël Lhomme <papylhomme@gmail.com>            *
+ *                                                                          *
+ * This program is free software; you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation; either version 2 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License along  *
+ * with this program; if not, write to the Free Software Foundation, Inc.,  *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.              *
+ ****************************************************************************/
+
+
+#ifndef UDISKS2WORKER_H
+#define UDISKS2WORKER_H
+
+#include <QObject>
+#include <QMap>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QDBusConnection>
+#include <QDBusObjectPath>
+#include <QDBusPendingCallWatcher>
+
+#include "dbus_metatypes.h"
+
+
+
+//maximum number of units updated concurrently
+#define UDISKS2_MAX_UPDATES_IN_FLIGHT 16
+
+//power states reported by PmGetState (ATA CHECK POWER MODE) below this value are standby modes
+#define ATA_PM_STATE_IDLE 0x80
+
+
+
+/*
+ * Number of DBus calls sent for a method, by a caller of libdiskmonitor
+ */
+struct DBusCallCount {
+  QString interface;
+  QString member;
+  QString caller;
+  quint64 count;
+
+  bool operator<(const DBusCallCount& other) const
+  {
+    return interface < other.interface ||
+           (interface == other.interface && (member < other.member ||
+                                             (member == other.member && caller < other.caller)));
+  }
+};
+
+
+
+/*
+ * Typed DBus proxies, generated at build time from the introspection data
+ */
+class PropertiesProxy;
+class ObjectManagerProxy;
+class DriveAtaProxy;
+class MDRaidProxy;
+
+
+/*
+ * Carry the UDisks2 DBus traffic in a dedicated thread
+ *
+ * The worker owns its own connection to the system bus, a slow device only stalls
+ * the worker's thread. Requests are received through queued slots, results are
+ * published with signals, delivered in the thread of the receiver (the wrapper)
+ *
+ * Calls are asynchronous: up to UDISKS2_MAX_UPDATES_IN_FLIGHT units are updated
+ * concurrently, the other update requests waiting in a queue
+ */
+class UDisks2Worker : public QObject
+{
+  Q_OBJECT
+
+public:
+  UDisks2Worker();
+  ~UDisks2Worker() override;
+
+  quint64 getRoundTripCount() const;
+  quint64 getCallCount(const QString& interface, const QString& member = QString(), const QString& caller = QString()) const;
+  QList<DBusCallCount> getCallCounts() const;
+  void resetCallCounts();
+
+  quint64 getAttributesCacheHitCount() const;
+  quint64 getAttributesCacheMissCount() const;
+  void resetAttributesCacheStats();
+
+
+public slots:
+  void setCallTimeout(int msecs);
+  void listObjects();
+
+  void updateDrive(const QDBusObjectPath& objectPath, bool hasATAIface, bool pmSupported, bool attributesOutdated, qulonglong smartUpdated);
+  void updateMDRaid(const QDBusObjectPath& objectPath);
+  void updateSMARTAttributes(const QDBusObjectPath& objectPath);
+  void releaseProxies(const QDBusObjectPath& objectPath);
+
+  void requestMDRaidSyncAction(const QDBusObjectPath& objectPath, const QString& action);
+  void enableSMART(const QDBusObjectPath& objectPath);
+  void startSMARTSelfTest(const QDBusObjectPath& objectPath, const QString& type);
+  void cancelSMARTSelfTest(const QDBusObjectPath& objectPath);
+
+
+private:
+
+  /*
+   * An update request, and its state once started
+   */
+  struct UnitUpdate {
+    QDBusObjectPath objectPath;
+    QString interface;
+    QString caller;
+    bool hasATAIface = false;
+    bool pmSupported = false;
+    bool attributesOutdated = false;
+    qulonglong smartUpdated = 0;
+
+    qint64 startedAt = 0;
+    int pendingCalls = 0;
+    QStringList failedInterfaces;
+    bool timedOut = false;
+  };
+
+  QDBusConnection connection;
+  ObjectManagerProxy* objectManager;
+
+  //proxies cache, per object path
+  QMap<QDBusObjectPath, PropertiesProxy*> propertiesProxies;
+  QMap<QDBusObjectPath, DriveAtaProxy*> ataProxies;
+  QMap<QDBusObjectPath, MDRaidProxy*> mdraidProxies;
+
+  QList<UnitUpdate> queuedUpdates;
+  QMap<QDBusObjectPath, UnitUpdate> runningUpdates;
+
+  //requests received for a unit being updated, started once the running update finishes
+  QMap<QDBusObjectPath, UnitUpdate> followUpUpdates;
+
+  //read from the other threads
+  mutable QMutex callCountsMutex;
+  QMap<DBusCallCount, quint64> callCounts;
+  QAtomicInt attributesCacheHits;
+  QAtomicInt attributesCacheMisses;
+
+  int callTimeout;
+
+  void enqueueUpdate(const UnitUpdate& update);
+  static void mergeUpdate(UnitUpdate& queued, const UnitUpdate& update);
+  void startUpdates();
+  void callPmGetState(UnitUpdate& update);
+  void callDriveGetAll(UnitUpdate& update);
+  void callGetAll(UnitUpdate& update, const QString& interface);
+  void callSmartGetAttributes(UnitUpdate& update);
+  void callFinished(UnitUpdate& update);
+
+  QDBusPendingCallWatcher* watch(const QDBusPendingCall& call, const QDBusObjectPath& objectPath, const QString& what,
+                                 const QString& interface, const QString& member, const QString& caller);
+  void countCall(const QString& interface, const QString& member, const QString& caller);
+  static bool isTimeout(const QDBusError& error);
+
+  template<typename T> T* proxy(QMap<QDBusObjectPath, T*>& cache, const QDBusObjectPath& objectPath);
+
+  static void decodeProperties(QVariantMap& properties);
+
+
+private slots:
+  void objectsReceived(QDBusPendingCallWatcher* watcher);
+  void powerStateReceived(QDBusPendingCallWatcher* watcher);
+  void propertiesReceived(QDBusPendingCallWatcher* watcher);
+  void attributesReceived(QDBusPendingCallWatcher* watcher);
+  void actionFinished(QDBusPendingCallWatcher* watcher);
+
+  void dbusInterfacesAdded(const QDBusObjectPath&, const InterfaceList&);
+  void dbusInterfacesRemoved(const QDBusObjectPath&, const QStringList&);
+  void dbusPropertiesChanged(const QString&, const QVariantMap&, const QStringList&, const QDBusMessage&);
+
+
+signals:
+  void objectsListed(const ManagedObjectList& objects);
+  void objectsListFailed();
+  void interfacesAdded(const QDBusObjectPath& objectPath, const InterfaceList& interfaces);
+  void interfacesRemoved(const QDBusObjectPath& objectPath, const QStringList& interfaces);
+  void propertiesChanged(const QDBusObjectPath& objectPath, const QString& interface, const QVariantMap& properties);
+
+  void propertiesRetrieved(const QDBusObjectPath& objectPath, const QString& interface, const QVariantMap& properties);
+  void attributesRetrieved(const QDBusObjectPath& objectPath, const SmartAttributesList& attributes);
+  void powerStateRetrieved(const QDBusObjectPath& objectPath, bool standby);
+  void updateFinished(const QDBusObjectPath& objectPath, const QStringList& failedInterfaces, bool timedOut);
+};
+
+#endif // UDISKS2WORKER_H
@@ -23,6 +23,11 @@
 
 #include "drive.h"
 #include "mdraid.h"
+#include "udisks2worker.h"
+#include "unitscheduler.h"
+#include "diskmonitor_debug.h"
+#include "healthruleengine.h"
+#include "tracer.h"
 
 
 /*
@@ -54,6 +59,12 @@ void initQDbusMetaTypes()
 
   qRegisterMetaType<MDRaidMemberList>("MDRaidMemberList");
   qDBusRegisterMetaType<MDRaidMemberList>();
+
+  qRegisterMetaType<UnitHealthList>("UnitHealthList");
+  qDBusRegisterMetaType<UnitHealthList>();
+
+  //used by the queued signals of the worker
+  qRegisterMetaType<QDBusObjectPath>("QDBusObjectPath");
 }
 
 
@@ -140,7 +151,7 @@ const QDBusArgument &operator>>(const QDBusArgument &argument, MDRaidMember& rai
 
 
 /*
- * Retrieve an instance of UDisks2Wrapper. ATM not thread-safe
+ * Retrieve an instance of UDisks2Wrapper. The wrapper must only be used from the main thread
  */
 UDisks2Wrapper* UDisks2Wrapper::instance() {
   return myUDisks2WrapperInstance;
@@ -149,64 +160,127 @@ UDisks2Wrapper* UDisks2Wrapper::instance() {
 
 
 /*
- * UDisks2Wrapper constructor. Set the connection to UDisks2 to handle device hotplugging
+ * UDisks2Wrapper constructor. Start the worker carrying the DBus traffic, and
+ * forward its results to the main thread
  */
 UDisks2Wrapper::UDisks2Wrapper() : QObject()
 {
   initQDbusMetaTypes();
 
+  worker = new UDisks2Worker();
+  worker -> moveToThread(&workerThread);
+
+  connect(worker, SIGNAL(objectsListed(ManagedObjectList)), this, SLOT(objectsListed(ManagedObjectList)));
+  connect(worker, SIGNAL(objectsListFailed()), this, SLOT(objectsListFailed()));
+  connect(worker, SIGNAL(interfacesAdded(QDBusObjectPath, InterfaceList)), this, SLOT(interfacesAdded(QDBusObjectPath, InterfaceList)));
+  connect(worker, SIGNAL(interfacesRemoved(QDBusObjectPath, QStringList)), this, SLOT(interfacesRemoved(QDBusObjectPath, QStringList)));
+  connect(worker, SIGNAL(propertiesChanged(QDBusObjectPath, QString, QVariantMap)),
+          this, SLOT(propertiesChanged(QDBusObjectPath, QString, QVariantMap)));
 
-  //connection to UDisks2 signals
-  bool connected;
+  connect(worker, SIGNAL(propertiesRetrieved(QDBusObjectPath, QString, QVariantMap)),
+          this, SLOT(propertiesRetrieved(QDBusObjectPath, QString, QVariantMap)));
+  connect(worker, SIGNAL(attributesRetrieved(QDBusObjectPath, SmartAttributesList)),
+          this, SLOT(attributesRetrieved(QDBusObjectPath, SmartAttributesList)));
+  connect(worker, SIGNAL(powerStateRetrieved(QDBusObjectPath, bool)), this, SLOT(powerStateRetrieved(QDBusObjectPath, bool)));
+  connect(worker, SIGNAL(updateFinished(QDBusObjectPath, QStringList, bool)),
+          this, SLOT(updateFinished(QDBusObjectPath, QStringList, bool)));
 
-  connected = QDBusConnection::systemBus().connect(UDISKS2_SERVICE, UDISKS2_PATH, UDISKS2_OBJECT_IFACE, "InterfacesAdded",
-              this, SLOT(interfacesAdded(QDBusObjectPath, InterfaceList)));
-  if(!connected)
-    qWarning() << "Unable to connect to InterfacesAdded signal, won't handle device insertion !";
+  listRetryTimer.setSingleShot(true);
+  listRetryTimer.setInterval(UDISKS2_LIST_RETRY_DELAY);
+  connect(&listRetryTimer, SIGNAL(timeout()), this, SLOT(retryListing()));
 
-  connected = QDBusConnection::systemBus().connect(UDISKS2_SERVICE, UDISKS2_PATH, UDISKS2_OBJECT_IFACE, "InterfacesRemoved",
-              this, SLOT(interfacesRemoved(QDBusObjectPath, QStringList)));
-  if(!connected)
-    qWarning() << "Unable to connect to InterfacesRemoved signal, won't handle device removal !";
+  workerThread.start();
+
+  scheduler = new UnitScheduler(this);
 }
 
 
 
 /*
  * Initialize the internal list of StorageUnit from UDisks2
+ *
+ * The list of nodes is requested to the worker, the units are then added
+ * by UDisks2Wrapper::objectsListed() when the reply arrives. The wrapper is
+ * only considered initialized once the list is received
  */
 void UDisks2Wrapper::initialize()
 {
-  //call the manager to retrieve a list of nodes
-  QDBusInterface objManagerIface(UDISKS2_SERVICE, UDISKS2_PATH, UDISKS2_OBJECT_IFACE, QDBusConnection::systemBus());
-  QDBusReply<ManagedObjectList> res = objManagerIface.call("GetManagedObjects");
+  listing = true;
+  QMetaObject::invokeMethod(worker, "listObjects", Qt::QueuedConnection);
+}
 
-  if(!res.isValid()) {
-    qCritical() << "Error while retrieving UDisks2 objects ! " << res .error();
-    //TODO ? exception to handle in UI and display error to user ?
-  }
 
-  ManagedObjectList objects = res.value();
 
+/*
+ * Create the units from the list of nodes retrieved by UDisks2Wrapper::initialize()
+ *
+ * @param objects The UDisks2 nodes with their interfaces
+ */
+void UDisks2Wrapper::objectsListed(const ManagedObjectList& objects)
+{
+  TRACE_SCOPE("enumeration", "create units");
+
+  initialized = true;
+  listing = false;
 
-  //loop over the result to extract existing raid arrays and drives.
+  //first collect the interfaces of the raid arrays and drives, used to populate the units
   foreach(QDBusObjectPath objectPath, objects.keys()) {
-    StorageUnit* newUnit = createNewUnitFromBlockDevice(objects[objectPath]);
+    if(isStorageUnitNode(objectPath))
+      nodeInterfaces[objectPath] = objects[objectPath];
+  }
+
+  //then loop over the block devices to create the units
+  foreach(QDBusObjectPath objectPath, objects.keys()) {
+    bool populated;
+    StorageUnit* newUnit = createNewUnitFromBlockDevice(objects[objectPath], populated);
 
     if(newUnit != nullptr)
-      units[newUnit -> getObjectPath()] = newUnit;
+      addStorageUnit(newUnit, populated);
   }
 
-  initialized = true;
+  //finally attach the running jobs to their unit
+  foreach(QDBusObjectPath objectPath, objects.keys()) {
+    if(objects[objectPath].contains(UDISKS2_JOB_IFACE))
+      jobAdded(objectPath, objects[objectPath][UDISKS2_JOB_IFACE]);
+  }
+}
+
+
+
+/*
+ * Handle the failure of the listing requested by UDisks2Wrapper::initialize(),
+ * retried after UDISKS2_LIST_RETRY_DELAY (ie. UDisks2 started after the daemon)
+ */
+void UDisks2Wrapper::objectsListFailed()
+{
+  listing = false;
+  listRetryTimer.start();
 }
 
 
 
 /*
- * Destructor
+ * List the units again after a failure, unless listStorageUnits() already did
+ */
+void UDisks2Wrapper::retryListing()
+{
+  if(!initialized && !listing)
+    initialize();
+}
+
+
+
+/*
+ * Destructor. Stop the worker before releasing the units
  */
 UDisks2Wrapper::~UDisks2Wrapper()
 {
+  delete scheduler;
+
+  workerThread.quit();
+  workerThread.wait();
+  delete worker;
+
   foreach(StorageUnit* unit, units.values())
     delete unit;
 
@@ -218,12 +292,13 @@ UDisks2Wrapper::~UDisks2Wrapper()
 /*
  * Get the internal cached list of StorageUnit.
  *
- * The wrapper use lazy initialization, as a result this method can result
- * in call to DBus the first time it is called
+ * The wrapper use lazy initialization, the first call to this method start
+ * the retrieval of the units and return an empty list. Units are then notified
+ * using the storageUnitAdded() signal as soon as they are available
  */
 QList<StorageUnit*> UDisks2Wrapper::listStorageUnits()
 {
-  if(!initialized)
+  if(!initialized && !listing)
     initialize();
 
   return units.values();
@@ -232,50 +307,265 @@ QList<StorageUnit*> UDisks2Wrapper::listStorageUnits()
 
 
 /*
- * Get a DBus Properties interface for the given node
+ * Start a refresh cycle, requesting an update of every unit
+ *
+ * @see UDisks2Wrapper::refreshStorageUnits(const QList<StorageUnit*>&)
+ */
+void UDisks2Wrapper::refreshStorageUnits()
+{
+  refreshStorageUnits(units.values());
+}
+
+
+
+/*
+ * Start a refresh cycle, requesting an update of the given units
+ *
+ * Requests are sent at once and processed concurrently by the worker. Each unit
+ * notifies its update with StorageUnit::updated(), the end of the cycle is notified
+ * by a single storageUnitsRefreshed(). If a cycle is already running, the units
+ * join it
  *
- * @param objectPath The DBus path identifying the node
+ * @param selection The units to refresh
+ */
+void UDisks2Wrapper::refreshStorageUnits(const QList<StorageUnit*>& selection)
+{
+  bool started = !refreshing;
+
+  if(started) {
+    refreshCycle++;
+    TRACE_ASYNC_BEGIN("refresh", "refresh cycle", refreshCycle);
+  }
+
+  refreshing = true;
+  foreach(StorageUnit* unit, selection)
+    unit -> update();
+
+  //nothing requested, units being suspended
+  if(started && refreshPending.isEmpty()) {
+    refreshing = false;
+    TRACE_ASYNC_END("refresh", "refresh cycle", refreshCycle);
+    emit storageUnitsRefreshed();
+  }
+}
+
+
+
+/*
+ * Test if a refresh cycle is running. Listeners of StorageUnit::updated() may
+ * wait for storageUnitsRefreshed() instead of handling each unit
  */
-QDBusInterface*UDisks2Wrapper::propertiesIface(QDBusObjectPath objectPath) const
+bool UDisks2Wrapper::isRefreshing() const
 {
-  return new QDBusInterface(UDISKS2_SERVICE, objectPath.path(), DBUS_PROPERTIES_IFACE, QDBusConnection::systemBus());
+  return refreshing;
 }
 
 
 
 /*
- * Get a UDISKS2 Drive interface for the given node
+ * Account for the end of a unit's update in the running refresh cycle
  *
- * @param objectPath The DBus path identifying the node
+ * @param objectPath The updated (or removed) unit
+ */
+void UDisks2Wrapper::unitRefreshed(const QDBusObjectPath& objectPath)
+{
+  if(!refreshPending.remove(objectPath) || !refreshPending.isEmpty())
+    return;
+
+  qCDebug(DISKMONITOR_UDISKS2) << "UDisks2Wrapper => Refresh done, " << getRoundTripCount() << " DBus calls, SMART attributes cache hit rate "
+                               << qRound(getAttributesCacheHitRate() * 100) << "%";
+
+  refreshing = false;
+  TRACE_ASYNC_END("refresh", "refresh cycle", refreshCycle);
+  emit storageUnitsRefreshed();
+}
+
+
+
+/*
+ * Get the polling scheduler of the units, inactive until started
  */
-QDBusInterface* UDisks2Wrapper::driveIface(QDBusObjectPath objectPath) const
+UnitScheduler* UDisks2Wrapper::getScheduler() const
 {
-  return new QDBusInterface(UDISKS2_SERVICE, objectPath.path(), UDISKS2_DRIVE_IFACE, QDBusConnection::systemBus());
+  return scheduler;
+}
+
+
 
+/*
+ * Get the deadline of the DBus calls, in milliseconds
+ */
+int UDisks2Wrapper::getCallTimeout() const
+{
+  return callTimeout;
 }
 
 
 
 /*
- * Get a UDISKS2 Drive_ATA interface for the given node
+ * Set the deadline of the DBus calls. A unit whose calls repeatedly
+ * time out is considered unresponsive
  *
- * @param objectPath The DBus path identifying the node
+ * @param msecs The timeout in milliseconds
+ * @see StorageUnit::isUnresponsive()
  */
-QDBusInterface* UDisks2Wrapper::ataIface(QDBusObjectPath objectPath) const
+void UDisks2Wrapper::setCallTimeout(int msecs)
 {
-  return new QDBusInterface(UDISKS2_SERVICE, objectPath.path(), UDISKS2_ATA_IFACE, QDBusConnection::systemBus());
+  callTimeout = msecs;
+  QMetaObject::invokeMethod(worker, "setCallTimeout", Qt::QueuedConnection, Q_ARG(int, msecs));
 }
 
 
 
 /*
- * Get a UDISKS2 MDRaid interface for the given node
+ * Get the number of DBus calls sent by the worker since its
+ * creation or the last call to resetCallCounts()
+ */
+quint64 UDisks2Wrapper::getRoundTripCount() const
+{
+  return worker -> getRoundTripCount();
+}
+
+
+
+/*
+ * Get the number of DBus calls sent for a method, empty filters matching everything
  *
- * @param objectPath The DBus path identifying the node
+ * @param interface The DBus interface of the method
+ * @param member The method
+ * @param caller The caller in libdiskmonitor (Drive::update, UDisks2Wrapper::enableSMART...)
  */
-QDBusInterface*UDisks2Wrapper::mdraidIface(QDBusObjectPath objectPath) const
+quint64 UDisks2Wrapper::getCallCount(const QString& interface, const QString& member, const QString& caller) const
 {
-  return new QDBusInterface(UDISKS2_SERVICE, objectPath.path(), UDISKS2_MDRAID_IFACE, QDBusConnection::systemBus());
+  return worker -> getCallCount(interface, member, caller);
+}
+
+
+
+/*
+ * Get the number of DBus calls sent for every method and caller
+ */
+QList<DBusCallCount> UDisks2Wrapper::getCallCounts() const
+{
+  return worker -> getCallCounts();
+}
+
+
+
+/*
+ * Reset the DBus call counters
+ */
+void UDisks2Wrapper::resetCallCounts()
+{
+  worker -> resetCallCounts();
+}
+
+
+
+/*
+ * Log the DBus call counters, one line per method and caller
+ */
+void UDisks2Wrapper::dumpCallCounts() const
+{
+  qCDebug(DISKMONITOR_UDISKS2) << "UDisks2Wrapper => DBus calls since the last reset:";
+
+  foreach(const DBusCallCount& c, getCallCounts())
+    qCDebug(DISKMONITOR_UDISKS2).nospace() << "  " << c.interface << "." << c.member << " from " << c.caller << ": " << c.count;
+
+  qCDebug(DISKMONITOR_UDISKS2) << "  total:" << getRoundTripCount();
+}
+
+
+
+/*
+ * Get the number of drive updates which reused the cached SMART attributes
+ */
+quint64 UDisks2Wrapper::getAttributesCacheHitCount() const
+{
+  return worker -> getAttributesCacheHitCount();
+}
+
+
+
+/*
+ * Get the number of SMART attributes retrievals
+ */
+quint64 UDisks2Wrapper::getAttributesCacheMissCount() const
+{
+  return worker -> getAttributesCacheMissCount();
+}
+
+
+
+/*
+ * Get the ratio of SMART attributes reused from the cache, between 0 and 1
+ */
+double UDisks2Wrapper::getAttributesCacheHitRate() const
+{
+  quint64 hits = getAttributesCacheHitCount();
+  quint64 total = hits + getAttributesCacheMissCount();
+
+  return total == 0 ? 0 : (double) hits / total;
+}
+
+
+
+/*
+ * Reset the SMART attributes cache statistics
+ */
+void UDisks2Wrapper::resetAttributesCacheStats()
+{
+  worker -> resetAttributesCacheStats();
+}
+
+
+
+/*
+ * Request the worker to update the given drive
+ *
+ * @param drive The drive to update
+ * @see UDisks2Worker::updateDrive()
+ */
+void UDisks2Wrapper::requestUpdate(Drive* drive)
+{
+  if(refreshing)
+    refreshPending.insert(drive -> getObjectPath());
+
+  QMetaObject::invokeMethod(worker, "updateDrive", Qt::QueuedConnection,
+                            Q_ARG(QDBusObjectPath, drive -> getObjectPath()),
+                            Q_ARG(bool, drive -> hasATAIface),
+                            Q_ARG(bool, drive -> pmSupported),
+                            Q_ARG(bool, drive -> attributesOutdated),
+                            Q_ARG(qulonglong, drive -> smartUpdated));
+}
+
+
+
+/*
+ * Request the worker to update the given raid array
+ *
+ * @param mdraid The raid array to update
+ */
+void UDisks2Wrapper::requestUpdate(MDRaid* mdraid)
+{
+  if(refreshing)
+    refreshPending.insert(mdraid -> getObjectPath());
+
+  QMetaObject::invokeMethod(worker, "updateMDRaid", Qt::QueuedConnection,
+                            Q_ARG(QDBusObjectPath, mdraid -> getObjectPath()));
+}
+
+
+
+/*
+ * Request the worker to retrieve the SMART attributes of the given drive
+ *
+ * @param drive The drive
+ */
+void UDisks2Wrapper::requestSMARTAttributes(Drive* drive) const
+{
+  QMetaObject::invokeMethod(worker, "updateSMARTAttributes", Qt::QueuedConnection,
+                            Q_ARG(QDBusObjectPath, drive -> getObjectPath()));
 }
 
 
@@ -287,13 +577,9 @@ QDBusInterface*UDisks2Wrapper::mdraidIface(QDBusObjectPath objectPath) const
  */
 void UDisks2Wrapper::startMDRaidScrubbing(MDRaid* mdraid) const
 {
-  QDBusInterface mdraid_iface(UDISKS2_SERVICE, mdraid -> getPath(), UDISKS2_MDRAID_IFACE, QDBusConnection::systemBus());
-
-  qDebug() << "Request scrubbing on MDRaid '" << mdraid -> getPath() << "'";
-  QDBusReply<void> res = mdraid_iface.call("RequestSyncAction", "check", QVariantMap());
-
-  if(!res.isValid())
-    qWarning() << "Error sending request to scrub MDRaid '" << mdraid -> getPath() << "' : " << res.error();
+  qCDebug(DISKMONITOR_UDISKS2) << "Request scrubbing on MDRaid '" << mdraid -> getPath() << "'";
+  QMetaObject::invokeMethod(worker, "requestMDRaidSyncAction", Qt::QueuedConnection,
+                            Q_ARG(QDBusObjectPath, mdraid -> getObjectPath()), Q_ARG(QString, "check"));
 }
 
 
@@ -306,19 +592,16 @@ void UDisks2Wrapper::startMDRaidScrubbing(MDRaid* mdraid) const
 
 void UDisks2Wrapper::cancelMDRaidScrubbing(MDRaid* mdraid) const
 {
-  QDBusInterface mdraid_iface(UDISKS2_SERVICE, mdraid -> getPath(), UDISKS2_MDRAID_IFACE, QDBusConnection::systemBus());
-
-  QString currentOperation = mdraid_iface.property("RequestSyncAction").toString();
+  //use the cached value, kept up to date by UDisks2's notifications
+  QString currentOperation = mdraid -> getSyncAction();
   if(currentOperation != "check") {
     qWarning() << "Can't cancel operation '" << currentOperation << "' on MDRaid '" << mdraid -> getPath() << "': aborting";
     return;
   }
 
-  qDebug() << "Request cancelation of scrubbing on MDRaid '" << mdraid -> getPath() << "'";
-  QDBusReply<void> res = mdraid_iface.call("RequestSyncAction", "idle", QVariantMap());
-
-  if(!res.isValid())
-    qWarning() << "Error sending request to cancel scrubbing on MDRaid '" << mdraid -> getPath() << "' : " << res.error();
+  qCDebug(DISKMONITOR_UDISKS2) << "Request cancelation of scrubbing on MDRaid '" << mdraid -> getPath() << "'";
+  QMetaObject::invokeMethod(worker, "requestMDRaidSyncAction", Qt::QueuedConnection,
+                            Q_ARG(QDBusObjectPath, mdraid -> getObjectPath()), Q_ARG(QString, "idle"));
 }
 
 
@@ -330,13 +613,9 @@ void UDisks2Wrapper::cancelMDRaidScrubbing(MDRaid* mdraid) const
  */
 void UDisks2Wrapper::enableSMART(Drive* drive) const
 {
-  QDBusInterface ata_iface(UDISKS2_SERVICE, drive -> getPath(), UDISKS2_ATA_IFACE, QDBusConnection::systemBus());
-
-  qDebug() << "Request to enable SMART on Drive '" << drive -> getPath() << "'";
-  QDBusReply<void> res = ata_iface.call("SmartSetEnabled", true, QVariantMap());
-
-  if(!res.isValid())
-    qWarning() << "Error sending request to enable SMART on Drive '" << drive -> getPath() << "' : " << res.error();
+  qCDebug(DISKMONITOR_UDISKS2) << "Request to enable SMART on Drive '" << drive -> getPath() << "'";
+  QMetaObject::invokeMethod(worker, "enableSMART", Qt::QueuedConnection,
+                            Q_ARG(QDBusObjectPath, drive -> getObjectPath()));
 }
 
 
@@ -357,13 +636,9 @@ void UDisks2Wrapper::startSMARTSelfTest(Drive* drive, SMARTSelfTestType type) co
     default: strType = "short"; break;
   }
 
-  QDBusInterface ata_iface(UDISKS2_SERVICE, drive -> getPath(), UDISKS2_ATA_IFACE, QDBusConnection::systemBus());
-
-  qDebug() << "Request " << strType << " selftest on Drive '" << drive -> getPath() << "'";
-  QDBusReply<void> res = ata_iface.call("SmartSelftestStart", strType, QVariantMap());
-
-  if(!res.isValid())
-    qWarning() << "Error sending request to start SMART SelfTest on drive '" << drive -> getPath() << "' : " << res.error();
+  qCDebug(DISKMONITOR_UDISKS2) << "Request " << strType << " selftest on Drive '" << drive -> getPath() << "'";
+  QMetaObject::invokeMethod(worker, "startSMARTSelfTest", Qt::QueuedConnection,
+                            Q_ARG(QDBusObjectPath, drive -> getObjectPath()), Q_ARG(QString, strType));
 }
 
 
@@ -375,14 +650,9 @@ void UDisks2Wrapper::startSMARTSelfTest(Drive* drive, SMARTSelfTestType type) co
  */
 void UDisks2Wrapper::cancelSMARTSelfTest(Drive* drive) const
 {
-  QDBusInterface ata_iface(UDISKS2_SERVICE, drive -> getPath(), UDISKS2_ATA_IFACE, QDBusConnection::systemBus());
-
-  qDebug() << "Request cancelation of selftest on Drive '" << drive -> getPath() << "'";
-  QDBusReply<void> res = ata_iface.call("SmartSelftestAbort", QVariantMap());
-
-  if(!res.isValid())
-    qWarning() << "Error sending request to cancel SMART SelfTest on drive '" << drive -> getPath() << "' : " << res.error();
-
+  qCDebug(DISKMONITOR_UDISKS2) << "Request cancelation of selftest on Drive '" << drive -> getPath() << "'";
+  QMetaObject::invokeMethod(worker, "cancelSMARTSelfTest", Qt::QueuedConnection,
+                            Q_ARG(QDBusObjectPath, drive -> getObjectPath()));
 }
 
 
@@ -395,13 +665,31 @@ void UDisks2Wrapper::cancelSMARTSelfTest(Drive* drive) const
  */
 void UDisks2Wrapper::interfacesAdded(const QDBusObjectPath& objectPath, const InterfaceList& interfaces)
 {
-  qDebug() << "UDisks2Wrapper => New interfaces added to path '" << objectPath.path() << "'";
+  qCDebug(DISKMONITOR_UDISKS2) << "UDisks2Wrapper => New interfaces added to path '" << objectPath.path() << "'";
+
+  if(interfaces.contains(UDISKS2_JOB_IFACE)) {
+    jobAdded(objectPath, interfaces[UDISKS2_JOB_IFACE]);
+    return;
+  }
 
-  StorageUnit* newUnit = createNewUnitFromBlockDevice(interfaces);
-  if(newUnit != nullptr) {
-    units[newUnit -> getObjectPath()] = newUnit;
-    emit storageUnitAdded(newUnit);
+  //drive or raid node, keep its interfaces for the unit creation or update the existing unit
+  if(isStorageUnitNode(objectPath)) {
+    StorageUnit* unit = units.value(objectPath, nullptr);
+
+    foreach(const QString& interface, interfaces.keys()) {
+      if(unit != nullptr)
+        unit -> applyProperties(interface, interfaces[interface]);
+      else
+        nodeInterfaces[objectPath][interface] = interfaces[interface];
+    }
+
+    return;
   }
+
+  bool populated;
+  StorageUnit* newUnit = createNewUnitFromBlockDevice(interfaces, populated);
+  if(newUnit != nullptr)
+    addStorageUnit(newUnit, populated);
 }
 
 
@@ -414,42 +702,193 @@ void UDisks2Wrapper::interfacesAdded(const QDBusObjectPath& objectPath, const In
  */
 void UDisks2Wrapper::interfacesRemoved(const QDBusObjectPath& objectPath, const QStringList& /*interfaces*/)
 {
-  qDebug() << "UDisks2Wrapper => Interfaces removed from path '" << objectPath.path() << "'";
+  qCDebug(DISKMONITOR_UDISKS2) << "UDisks2Wrapper => Interfaces removed from path '" << objectPath.path() << "'";
+
+  nodeInterfaces.remove(objectPath);
 
-  if(objectPath.path().startsWith(UDISKS2_DRIVES_PATH) ||
-     objectPath.path().startsWith(UDISKS2_MDRAIDS_PATH)) {
+  if(jobs.contains(objectPath)) {
+    jobRemoved(objectPath);
+    return;
+  }
 
+  if(isStorageUnitNode(objectPath) && units.contains(objectPath)) {
     emit storageUnitRemoved(units[objectPath]);
     StorageUnit* u = units.take(objectPath);
+
+    foreach(QDBusObjectPath jobPath, jobs.keys(u))
+      jobs.remove(jobPath);
+
+    HealthRuleEngine::instance() -> forget(objectPath.path());
     delete u;
+
+    QMetaObject::invokeMethod(worker, "releaseProxies", Qt::QueuedConnection, Q_ARG(QDBusObjectPath, objectPath));
+    unitRefreshed(objectPath);
   }
 }
 
 
 
 
+/*
+ * Handle "PropertiesChanged" signal to update the cached properties of the StorageUnit
+ *
+ * @param objectPath The node owning the properties
+ * @param interface The interface owning the properties
+ * @param changedProperties The properties that changed with their new values
+ */
+void UDisks2Wrapper::propertiesChanged(const QDBusObjectPath& objectPath, const QString& interface, const QVariantMap& changedProperties)
+{
+  if(interface == UDISKS2_JOB_IFACE) {
+    StorageUnit* unit = jobs.value(objectPath, nullptr);
+    if(unit != nullptr)
+      unit -> applyJobProperties(objectPath, changedProperties);
+
+    return;
+  }
+
+  StorageUnit* unit = units.value(objectPath, nullptr);
+  if(unit != nullptr)
+    unit -> applyProperties(interface, changedProperties);
+}
+
+
+
+/*
+ * Read the properties retrieved by the worker into the unit's cached fields
+ *
+ * @param objectPath The node owning the properties
+ * @param interface The interface owning the properties
+ * @param properties The properties of the interface
+ */
+void UDisks2Wrapper::propertiesRetrieved(const QDBusObjectPath& objectPath, const QString& interface, const QVariantMap& properties)
+{
+  StorageUnit* unit = units.value(objectPath, nullptr);
+  if(unit != nullptr)
+    unit -> updateProperties(interface, properties);
+}
+
+
+
+/*
+ * Store the SMART attributes retrieved by the worker in the drive
+ *
+ * @param objectPath The drive's node
+ * @param attributes The SMART attributes
+ */
+void UDisks2Wrapper::attributesRetrieved(const QDBusObjectPath& objectPath, const SmartAttributesList& attributes)
+{
+  StorageUnit* unit = units.value(objectPath, nullptr);
+  if(unit != nullptr && unit -> isDrive()) {
+    Drive* drive = static_cast<Drive*>(unit);
+    drive -> setSMARTAttributes(attributes);
+  }
+}
+
+
+
+/*
+ * Store the power state retrieved by the worker in the drive
+ *
+ * @param objectPath The drive's node
+ * @param standby true if the drive is in standby
+ */
+void UDisks2Wrapper::powerStateRetrieved(const QDBusObjectPath& objectPath, bool standby)
+{
+  StorageUnit* unit = units.value(objectPath, nullptr);
+  if(unit != nullptr && unit -> isDrive())
+    static_cast<Drive*>(unit) -> standby = standby;
+}
+
+
+
+/*
+ * Notify the end of an update done by the worker
+ *
+ * @param objectPath The updated node
+ * @param failedInterfaces The interfaces which couldn't be read
+ * @param timedOut true if a call has timed out, feeding the unit's circuit breaker
+ */
+void UDisks2Wrapper::updateFinished(const QDBusObjectPath& objectPath, const QStringList& failedInterfaces, bool timedOut)
+{
+  StorageUnit* unit = units.value(objectPath, nullptr);
+  if(unit != nullptr) {
+    unit -> recordTimeout(timedOut);
+    unit -> finishUpdate(failedInterfaces);
+  }
+
+  unitRefreshed(objectPath);
+}
+
+
+
+
+/*
+ * Attach a new UDisks2 job to the unit it operates on, if any
+ *
+ * http://udisks.freedesktop.org/docs/latest/gdbus-org.freedesktop.UDisks2.Job.html
+ *
+ * @param jobPath The job's node
+ * @param properties The properties of the JOB_IFACE
+ */
+void UDisks2Wrapper::jobAdded(const QDBusObjectPath& jobPath, const QVariantMap& properties)
+{
+  QList<QDBusObjectPath> objects = properties["Objects"].value< QList<QDBusObjectPath> >();
+
+  foreach(const QDBusObjectPath& objectPath, objects) {
+    StorageUnit* unit = units.value(objectPath, nullptr);
+    if(unit != nullptr) {
+      qCDebug(DISKMONITOR_UDISKS2) << "UDisks2Wrapper => Job '" << properties["Operation"].toString() << "' started on '" << objectPath.path() << "'";
+
+      jobs[jobPath] = unit;
+      unit -> applyJobProperties(jobPath, properties);
+      return;
+    }
+  }
+}
+
+
+
+/*
+ * Detach a completed job from its unit
+ *
+ * @param jobPath The job's node
+ */
+void UDisks2Wrapper::jobRemoved(const QDBusObjectPath& jobPath)
+{
+  StorageUnit* unit = jobs.take(jobPath);
+  if(unit != nullptr)
+    unit -> finishJob(jobPath);
+}
+
+
+
 /*
  * Create a new unit from a block device node
  *
  * @param interfaces A list of node interfaces
+ * @param populated Set to true if the unit has been populated with the properties of its node
  *
  * here we select block devices (and not directly raid or drive nodes) in order to
  * retrieve the associated Linux device name (/dev/sdX, /dev/mdX)
  * TODO: for raid we wan retrieve the associated drives too
  */
-StorageUnit* UDisks2Wrapper::createNewUnitFromBlockDevice(const InterfaceList& interfaces) const
+StorageUnit* UDisks2Wrapper::createNewUnitFromBlockDevice(const InterfaceList& interfaces, bool& populated)
 {
   if(!interfaces[UDISKS2_BLOCK_IFACE].empty()) {
     QDBusObjectPath drivePath = interfaces[UDISKS2_BLOCK_IFACE]["Drive"].value<QDBusObjectPath>();
     if(drivePath.path().size() > 1 && !units.contains(drivePath)) {
+      populated = nodeInterfaces.contains(drivePath);
       return new Drive(drivePath,
                        interfaces[UDISKS2_BLOCK_IFACE]["Device"].toString(),
-                       hasATAIface(drivePath));
+                       nodeInterfaces.take(drivePath));
     }
 
     QDBusObjectPath mdraidPath = interfaces[UDISKS2_BLOCK_IFACE]["MDRaid"].value<QDBusObjectPath>();
     if(mdraidPath.path().size() > 1 && !units.contains(mdraidPath)) {
-      return new MDRaid(mdraidPath, interfaces[UDISKS2_BLOCK_IFACE]["Device"].toString());
+      populated = nodeInterfaces.contains(mdraidPath);
+      return new MDRaid(mdraidPath,
+                        interfaces[UDISKS2_BLOCK_IFACE]["Device"].toString(),
+                        nodeInterfaces.take(mdraidPath));
     }
   }
 
@@ -459,13 +898,34 @@ StorageUnit* UDisks2Wrapper::createNewUnitFromBlockDevice(const InterfaceList& i
 
 
 /*
- * Test the presence of the ATA interface on the given path
+ * Register a new unit and notify listeners
+ *
+ * The unit's properties are already populated from the ObjectManager data. If the
+ * node was not known yet, an update is requested to the worker. The SMART attributes
+ * of a populated drive, not part of the ObjectManager data, are requested alone
+ * (see Drive::fetchOutdatedData()), unless the drive is in standby
+ *
+ * @param unit The new unit
+ * @param populated false if the unit was created without the node's properties
  */
-bool UDisks2Wrapper::hasATAIface(QDBusObjectPath objectPath) const
+void UDisks2Wrapper::addStorageUnit(StorageUnit* unit, bool populated)
 {
-  QDBusInterface ataIface (UDISKS2_SERVICE, objectPath.path(), UDISKS2_ATA_IFACE, QDBusConnection::systemBus());
-  ataIface.property("SmartSupported");
+  units[unit -> getObjectPath()] = unit;
+  emit storageUnitAdded(unit);
 
-  return !ataIface.lastError().isValid();
+  if(!populated)
+    unit -> update();
+  else if(unit -> isDrive() && !static_cast<Drive*>(unit) -> isStandby())
+    unit -> fetchOutdatedData();
 }
 
+
+
+/*
+ * Test if the given path is a drive or raid node
+ */
+bool UDisks2Wrapper::isStorageUnitNode(const QDBusObjectPath& objectPath)
+{
+  return objectPath.path().startsWith(UDISKS2_DRIVES_PATH) ||
+         objectPath.path().startsWith(UDISKS2_MDRAIDS_PATH);
+}
@@ -23,15 +23,16 @@
 
 #include <QObject>
 #include <QList>
-
-#include <QDBusConnection>
-#include <QDBusInterface>
+#include <QSet>
+#include <QThread>
+#include <QTimer>
 
 #include "dbus_metatypes.h"
 
 #include "storageunit.h"
 #include "mdraid.h"
 #include "drive.h"
+#include "udisks2worker.h"
 
 
 
@@ -44,16 +45,30 @@
 #define UDISKS2_ATA_IFACE "org.freedesktop.UDisks2.Drive.Ata"
 #define UDISKS2_MDRAID_IFACE "org.freedesktop.UDisks2.MDRaid"
 #define UDISKS2_BLOCK_IFACE "org.freedesktop.UDisks2.Block"
+#define UDISKS2_JOB_IFACE "org.freedesktop.UDisks2.Job"
 
 #define UDISKS2_PATH "/org/freedesktop/UDisks2"
 #define UDISKS2_DRIVES_PATH "/org/freedesktop/UDisks2/drives"
 #define UDISKS2_MDRAIDS_PATH "/org/freedesktop/UDisks2/mdraid"
 #define UDISKS2_BLOCK_DEVICES_PATH "/org/freedesktop/UDisks2/block_devices"
 
+//deadline of the DBus calls, in milliseconds
+#define UDISKS2_DEFAULT_CALL_TIMEOUT 10000
+
+//delay before listing the units again after a failure (UDisks2 not started yet...), in milliseconds
+#define UDISKS2_LIST_RETRY_DELAY 10000
+
+
+
+class UnitScheduler;
 
 
 /*
  * Singleton wrapper to access UDisks2 over DBus
+ *
+ * The wrapper and the units live in the main thread, the DBus traffic is carried
+ * by an UDisks2Worker running in its own thread. Updates and actions are
+ * asynchronous, units notify the results with StorageUnit::updated()
  */
 class UDisks2Wrapper : public QObject
 {
@@ -78,6 +93,12 @@ public:
 
   QList<StorageUnit*> listStorageUnits();
 
+  void refreshStorageUnits();
+  void refreshStorageUnits(const QList<StorageUnit*>& selection);
+  bool isRefreshing() const;
+
+  UnitScheduler* getScheduler() const;
+
   void startMDRaidScrubbing(MDRaid* mdraid) const;
   void cancelMDRaidScrubbing(MDRaid* mdraid) const;
 
@@ -85,27 +106,77 @@ public:
   void startSMARTSelfTest(Drive* drive, SMARTSelfTestType type) const;
   void cancelSMARTSelfTest(Drive* drive) const;
 
-  QDBusInterface* propertiesIface(QDBusObjectPath) const;
-  QDBusInterface* driveIface(QDBusObjectPath) const;
-  QDBusInterface* ataIface(QDBusObjectPath) const;
-  QDBusInterface* mdraidIface(QDBusObjectPath) const;
+  void requestUpdate(Drive* drive);
+  void requestUpdate(MDRaid* mdraid);
+  void requestSMARTAttributes(Drive* drive) const;
+
+  int getCallTimeout() const;
+  void setCallTimeout(int msecs);
+
+  quint64 getRoundTripCount() const;
+  quint64 getCallCount(const QString& interface, const QString& member = QString(), const QString& caller = QString()) const;
+  QList<DBusCallCount> getCallCounts() const;
+  void resetCallCounts();
+  void dumpCallCounts() const;
+
+  quint64 getAttributesCacheHitCount() const;
+  quint64 getAttributesCacheMissCount() const;
+  double getAttributesCacheHitRate() const;
+  void resetAttributesCacheStats();
 
 
 private:
   void initialize();
-  bool hasATAIface(QDBusObjectPath objectPath) const;
-  StorageUnit* createNewUnitFromBlockDevice(const InterfaceList& interfaces) const;
+  static bool isStorageUnitNode(const QDBusObjectPath& objectPath);
+  StorageUnit* createNewUnitFromBlockDevice(const InterfaceList& interfaces, bool& populated);
+  void addStorageUnit(StorageUnit* unit, bool populated);
 
+  //units listed from the ObjectManager, or listing in progress
   bool initialized = false;
+  bool listing = false;
+  QTimer listRetryTimer;
   QMap<QDBusObjectPath, StorageUnit*> units;
 
+  //interfaces of the drive and raid nodes not yet associated with a unit
+  QMap<QDBusObjectPath, InterfaceList> nodeInterfaces;
+
+  //running jobs, associated with the unit they operate on
+  QMap<QDBusObjectPath, StorageUnit*> jobs;
+
+  void jobAdded(const QDBusObjectPath& jobPath, const QVariantMap& properties);
+  void jobRemoved(const QDBusObjectPath& jobPath);
+
+  QThread workerThread;
+  UDisks2Worker* worker;
+
+  UnitScheduler* scheduler;
+
+  int callTimeout = UDISKS2_DEFAULT_CALL_TIMEOUT;
+
+  //units updated by the running refresh cycle
+  bool refreshing = false;
+  quint64 refreshCycle = 0;
+  QSet<QDBusObjectPath> refreshPending;
+
+  void unitRefreshed(const QDBusObjectPath& objectPath);
+
 private slots:
+  void objectsListed(const ManagedObjectList&);
+  void objectsListFailed();
+  void retryListing();
   void interfacesAdded(const QDBusObjectPath&, const InterfaceList&);
   void interfacesRemoved(const QDBusObjectPath&, const QStringList&);
+  void propertiesChanged(const QDBusObjectPath&, const QString&, const QVariantMap&);
+
+  void propertiesRetrieved(const QDBusObjectPath&, const QString&, const QVariantMap&);
+  void attributesRetrieved(const QDBusObjectPath&, const SmartAttributesList&);
+  void powerStateRetrieved(const QDBusObjectPath&, bool);
+  void updateFinished(const QDBusObjectPath&, const QStringList&, bool);
 
 signals:
   void storageUnitAdded(StorageUnit*);
   void storageUnitRemoved(StorageUnit*);
+  void storageUnitsRefreshed();
 
 
 public slots:
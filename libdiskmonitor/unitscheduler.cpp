@@ -0,0 +1,261 @@
+/****************************************************************************
+ * DisKMonitor, KDE tools to monitor SMART and MDRaid health status         *
+ * Copyright (C) 2014-2015 Michaël Lhomme <papylhomme@gmail.com>            *
+ *                                                                          *
+ * This program is free software; you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation; either version 2 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License along  *
+ * with this program; if not, write to the Free Software Foundation, Inc.,  *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.              *
+ ****************************************************************************/
+
+
+#include "unitscheduler.h"
+
+#include "udisks2wrapper.h"
+
+#include <QDateTime>
+#include <QDebug>
+
+#include <limits>
+
+
+
+/*
+ * Constructor. Follow the units of the wrapper, the polling being started by start()
+ *
+ * @param udisks2 The wrapper providing the units
+ */
+UnitScheduler::UnitScheduler(UDisks2Wrapper* udisks2) : QObject()
+{
+  this -> udisks2 = udisks2;
+
+  timer.setSingleShot(true);
+  connect(&timer, SIGNAL(timeout()), this, SLOT(wakeup()));
+
+  connect(udisks2, SIGNAL(storageUnitAdded(StorageUnit*)), this, SLOT(storageUnitAdded(StorageUnit*)));
+  connect(udisks2, SIGNAL(storageUnitRemoved(StorageUnit*)), this, SLOT(storageUnitRemoved(StorageUnit*)));
+}
+
+
+
+/*
+ * Destructor
+ */
+UnitScheduler::~UnitScheduler()
+{
+
+}
+
+
+
+/*
+ * Start polling the units
+ */
+void UnitScheduler::start()
+{
+  if(active)
+    return;
+
+  active = true;
+  foreach(StorageUnit* unit, udisks2 -> listStorageUnits()) {
+    if(!schedules.contains(unit))
+      storageUnitAdded(unit);
+    else
+      schedule(unit);
+  }
+
+  arm();
+}
+
+
+
+/*
+ * Stop polling the units
+ */
+void UnitScheduler::stop()
+{
+  active = false;
+  timer.stop();
+}
+
+
+
+/*
+ * Test if the units are being polled
+ */
+bool UnitScheduler::isActive() const
+{
+  return active;
+}
+
+
+
+/*
+ * Get the polling interval of the idle and healthy units, in milliseconds
+ */
+int UnitScheduler::getSlowInterval() const
+{
+  return slowInterval;
+}
+
+
+
+/*
+ * Set the polling interval of the idle and healthy units
+ *
+ * @param msecs The interval in milliseconds
+ */
+void UnitScheduler::setSlowInterval(int msecs)
+{
+  slowInterval = msecs;
+
+  foreach(StorageUnit* unit, schedules.keys())
+    schedule(unit);
+
+  arm();
+}
+
+
+
+/*
+ * Get the polling interval of a unit according to its state. The progress of
+ * an operation tracked by a UDisks2 job is notified by the job's signals, such
+ * unit doesn't need the fast interval
+ *
+ * @param unit The unit
+ * @return The interval in milliseconds
+ */
+int UnitScheduler::getInterval(const StorageUnit* unit) const
+{
+  if(unit -> isOperationRunning() && !unit -> hasJob())
+    return SCHEDULER_FAST_INTERVAL;
+
+  qint64 sinceChange = QDateTime::currentMSecsSinceEpoch() - unit -> getLastChangeTime();
+  if(unit -> isFailing() || sinceChange < SCHEDULER_RECENT_CHANGE)
+    return qMin(SCHEDULER_MEDIUM_INTERVAL, slowInterval);
+
+  return slowInterval;
+}
+
+
+
+/*
+ * Get the number of timer wakeups since the creation of the scheduler
+ */
+quint64 UnitScheduler::getWakeupCount() const
+{
+  return wakeups;
+}
+
+
+
+/*
+ * Compute the next poll of a unit from now
+ *
+ * @param unit The unit
+ */
+void UnitScheduler::schedule(StorageUnit* unit)
+{
+  int interval = getInterval(unit);
+
+  Schedule& s = schedules[unit];
+  s.due = QDateTime::currentMSecsSinceEpoch() + interval;
+  s.earliest = s.due - (qint64) (interval * SCHEDULER_SLACK);
+}
+
+
+
+/*
+ * Arm the timer for the first due unit
+ */
+void UnitScheduler::arm()
+{
+  if(!active || schedules.isEmpty()) {
+    timer.stop();
+    return;
+  }
+
+  qint64 next = std::numeric_limits<qint64>::max();
+  foreach(const Schedule& s, schedules)
+    next = qMin(next, s.due);
+
+  timer.start(qMax((qint64) 0, next - QDateTime::currentMSecsSinceEpoch()));
+}
+
+
+
+/*
+ * Refresh in a single cycle every unit within its slack, then rearm the timer
+ */
+void UnitScheduler::wakeup()
+{
+  qint64 now = QDateTime::currentMSecsSinceEpoch();
+  wakeups++;
+
+  QList<StorageUnit*> due;
+  foreach(StorageUnit* unit, schedules.keys()) {
+    if(schedules[unit].earliest <= now)
+      due << unit;
+  }
+
+  //provisional schedule, replaced when the update completes
+  foreach(StorageUnit* unit, due)
+    schedule(unit);
+
+  if(!due.isEmpty())
+    udisks2 -> refreshStorageUnits(due);
+
+  arm();
+}
+
+
+
+/*
+ * Schedule a new unit
+ *
+ * @param unit The new unit
+ */
+void UnitScheduler::storageUnitAdded(StorageUnit* unit)
+{
+  connect(unit, SIGNAL(updated(StorageUnit*)), this, SLOT(storageUnitUpdated(StorageUnit*)));
+
+  schedule(unit);
+  arm();
+}
+
+
+
+/*
+ * Forget a removed unit
+ *
+ * @param unit The removed unit
+ */
+void UnitScheduler::storageUnitRemoved(StorageUnit* unit)
+{
+  disconnect(unit, SIGNAL(updated(StorageUnit*)), this, SLOT(storageUnitUpdated(StorageUnit*)));
+
+  schedules.remove(unit);
+  arm();
+}
+
+
+
+/*
+ * Reschedule an updated unit according to its new state
+ *
+ * @param unit The updated unit
+ */
+void UnitScheduler::storageUnitUpdated(StorageUnit* unit)
+{
+  schedule(unit);
+  arm();
+}
@@ -0,0 +1,106 @@
+/****************************************************************************
+ * DisKMonitor, KDE tools to monitor SMART and MDRaid health status         *
+ * Copyright (C) 2014-2015 Michaël Lhomme <papylhomme@gmail.com>            *
+ *                                                                          *
+ * This program is free software; you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation; either version 2 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License along  *
+ * with this program; if not, write to the Free Software Foundation, Inc.,  *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.              *
+ ****************************************************************************/
+
+
+#ifndef UNITSCHEDULER_H
+#define UNITSCHEDULER_H
+
+#include <QObject>
+#include <QHash>
+#include <QTimer>
+
+#include "storageunit.h"
+
+
+
+//polling intervals of the scheduler, in milliseconds
+#define SCHEDULER_FAST_INTERVAL 1000
+#define SCHEDULER_MEDIUM_INTERVAL 60000
+#define SCHEDULER_DEFAULT_SLOW_INTERVAL 300000
+
+//duration during which a unit is considered recently changed, in milliseconds
+#define SCHEDULER_RECENT_CHANGE 600000
+
+//fraction of its interval by which a unit may be polled early, to share a wakeup
+#define SCHEDULER_SLACK 0.25
+
+
+class UDisks2Wrapper;
+
+
+/*
+ * Central polling scheduler of the storage units
+ *
+ * Each unit is polled at its own interval, depending on its state: fast while an
+ * operation runs, medium when failing or recently changed, slow otherwise. Units are
+ * rescheduled on each update, whatever its origin. A single timer serves every unit,
+ * waking up for the first due unit and refreshing with it all the units allowed
+ * to be polled early (see SCHEDULER_SLACK) in one refresh cycle
+ */
+class UnitScheduler : public QObject
+{
+  Q_OBJECT
+
+public:
+  explicit UnitScheduler(UDisks2Wrapper* udisks2);
+  ~UnitScheduler() override;
+
+  void start();
+  void stop();
+  bool isActive() const;
+
+  int getSlowInterval() const;
+  void setSlowInterval(int msecs);
+
+  int getInterval(const StorageUnit* unit) const;
+
+  quint64 getWakeupCount() const;
+
+
+private:
+
+  /*
+   * Polling schedule of a unit, in milliseconds since epoch
+   */
+  struct Schedule {
+    qint64 due;
+    qint64 earliest;
+  };
+
+  UDisks2Wrapper* udisks2;
+  QTimer timer;
+
+  bool active = false;
+  int slowInterval = SCHEDULER_DEFAULT_SLOW_INTERVAL;
+  quint64 wakeups = 0;
+
+  QHash<StorageUnit*, Schedule> schedules;
+
+  void schedule(StorageUnit* unit);
+  void arm();
+
+
+private slots:
+  void storageUnitAdded(StorageUnit* unit);
+  void storageUnitRemoved(StorageUnit* unit);
+  void storageUnitUpdated(StorageUnit* unit);
+  void wakeup();
+};
+
+#endif // UNITSCHEDULER_H
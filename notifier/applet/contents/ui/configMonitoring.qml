@@ -30,6 +30,7 @@ Item {
 
   property alias cfg_refreshTimeout: refreshTimeout.value
   property alias cfg_notifyEnabled: notifyEnabled.checked
+  property alias cfg_callTimeout: callTimeout.value
 
   ColumnLayout {
     anchors.left: parent.left
@@ -62,6 +63,21 @@ Item {
           }
         }
 
+        RowLayout {
+          PlasmaComponents.Label {
+            text: i18n("Drive response timeout")
+          }
+
+
+          QtControls.SpinBox {
+            id: callTimeout
+            minimumValue: 1
+            maximumValue: 120
+            suffix: i18nc("abbreviation for seconds", " s.")
+            horizontalAlignment: Qt.AlignRight
+          }
+        }
+
         QtControls.CheckBox {
           id: notifyEnabled
           text: i18n("Notify health status change")
@@ -74,6 +90,7 @@ Item {
   Component.onCompleted: {
     refreshTimeout.value = plasmoid.configuration.refreshTimeout;
     notifyEnabled.checked = plasmoid.configuration.notifyEnabled;
+    callTimeout.value = plasmoid.configuration.callTimeout;
   }
 
 }
@@ -47,6 +47,7 @@ Item {
     id: myStorageModel
     refreshTimeout: plasmoid.configuration.refreshTimeout
     notifyEnabled: plasmoid.configuration.notifyEnabled
+    callTimeout: plasmoid.configuration.callTimeout
 
     iconHealthy: iconProvider.healthy;
     iconFailing: iconProvider.failing;
@@ -27,24 +27,32 @@
 
 
 #include "udisks2wrapper.h"
+#include "unitscheduler.h"
+#include "daemonclient.h"
+#include "healthruleengine.h"
+#include "diskmonitor_settings.h"
+#include "diskmonitor_debug.h"
+#include "tracer.h"
 
 
 
 
 /*
- * Constructor
+ * Constructor. Use diskmonitord if it is running, sharing its polling with the other
+ * clients, or poll the units with the local UDisks2Wrapper
  */
 StorageUnitQmlModel::StorageUnitQmlModel()
 {
-  UDisks2Wrapper* udisks2 = UDisks2Wrapper::instance();
-  connect(udisks2, SIGNAL(storageUnitAdded(StorageUnit*)), this, SLOT(storageUnitAdded(StorageUnit*)));
-  connect(udisks2, SIGNAL(storageUnitRemoved(StorageUnit*)), this, SLOT(storageUnitRemoved(StorageUnit*)));
+  if(DaemonClient::isDaemonRunning()) {
+    qCDebug(DISKMONITOR_MODEL) << "StorageUnitQmlModel: using diskmonitord";
 
-  storageUnits = udisks2 -> listStorageUnits();
+    client = new DaemonClient(this);
+    connect(client, SIGNAL(daemonLost()), this, SLOT(daemonLost()));
+    useSource(client, client -> listStorageUnits());
 
-  timer = new QTimer();
-  connect(timer, SIGNAL(timeout()), this, SLOT(monitor()));
-  timer -> start(timeout * 60 * 1000);
+  } else {
+    useLocalPolling();
+  }
 
   //delay the fist monitor in order to let the applet
   //configure its value (mainly notifyEnabled)
@@ -53,15 +61,99 @@ StorageUnitQmlModel::StorageUnitQmlModel()
 
 
 
+/*
+ * Poll the units with the local UDisks2Wrapper
+ */
+void StorageUnitQmlModel::useLocalPolling()
+{
+  loadRules();
+
+  UDisks2Wrapper* udisks2 = UDisks2Wrapper::instance();
+  udisks2 -> setCallTimeout(calltimeout * 1000);
+  useSource(udisks2, udisks2 -> listStorageUnits());
+
+  //units are then polled by the scheduler, at an interval depending on their state
+  udisks2 -> getScheduler() -> setSlowInterval(timeout * 60 * 1000);
+  udisks2 -> getScheduler() -> start();
+}
+
+
+
+/*
+ * Apply the health rules of the application settings to the units polled locally,
+ * the units of diskmonitord being evaluated with the rules given to the daemon.
+ * The settings are read again to follow the changes made in the application
+ */
+void StorageUnitQmlModel::loadRules()
+{
+  DiskMonitorSettings::self() -> load();
+  HealthRuleEngine::instance() -> setRules(DiskMonitorSettings::failingRule(), DiskMonitorSettings::warningRule());
+}
+
+
+
+/*
+ * Follow the units of the given source, the DaemonClient or the UDisks2Wrapper
+ *
+ * @param source The source, notifying the added and removed units and the refresh cycles
+ * @param units The units currently listed by the source
+ */
+void StorageUnitQmlModel::useSource(QObject* source, const QList<StorageUnit*>& units)
+{
+  connect(source, SIGNAL(storageUnitAdded(StorageUnit*)), this, SLOT(storageUnitAdded(StorageUnit*)));
+  connect(source, SIGNAL(storageUnitRemoved(StorageUnit*)), this, SLOT(storageUnitRemoved(StorageUnit*)));
+  connect(source, SIGNAL(storageUnitsRefreshed()), this, SLOT(storageUnitsRefreshed()));
+
+  //the list may be empty at this point, units are then added asynchronously
+  storageUnits = units;
+  foreach(StorageUnit* unit, storageUnits) {
+    rowStates.append(rowState(unit));
+    connect(unit, SIGNAL(updated(StorageUnit*)), this, SLOT(storageUnitUpdated(StorageUnit*)));
+  }
+
+  unprocessedUnits = storageUnits;
+}
+
+
+
+/*
+ * Handle the exit of diskmonitord, replacing its units by the ones of the
+ * local wrapper and refreshing them at once
+ */
+void StorageUnitQmlModel::daemonLost()
+{
+  qCWarning(DISKMONITOR_MODEL) << "StorageUnitQmlModel: diskmonitord stopped, polling the units locally";
+
+  beginResetModel();
+
+  foreach(StorageUnit* unit, storageUnits)
+    disconnect(unit, SIGNAL(updated(StorageUnit*)), this, SLOT(storageUnitUpdated(StorageUnit*)));
+
+  storageUnits.clear();
+  rowStates.clear();
+  unprocessedUnits.clear();
+  failingUnits.clear();
+
+  client -> disconnect(this);
+  client -> deleteLater();
+  client = nullptr;
+
+  useLocalPolling();
+
+  endResetModel();
+
+  //the status is kept until the local units are tested, at the end of the refresh
+  monitor();
+}
+
+
+
 /*
  * Destructor
  */
 StorageUnitQmlModel::~StorageUnitQmlModel()
 {
-  timer -> stop();
-  delete timer;
-
-  qDebug() << "StorageUnitQmlModel destructed !";
+  qCDebug(DISKMONITOR_MODEL) << "StorageUnitQmlModel destructed !";
 }
 
 
@@ -87,7 +179,7 @@ QString StorageUnitQmlModel::status() const
     QString details;
 
     foreach(StorageUnit* unit, failingUnits)
-      details = "<br/><i>" + unit -> getName() + " (" + unit -> getDevice() + ")</i>";
+      details += "<br/><i>" + unit -> getName() + " (" + unit -> getDevice() + ")</i>";
 
     return i18n("The following storage units are in failing state:<br/>%1", details);
   }
@@ -96,7 +188,8 @@ QString StorageUnitQmlModel::status() const
 
 
 /*
- * Get the refresh timeout value
+ * Get the refresh timeout value, the polling interval in minutes of the idle and healthy units.
+ * Not used with diskmonitord, which has its own polling interval
  */
 int StorageUnitQmlModel::refreshTimeout() const
 {
@@ -111,8 +204,10 @@ int StorageUnitQmlModel::refreshTimeout() const
  */
 void StorageUnitQmlModel::setRefreshTimeout(int timeout) {
   this -> timeout = timeout;
-  this -> timer -> stop();
-  this -> timer -> start(timeout * 60 * 1000);
+
+  if(client == nullptr)
+    UDisks2Wrapper::instance() -> getScheduler() -> setSlowInterval(timeout * 60 * 1000);
+
   emit refreshTimeoutChanged(timeout);
 }
 
@@ -137,6 +232,30 @@ void StorageUnitQmlModel::setNotifyEnabled(bool notify) {
 
 
 
+/*
+ * Get the deadline of the UDisks2 calls, in seconds
+ */
+int StorageUnitQmlModel::callTimeout() const
+{
+  return calltimeout;
+}
+
+
+
+/*
+ * Set the deadline of the UDisks2 calls, in seconds. Not used
+ * with diskmonitord, which has its own deadline
+ */
+void StorageUnitQmlModel::setCallTimeout(int timeout)
+{
+  this -> calltimeout = timeout;
+
+  if(client == nullptr)
+    UDisks2Wrapper::instance() -> setCallTimeout(timeout * 1000);
+}
+
+
+
 /*
  * Get the iconHealthy value
  */
@@ -235,7 +354,7 @@ QString StorageUnitQmlModel::getIconForUnit(StorageUnit* unit) const
   QString icon;
   if(unit -> isMDRaid())
     icon = "drive-harddisk";
-  else if(unit -> isDrive() && static_cast<Drive*>(unit) -> isRemovable())
+  else if(unit -> isRemovable())
     icon = "drive-removable-media";
   else
     icon = "drive-harddisk";
@@ -245,6 +364,61 @@ QString StorageUnitQmlModel::getIconForUnit(StorageUnit* unit) const
 
 
 
+/*
+ * Get the values of the roles displayed for the given StorageUnit
+ */
+StorageUnitQmlModel::RowState StorageUnitQmlModel::rowState(StorageUnit* unit) const
+{
+  RowState state;
+  state.name = unit -> getShortName();
+  state.icon = getIconForUnit(unit);
+  state.device = unit -> getDevice();
+  state.failing = unit -> isFailing();
+  state.failingKnown = unit -> isFailingStatusKnown();
+
+  return state;
+}
+
+
+
+/*
+ * Compare the displayed roles of a row with its unit, notifying the changed ones
+ *
+ * The delegates of the applet are only updated for the roles which really
+ * changed, an unchanged row costing nothing
+ *
+ * @param row The row to update
+ * @return true if the failing status of the unit changed
+ */
+bool StorageUnitQmlModel::updateRow(int row)
+{
+  RowState& old = rowStates[row];
+  RowState state = rowState(storageUnits.at(row));
+
+  QVector<int> roles;
+  if(state.name != old.name)
+    roles << NameRole;
+  if(state.icon != old.icon)
+    roles << IconRole;
+  if(state.device != old.device)
+    roles << DeviceRole;
+  if(state.failing != old.failing)
+    roles << FailingRole;
+  if(state.failingKnown != old.failingKnown)
+    roles << FailingKnownRole;
+
+  if(roles.isEmpty())
+    return false;
+
+  bool failingChanged = state.failing != old.failing;
+  old = state;
+
+  emit dataChanged(index(row), index(row), roles);
+  return failingChanged;
+}
+
+
+
 /*
  * Handle StorageUnit added
  */
@@ -254,10 +428,13 @@ void StorageUnitQmlModel::storageUnitAdded(StorageUnit* unit)
 
   beginInsertRows(QModelIndex(), idx, idx);
   storageUnits.append(unit);
+  rowStates.append(rowState(unit));
   endInsertRows();
 
+  connect(unit, SIGNAL(updated(StorageUnit*)), this, SLOT(storageUnitUpdated(StorageUnit*)));
+
   //refresh the status with the new unit
-  processUnit(unit);
+  processUnits(QList<StorageUnit*>() << unit);
 }
 
 
@@ -268,80 +445,154 @@ void StorageUnitQmlModel::storageUnitAdded(StorageUnit* unit)
 void StorageUnitQmlModel::storageUnitRemoved(StorageUnit* unit)
 {
   int idx = storageUnits.indexOf(unit);
+  if(idx < 0)
+    return;
+
+  disconnect(unit, SIGNAL(updated(StorageUnit*)), this, SLOT(storageUnitUpdated(StorageUnit*)));
+  unprocessedUnits.removeOne(unit);
 
   beginRemoveRows(QModelIndex(), idx, idx);
   storageUnits.removeAt(idx);
+  rowStates.removeAt(idx);
   endRemoveRows();
 
-  //refresh status for the remaining units
-  processUnits(storageUnits);
+  //refresh status without the removed unit
+  if(failingUnits.removeOne(unit))
+    updateStatus();
 }
 
 
 
 /*
- * Monitor entry point ; list available StorageUnits and test them
- * for problems
+ * Handle StorageUnit updated outside of a refresh cycle, like a change notified by UDisks2
+ */
+void StorageUnitQmlModel::storageUnitUpdated(StorageUnit* unit)
+{
+  //handled at the end of the refresh cycle
+  if(isRefreshing())
+    return;
+
+  int idx = storageUnits.indexOf(unit);
+  if(idx < 0)
+    return;
+
+  if(updateRow(idx))
+    processUnits(QList<StorageUnit*>() << unit);
+}
+
+
+
+/*
+ * Monitor entry point ; refresh the available StorageUnits, tested for
+ * problems by StorageUnitQmlModel::storageUnitsRefreshed() at the end of the cycle
  */
 void StorageUnitQmlModel::monitor() {
-  qDebug() << "StorageUnitQmlModel::monitor (" << UDisks2Wrapper::instance() << ")";
+  qCDebug(DISKMONITOR_MODEL) << "StorageUnitQmlModel::monitor (" << (client != nullptr ? "diskmonitord" : "local") << ")";
 
-  beginResetModel();
-  foreach(StorageUnit* unit, storageUnits) {
-    unit -> update();
+  if(client != nullptr) {
+    client -> refreshStorageUnits();
+  } else {
+    loadRules();
+    UDisks2Wrapper::instance() -> refreshStorageUnits();
   }
-  endResetModel();
+}
+
+
 
-  processUnits(storageUnits);
+/*
+ * Test if a refresh cycle is running, on the daemon or the local wrapper
+ */
+bool StorageUnitQmlModel::isRefreshing() const
+{
+  if(client != nullptr)
+    return client -> isRefreshing();
+
+  return UDisks2Wrapper::instance() -> isRefreshing();
 }
 
 
 
 /*
- * Convenience wrapper around StorageUnitQmlModel::processUnits()
+ * Handle the end of a refresh cycle, notifying the changed rows and
+ * updating the global status with the units whose failing status changed
  */
-void StorageUnitQmlModel::processUnit(StorageUnit* unit)
+void StorageUnitQmlModel::storageUnitsRefreshed()
 {
-  QList<StorageUnit*> units;
-  units << unit;
-  processUnits(units);
+  TRACE_SCOPE("model", "StorageUnitQmlModel::storageUnitsRefreshed");
+
+  QList<StorageUnit*> changed = unprocessedUnits;
+  unprocessedUnits.clear();
+
+  for(int i = 0; i < storageUnits.size(); i++) {
+    if(updateRow(i))
+      changed << storageUnits.at(i);
+  }
+
+  processUnits(changed);
+
+  //status left over by the units of diskmonitord after its exit
+  if(hasFailing == failingUnits.isEmpty())
+    updateStatus();
 }
 
 
 
 /*
- * Update the current general health status with the given storage units
+ * Update the set of failing units with the given units, whose
+ * failing status may have changed, and the general health status
  */
 void StorageUnitQmlModel::processUnits(const QList<StorageUnit*>& units)
 {
-  bool localFailing = false;
-  failingUnits.clear();
+  bool changed = false;
 
-  //test each unit
   foreach(StorageUnit* unit, units) {
-    if(unit -> isFailing()) {
-      localFailing = true;
+    bool listed = failingUnits.contains(unit);
+
+    if(unit -> isFailing() && !listed) {
       failingUnits << unit;
+      changed = true;
+    } else if(!unit -> isFailing() && listed) {
+      failingUnits.removeOne(unit);
+      changed = true;
     }
   }
 
+  if(changed)
+    updateStatus();
+}
+
 
-  //Status changed, notify the user
-  if(hasFailing != localFailing) {
-    qDebug() << "StorageMonitor: Changing failing status to " << localFailing;
-    hasFailing = localFailing;
-    emit statusChanged();
 
-    if(notifyEnabled())
-      KNotification::event(hasFailing ? "failing" : "healthy",
-                           hasFailing ? i18n("Storage units failing") : i18n("Storage units are back to healthy status"),
-                           status(),
-                           hasFailing ? iconFailing() : iconHealthy(),
-                           nullptr,
-                           KNotification::Persistent,
-                           "diskmonitor"
-                           );
+/*
+ * Update the general health status from the set of failing units,
+ * notifying the user when it changes
+ */
+void StorageUnitQmlModel::updateStatus()
+{
+  bool localFailing = !failingUnits.isEmpty();
+
+  //the list of failing units changed, not the status
+  if(hasFailing == localFailing) {
+    emit statusChanged();
+    return;
   }
+
+  //Status changed, notify the user
+  qCDebug(DISKMONITOR_MODEL) << "StorageMonitor: Changing failing status to " << localFailing;
+  hasFailing = localFailing;
+  emit statusChanged();
+
+  TRACE_SCOPE("notification", "KNotification::event");
+
+  if(notifyEnabled())
+    KNotification::event(hasFailing ? "failing" : "healthy",
+                         hasFailing ? i18n("Storage units failing") : i18n("Storage units are back to healthy status"),
+                         status(),
+                         hasFailing ? iconFailing() : iconHealthy(),
+                         nullptr,
+                         KNotification::Persistent,
+                         "diskmonitor"
+                         );
 }
 
 
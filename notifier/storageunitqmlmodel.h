@@ -25,6 +25,9 @@
 #include <QTimer>
 
 #include "storageunit.h"
+#include "udisks2wrapper.h"
+
+class DaemonClient;
 
 
 
@@ -41,6 +44,7 @@ class StorageUnitQmlModel : public QAbstractListModel
   Q_PROPERTY(QString status READ status NOTIFY statusChanged)
   Q_PROPERTY(int refreshTimeout READ refreshTimeout WRITE setRefreshTimeout NOTIFY refreshTimeoutChanged)
   Q_PROPERTY(bool notifyEnabled READ notifyEnabled WRITE setNotifyEnabled)
+  Q_PROPERTY(int callTimeout READ callTimeout WRITE setCallTimeout)
   Q_PROPERTY(QString iconHealthy READ iconHealthy WRITE setIconHealthy)
   Q_PROPERTY(QString iconFailing READ iconFailing WRITE setIconFailing)
 
@@ -66,6 +70,9 @@ public:
   bool notifyEnabled() const;
   void setNotifyEnabled(bool notify);
 
+  int callTimeout() const;
+  void setCallTimeout(int timeout);
+
   QString iconHealthy() const;
   QString iconFailing() const;
   void setIconHealthy(QString healthyIcon);
@@ -76,13 +83,33 @@ public:
   QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const override;
 
 private:
+
+  /*
+   * Values of the roles displayed by a row, compared to the ones of
+   * the updated unit to notify only the changed roles
+   */
+  struct RowState {
+    QString name;
+    QString icon;
+    QString device;
+    bool failing;
+    bool failingKnown;
+  };
+
   QList<StorageUnit*> storageUnits;
+  QList<RowState> rowStates;
+
+  //client of diskmonitord when the daemon is running, the units being polled locally otherwise
+  DaemonClient* client = nullptr;
 
   bool hasFailing = false;
   QList<StorageUnit*> failingUnits;
 
+  //units listed on construction, tested at the end of the first refresh cycle
+  QList<StorageUnit*> unprocessedUnits;
+
   int timeout = 5;
-  QTimer* timer;
+  int calltimeout = UDISKS2_DEFAULT_CALL_TIMEOUT / 1000;
 
   bool notify = false;
 
@@ -90,14 +117,23 @@ private:
   QString failingICon;
 
 
-  void processUnit(StorageUnit* unit);
+  void useLocalPolling();
+  void loadRules();
+  void useSource(QObject* source, const QList<StorageUnit*>& units);
+  bool isRefreshing() const;
+  RowState rowState(StorageUnit* unit) const;
+  bool updateRow(int row);
   void processUnits(const QList<StorageUnit*> & units);
+  void updateStatus();
   QString getIconForUnit(StorageUnit* unit) const;
 
 private slots:
   void storageUnitAdded(StorageUnit* drive);
   void storageUnitRemoved(StorageUnit* path);
+  void storageUnitUpdated(StorageUnit* unit);
+  void storageUnitsRefreshed();
   void monitor();
+  void daemonLost();
 
 signals:
   void statusChanged();
@@ -0,0 +1,1043 @@
+/****************************************************************************
+ * DisKMonitor, KDE tools to monitor SMART and MDRaid health status         *
+ * Copyright (C) 2014-2015 Michaël Lhomme <papylhomme@gmail.com>            *
+ *                                                                          *
+ * This program is free software; you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation; either version 2 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License along  *
+ * with this program; if not, write to the Free Software Foundation, Inc.,  *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.              *
+ ****************************************************************************/
+
+
+
+#include <QtTest>
+#include <QDBusServer>
+#include <QDBusConnection>
+#include <QDBusMessage>
+
+#include <random>
+
+#include "udisks2wrapper.h"
+#include "drive.h"
+#include "mdraid.h"
+
+#include "storageunitmodel.h"
+#include "drivepropertiesmodel.h"
+#include "storageunitqmlmodel.h"
+#include "smarthealthevaluator.h"
+#include "healthruleengine.h"
+#include "historystore.h"
+
+
+
+//number of SMART attributes of the benchmarked drives, a typical full table
+#define BENCH_SMART_ATTRIBUTES 30
+
+//members of the benchmarked raids
+#define BENCH_RAID_MEMBERS 8
+
+//DBus call budget of a steady state refresh: PmGetState and the GetAll of the DRIVE
+//and ATA interfaces for a drive, the GetAll of the MDRAID interface for a raid
+#define BUDGET_DRIVE_REFRESH 3
+#define BUDGET_RAID_REFRESH 1
+
+//deadline of a refresh cycle in the budget checks, in milliseconds
+#define BUDGET_REFRESH_DEADLINE 30000
+
+
+
+/*
+ * Give access to the cached attributes of a drive
+ */
+class BenchDrive : public Drive
+{
+public:
+  BenchDrive(const QDBusObjectPath& objectPath, const InterfaceList& interfaces) :
+    Drive(objectPath, "/dev/bench", interfaces) { }
+
+  void setAttributes(const SmartAttributesList& attributes)
+  {
+    setSMARTAttributes(attributes);
+  }
+};
+
+
+
+/*
+ * Object exported on the peer connection, returning the marshalled UDisks2 types
+ */
+class BenchEcho : public QObject
+{
+  Q_OBJECT
+
+public:
+  SmartAttributesList attributes;
+  MDRaidMemberList members;
+
+public slots:
+  SmartAttributesList smartAttributes() { return attributes; }
+  MDRaidMemberList raidMembers() { return members; }
+};
+
+
+
+/*
+ * Benchmarks of the libdiskmonitor hot paths
+ *
+ * The units are fed in-process, as the wrapper receives them from UDisks2, the units
+ * of the bus being never listed. The DBus calls of the refreshes go to the bus carrying
+ * UDisks2, the mock service of tools/mockudisks2 on a private bus for the call budget
+ * test (see tools/bench/CMakeLists.txt). The demarshallers are measured on arguments
+ * received once through a private peer to peer connection
+ */
+class LibDiskMonitorBench : public QObject
+{
+  Q_OBJECT
+
+private:
+  QDBusServer* server = nullptr;
+  BenchEcho echo;
+
+  static InterfaceList driveInterfaces(int index);
+  static InterfaceList raidInterfaces(int index);
+  static ManagedObjectList managedObjects(int drives, int raids);
+  static SmartAttributesList smartAttributes();
+  static MDRaidMemberList raidMembers();
+  static QStringList historySeries();
+  static qint64 encodeHistorySeries(const QString& series, QVector<HistorySample>& samples,
+                                    QList<QByteArray>& blocks, QList<int>& counts);
+
+  QDBusArgument receive(const QString& method);
+  void populateWrapper(int drives, int raids);
+
+private slots:
+  void initTestCase();
+  void cleanupTestCase();
+
+  void enumeration_data();
+  void enumeration();
+
+  void driveUpdate();
+  void mdraidUpdate();
+
+  void demarshallSmartAttributes();
+  void demarshallMDRaidMembers();
+
+  void attributeTableScan_data();
+  void attributeTableScan();
+  void fleetHealth_data();
+  void fleetHealth();
+  void healthRuleEvaluation_data();
+  void healthRuleEvaluation();
+  void historyAppend();
+  void historyRead();
+  void historyCompression_data();
+  void historyCompression();
+  void historyCompressionRatio_data();
+  void historyCompressionRatio();
+
+  void storageUnitModelData_data();
+  void storageUnitModelData();
+
+  void drivePropertiesModelData();
+  void drivePropertiesModelUpdate();
+
+  void qmlModelMonitor_data();
+  void qmlModelMonitor();
+  void qmlModelRefreshed_data();
+  void qmlModelRefreshed();
+
+  void callBudget_data();
+  void callBudget();
+
+  void serverConnection(const QDBusConnection& connection);
+};
+
+
+
+/*
+ * Node properties of a drive, as listed by UDisks2 ObjectManager
+ */
+InterfaceList LibDiskMonitorBench::driveInterfaces(int index)
+{
+  InterfaceList interfaces;
+
+  interfaces[UDISKS2_DRIVE_IFACE]["Model"] = QString("Bench Drive %1").arg(index);
+  interfaces[UDISKS2_DRIVE_IFACE]["Removable"] = index % 10 == 9;
+
+  interfaces[UDISKS2_ATA_IFACE]["SmartSupported"] = true;
+  interfaces[UDISKS2_ATA_IFACE]["SmartEnabled"] = true;
+  interfaces[UDISKS2_ATA_IFACE]["SmartFailing"] = false;
+  interfaces[UDISKS2_ATA_IFACE]["SmartUpdated"] = (qulonglong) 1;
+  interfaces[UDISKS2_ATA_IFACE]["SmartSelftestStatus"] = QString("success");
+  interfaces[UDISKS2_ATA_IFACE]["SmartSelftestPercentRemaining"] = 0;
+  interfaces[UDISKS2_ATA_IFACE]["PmSupported"] = true;
+
+  return interfaces;
+}
+
+
+
+/*
+ * Node properties of a raid, as listed by UDisks2 ObjectManager
+ */
+InterfaceList LibDiskMonitorBench::raidInterfaces(int index)
+{
+  InterfaceList interfaces;
+
+  interfaces[UDISKS2_MDRAID_IFACE]["UUID"] = QString("bench-%1").arg(index);
+  interfaces[UDISKS2_MDRAID_IFACE]["Level"] = QString("raid1");
+  interfaces[UDISKS2_MDRAID_IFACE]["NumDevices"] = (uint) BENCH_RAID_MEMBERS;
+  interfaces[UDISKS2_MDRAID_IFACE]["SyncAction"] = QString("idle");
+  interfaces[UDISKS2_MDRAID_IFACE]["Degraded"] = (uint) 0;
+
+  return interfaces;
+}
+
+
+
+/*
+ * Content of the GetManagedObjects reply for the given number of units
+ */
+ManagedObjectList LibDiskMonitorBench::managedObjects(int drives, int raids)
+{
+  ManagedObjectList objects;
+
+  for(int i = 0; i < drives; i++) {
+    QDBusObjectPath drivePath(QString(UDISKS2_DRIVES_PATH "/BenchDrive_%1").arg(i));
+    objects[drivePath] = driveInterfaces(i);
+
+    QDBusObjectPath blockPath(QString(UDISKS2_BLOCK_DEVICES_PATH "/bench%1").arg(i));
+    objects[blockPath][UDISKS2_BLOCK_IFACE]["Device"] = QString("/dev/bench%1").arg(i);
+    objects[blockPath][UDISKS2_BLOCK_IFACE]["Drive"] = QVariant::fromValue(drivePath);
+    objects[blockPath][UDISKS2_BLOCK_IFACE]["MDRaid"] = QVariant::fromValue(QDBusObjectPath("/"));
+  }
+
+  for(int i = 0; i < raids; i++) {
+    QDBusObjectPath raidPath(QString(UDISKS2_MDRAIDS_PATH "/BenchRaid_%1").arg(i));
+    objects[raidPath] = raidInterfaces(i);
+
+    QDBusObjectPath blockPath(QString(UDISKS2_BLOCK_DEVICES_PATH "/md%1").arg(i));
+    objects[blockPath][UDISKS2_BLOCK_IFACE]["Device"] = QString("/dev/md%1").arg(i);
+    objects[blockPath][UDISKS2_BLOCK_IFACE]["Drive"] = QVariant::fromValue(QDBusObjectPath("/"));
+    objects[blockPath][UDISKS2_BLOCK_IFACE]["MDRaid"] = QVariant::fromValue(raidPath);
+  }
+
+  return objects;
+}
+
+
+
+/*
+ * A full SMART attribute table
+ */
+SmartAttributesList LibDiskMonitorBench::smartAttributes()
+{
+  SmartAttributesList attributes;
+
+  for(int i = 0; i < BENCH_SMART_ATTRIBUTES; i++) {
+    SmartAttribute a;
+    a.id = i + 1;
+    a.name = QString("bench-attribute-%1").arg(i);
+    a.flags = 0x0032;
+    a.value = 100;
+    a.worst = 90;
+    a.threshold = 10;
+    a.pretty = i * 1000;
+    a.pretty_unit = i % 5;
+    attributes << a;
+  }
+
+  return attributes;
+}
+
+
+
+/*
+ * Members of a raid array
+ */
+MDRaidMemberList LibDiskMonitorBench::raidMembers()
+{
+  MDRaidMemberList members;
+
+  for(int i = 0; i < BENCH_RAID_MEMBERS; i++) {
+    MDRaidMember m;
+    m.block = QDBusObjectPath(QString(UDISKS2_BLOCK_DEVICES_PATH "/bench%1").arg(i));
+    m.slot = i;
+    m.state << "in_sync";
+    m.numReadErrors = 0;
+    members << m;
+  }
+
+  return members;
+}
+
+
+
+/*
+ * Start the private peer to peer connection and the wrapper
+ */
+void LibDiskMonitorBench::initTestCase()
+{
+  echo.attributes = smartAttributes();
+  echo.members = raidMembers();
+
+  server = new QDBusServer(this);
+  QVERIFY(server -> isConnected());
+  connect(server, SIGNAL(newConnection(QDBusConnection)), this, SLOT(serverConnection(QDBusConnection)));
+
+  QDBusConnection peer = QDBusConnection::connectToPeer(server -> address(), "libdiskmonitor-bench");
+  QVERIFY(peer.isConnected());
+
+  //mark the wrapper as listed, listStorageUnits() never enumerating the units of the bus
+  QMetaObject::invokeMethod(UDisks2Wrapper::instance(), "objectsListed", Qt::DirectConnection,
+                            Q_ARG(ManagedObjectList, ManagedObjectList()));
+}
+
+
+
+/*
+ * Close the peer to peer connection
+ */
+void LibDiskMonitorBench::cleanupTestCase()
+{
+  QDBusConnection::disconnectFromPeer("libdiskmonitor-bench");
+}
+
+
+
+/*
+ * Export the echo object on the server side of the peer connection
+ */
+void LibDiskMonitorBench::serverConnection(const QDBusConnection& connection)
+{
+  QDBusConnection c(connection);
+  c.registerObject("/bench", &echo, QDBusConnection::ExportAllSlots);
+}
+
+
+
+/*
+ * Call a method of the echo object, returning its reply as received from the bus
+ */
+QDBusArgument LibDiskMonitorBench::receive(const QString& method)
+{
+  QDBusConnection peer("libdiskmonitor-bench");
+  QDBusMessage call = QDBusMessage::createMethodCall(QString(), "/bench", QString(), method);
+  QDBusMessage reply = peer.call(call);
+
+  if(reply.type() != QDBusMessage::ReplyMessage || reply.arguments().isEmpty())
+    return QDBusArgument();
+
+  return reply.arguments().first().value<QDBusArgument>();
+}
+
+
+
+/*
+ * Feed the wrapper with the given units, as listed by UDisks2 on startup,
+ * replacing the units of the previous benchmark
+ */
+void LibDiskMonitorBench::populateWrapper(int drives, int raids)
+{
+  UDisks2Wrapper* udisks2 = UDisks2Wrapper::instance();
+
+  foreach(StorageUnit* unit, udisks2 -> listStorageUnits())
+    QMetaObject::invokeMethod(udisks2, "interfacesRemoved", Qt::DirectConnection,
+                              Q_ARG(QDBusObjectPath, unit -> getObjectPath()), Q_ARG(QStringList, QStringList()));
+
+  QMetaObject::invokeMethod(udisks2, "objectsListed", Qt::DirectConnection,
+                            Q_ARG(ManagedObjectList, managedObjects(drives, raids)));
+}
+
+
+
+/*
+ * Startup enumeration: build the units from the GetManagedObjects content
+ */
+void LibDiskMonitorBench::enumeration_data()
+{
+  QTest::addColumn<int>("units");
+
+  QTest::newRow("10 units") << 10;
+  QTest::newRow("100 units") << 100;
+  QTest::newRow("1000 units") << 1000;
+}
+
+void LibDiskMonitorBench::enumeration()
+{
+  QFETCH(int, units);
+
+  ManagedObjectList objects = managedObjects(units - units / 10, units / 10);
+
+  QBENCHMARK {
+    QList<StorageUnit*> created;
+
+    foreach(const QDBusObjectPath& objectPath, objects.keys()) {
+      const InterfaceList& interfaces = objects[objectPath];
+      if(interfaces.contains(UDISKS2_DRIVE_IFACE))
+        created << new Drive(objectPath, "/dev/bench", interfaces);
+      else if(interfaces.contains(UDISKS2_MDRAID_IFACE))
+        created << new MDRaid(objectPath, "/dev/md", interfaces);
+    }
+
+    qDeleteAll(created);
+  }
+}
+
+
+
+/*
+ * Cost of requesting a drive update, on the GUI thread
+ */
+void LibDiskMonitorBench::driveUpdate()
+{
+  Drive drive(QDBusObjectPath(UDISKS2_DRIVES_PATH "/BenchDrive_update"), "/dev/bench", driveInterfaces(0));
+
+  QBENCHMARK {
+    drive.update();
+  }
+}
+
+
+
+/*
+ * Cost of requesting a raid update, on the GUI thread
+ */
+void LibDiskMonitorBench::mdraidUpdate()
+{
+  MDRaid raid(QDBusObjectPath(UDISKS2_MDRAIDS_PATH "/BenchRaid_update"), "/dev/md", raidInterfaces(0));
+
+  QBENCHMARK {
+    raid.update();
+  }
+}
+
+
+
+/*
+ * SmartAttribute demarshaller, on a full attribute table
+ */
+void LibDiskMonitorBench::demarshallSmartAttributes()
+{
+  QDBusArgument received = receive("smartAttributes");
+  QCOMPARE(received.currentType(), QDBusArgument::ArrayType);
+
+  SmartAttributesList attributes;
+  QBENCHMARK {
+    //reading a copy detaches it, leaving the received argument intact
+    QDBusArgument argument = received;
+    attributes.clear();
+    argument >> attributes;
+  }
+
+  QCOMPARE(attributes.size(), BENCH_SMART_ATTRIBUTES);
+}
+
+
+
+/*
+ * MDRaidMember demarshaller
+ */
+void LibDiskMonitorBench::demarshallMDRaidMembers()
+{
+  QDBusArgument received = receive("raidMembers");
+  QCOMPARE(received.currentType(), QDBusArgument::ArrayType);
+
+  MDRaidMemberList members;
+  QBENCHMARK {
+    QDBusArgument argument = received;
+    members.clear();
+    argument >> members;
+  }
+
+  QCOMPARE(members.size(), BENCH_RAID_MEMBERS);
+}
+
+
+
+/*
+ * Read the key SMART values of a fleet of drives from their attribute tables,
+ * as done for the health snapshot
+ */
+void LibDiskMonitorBench::attributeTableScan_data()
+{
+  QTest::addColumn<int>("drives");
+
+  QTest::newRow("100 drives") << 100;
+  QTest::newRow("1000 drives") << 1000;
+}
+
+void LibDiskMonitorBench::attributeTableScan()
+{
+  QFETCH(int, drives);
+
+  QList<BenchDrive*> fleet;
+  for(int i = 0; i < drives; i++) {
+    BenchDrive* drive = new BenchDrive(QDBusObjectPath(QString(UDISKS2_DRIVES_PATH "/BenchDrive_scan%1").arg(i)), driveInterfaces(i));
+    drive -> setAttributes(smartAttributes());
+    fleet << drive;
+  }
+
+  qint64 total = 0;
+  QBENCHMARK {
+    foreach(BenchDrive* drive, fleet) {
+      const SmartAttributeTable& table = drive -> getSMARTAttributeTable();
+      total += table.pretty(5) + table.pretty(9) + table.pretty(194) + table.pretty(197) + table.pretty(198);
+    }
+  }
+
+  QVERIFY(total != 0);
+  qDeleteAll(fleet);
+}
+
+
+
+/*
+ * Evaluate the SMART attributes of a fleet of drives against their thresholds and
+ * the sensitive attributes, with SIMD and with the scalar implementation
+ */
+void LibDiskMonitorBench::fleetHealth_data()
+{
+  QTest::addColumn<int>("drives");
+  QTest::addColumn<bool>("simd");
+
+  QTest::newRow("1000 drives, scalar") << 1000 << false;
+  QTest::newRow("1000 drives, simd") << 1000 << true;
+}
+
+void LibDiskMonitorBench::fleetHealth()
+{
+  QFETCH(int, drives);
+  QFETCH(bool, simd);
+
+  if(simd && !SmartHealthEvaluator::isSimdEnabled())
+    QSKIP("SIMD not available on this build");
+
+  SmartAttributesList attributes = smartAttributes();
+  QList<int> sensitive;
+  sensitive << 5 << 197 << 198;
+
+  SmartHealthEvaluator evaluator;
+  evaluator.setSensitiveAttributes(sensitive);
+
+  QList<BenchDrive*> fleet;
+  for(int i = 0; i < drives; i++) {
+    //every tenth drive has an attribute below its threshold
+    SmartAttributesList driveAttributes = attributes;
+    if(i % 10 == 0)
+      driveAttributes[0].value = driveAttributes[0].threshold;
+
+    BenchDrive* drive = new BenchDrive(QDBusObjectPath(QString(UDISKS2_DRIVES_PATH "/BenchDrive_health%1").arg(i)), driveInterfaces(i));
+    drive -> setAttributes(driveAttributes);
+    fleet << drive;
+  }
+
+  int failing = 0;
+  QBENCHMARK {
+    failing = 0;
+    foreach(BenchDrive* drive, fleet) {
+      const SmartAttributeTable& table = drive -> getSMARTAttributeTable();
+      SmartHealth health = simd ? evaluator.evaluate(table) : evaluator.evaluateScalar(table);
+      if(health.hasBelowThreshold())
+        failing++;
+    }
+  }
+
+  //both implementations agree
+  foreach(BenchDrive* drive, fleet) {
+    SmartHealth a = evaluator.evaluate(drive -> getSMARTAttributeTable());
+    SmartHealth b = evaluator.evaluateScalar(drive -> getSMARTAttributeTable());
+    QVERIFY(memcmp(&a, &b, sizeof(SmartHealth)) == 0);
+  }
+
+  QCOMPARE(failing, (drives + 9) / 10);
+  qDeleteAll(fleet);
+}
+
+
+
+/*
+ * Apply the user defined health rules to a fleet of drives, as done after each update
+ */
+void LibDiskMonitorBench::healthRuleEvaluation_data()
+{
+  QTest::addColumn<QString>("rule");
+  QTest::addColumn<bool>("matching");
+
+  QTest::newRow("threshold rule") << "attr[5].value <= attr[5].threshold || attr[5].pretty > 0" << true;
+  QTest::newRow("delta rule") << "delta(attr[5].pretty, 24h) > 10 && delta(attr[197].pretty, 7d) > 0" << false;
+  QTest::newRow("arithmetic rule") << "(attr[9].pretty / 3600000 > 40000) + (attr[1].worst - attr[1].threshold < 5) > 0" << false;
+}
+
+void LibDiskMonitorBench::healthRuleEvaluation()
+{
+  QFETCH(QString, rule);
+  QFETCH(bool, matching);
+
+  HealthRuleEngine engine;
+  engine.setRules(rule, QString());
+  QVERIFY2(engine.getFailingRule().isValid(), qPrintable(engine.getFailingRule().getError()));
+
+  QList<BenchDrive*> fleet;
+  for(int i = 0; i < 1000; i++) {
+    BenchDrive* drive = new BenchDrive(QDBusObjectPath(QString(UDISKS2_DRIVES_PATH "/BenchDrive_rule%1").arg(i)), driveInterfaces(i));
+    drive -> setAttributes(smartAttributes());
+    fleet << drive;
+  }
+
+  //one update a minute
+  qint64 now = QDateTime::currentMSecsSinceEpoch();
+  QBENCHMARK {
+    now += 60 * 1000;
+    foreach(BenchDrive* drive, fleet)
+      engine.evaluate(drive, now);
+  }
+
+  foreach(BenchDrive* drive, fleet)
+    QCOMPARE(drive -> isFailing(), matching);
+
+  qDeleteAll(fleet);
+}
+
+
+
+/*
+ * Record a refresh cycle of 100 drives in the history, as diskmonitord does after each update
+ */
+void LibDiskMonitorBench::historyAppend()
+{
+  QTemporaryDir dir;
+  HistoryStore store(dir.path() + "/history");
+  QVERIFY(store.open());
+
+  QList<BenchDrive*> fleet;
+  for(int i = 0; i < 100; i++) {
+    BenchDrive* drive = new BenchDrive(QDBusObjectPath(QString(UDISKS2_DRIVES_PATH "/BenchDrive_history%1").arg(i)), driveInterfaces(i));
+    drive -> setAttributes(smartAttributes());
+    fleet << drive;
+  }
+
+  //one cycle every 5 minutes
+  qint64 time = QDateTime::currentMSecsSinceEpoch();
+  QBENCHMARK {
+    time += 5 * 60 * 1000;
+    foreach(BenchDrive* drive, fleet)
+      store.record(drive, time);
+  }
+
+  QVERIFY(!store.getSamples(fleet.first() -> getPath(), HistoryStore::AttributePretty, 5).isEmpty());
+  qDeleteAll(fleet);
+}
+
+
+
+/*
+ * Read back a series of a year of 5 minutes samples, decoding the sealed blocks in place
+ */
+void LibDiskMonitorBench::historyRead()
+{
+  QTemporaryDir dir;
+  HistoryStore store(dir.path() + "/history");
+  QVERIFY(store.open());
+
+  const int samples = 365 * 24 * 12;
+  const QString path = UDISKS2_DRIVES_PATH "/BenchDrive_read";
+
+  qint64 time = QDateTime::currentMSecsSinceEpoch();
+  for(int i = 0; i < samples; i++)
+    QVERIFY(store.append(path, HistoryStore::AttributePretty, 9, time + i * 5 * 60 * 1000, i));
+
+  HistoryStore reader(dir.path() + "/history");
+  QVERIFY(reader.open(true));
+
+  double total = 0;
+  int count = 0;
+  QBENCHMARK {
+    total = 0;
+    count = 0;
+    foreach(const HistorySample& sample, reader.getSamples(path, HistoryStore::AttributePretty, 9)) {
+      total += sample.value;
+      count++;
+    }
+  }
+
+  QCOMPARE(count, samples);
+  QCOMPARE(total, (double) samples * (samples - 1) / 2);
+}
+
+
+
+/*
+ * Generate a year of 5 minutes samples of a typical SMART value, with the jitter of
+ * the scheduler, and encode them in blocks of the size of the store
+ *
+ * @param series The kind of value
+ * @param samples Filled with the generated samples
+ * @param blocks Filled with the encoded blocks
+ * @param counts Filled with the number of samples of each block
+ * @return The number of bits used by the encoded samples
+ */
+qint64 LibDiskMonitorBench::encodeHistorySeries(const QString& series, QVector<HistorySample>& samples,
+                                                QList<QByteArray>& blocks, QList<int>& counts)
+{
+  samples.resize(365 * 24 * 12);
+  blocks.clear();
+  counts.clear();
+
+  std::mt19937 random(42);
+  std::uniform_int_distribution<int> jitter(-100, 99);
+  std::uniform_int_distribution<int> percent(0, 99);
+  std::uniform_int_distribution<int> step(-1, 1);
+  std::uniform_int_distribution<int> written(0, 99999);
+
+  qint64 time = QDateTime::currentMSecsSinceEpoch();
+  double value = 0;
+  for(int i = 0; i < samples.size(); i++) {
+    time += 5 * 60 * 1000 + jitter(random);
+
+    if(series == "power on time")
+      value = (double) (i * 5 * 60 * 1000LL);
+    else if(series == "temperature")
+      value = i == 0 ? 308150 : value + (percent(random) < 5 ? 1000 * step(random) : 0);
+    else if(series == "reallocated sectors")
+      value = i / 20000;
+    else
+      value += written(random);
+
+    samples[i].time = time;
+    samples[i].value = value;
+  }
+
+  HistoryEncoder encoder;
+  foreach(const HistorySample& sample, samples) {
+    if(!encoder.append(sample.time, sample.value)) {
+      blocks << QByteArray(HISTORY_BLOCK_SIZE - 16, 0);
+      counts << 0;
+      encoder.start(reinterpret_cast<uchar*>(blocks.last().data()), blocks.last().size());
+      encoder.append(sample.time, sample.value);
+    }
+
+    counts.last() = encoder.getCount();
+  }
+
+  return (qint64) (blocks.size() - 1) * (HISTORY_BLOCK_SIZE - 16) * 8 + encoder.getBitCount();
+}
+
+
+
+/*
+ * Typical SMART values recorded in the history
+ */
+QStringList LibDiskMonitorBench::historySeries()
+{
+  QStringList series;
+  series << "power on time" << "temperature" << "reallocated sectors" << "LBAs written";
+
+  return series;
+}
+
+
+
+/*
+ * Decode a year of 5 minutes samples of typical SMART values, compressed and raw. Every
+ * decoded sample is first checked against the encoded one, across the block boundaries
+ */
+void LibDiskMonitorBench::historyCompression_data()
+{
+  QTest::addColumn<QString>("series");
+  QTest::addColumn<bool>("compressed");
+
+  foreach(const QString& s, historySeries()) {
+    QTest::newRow(qPrintable(s + ", raw")) << s << false;
+    QTest::newRow(qPrintable(s + ", compressed")) << s << true;
+  }
+}
+
+void LibDiskMonitorBench::historyCompression()
+{
+  QFETCH(QString, series);
+  QFETCH(bool, compressed);
+
+  QVector<HistorySample> samples;
+  QList<QByteArray> blocks;
+  QList<int> counts;
+  encodeHistorySeries(series, samples, blocks, counts);
+
+  //the codec must give back exactly what was encoded, block after block
+  int index = 0;
+  HistorySample sample;
+  for(int i = 0; i < blocks.size(); i++) {
+    HistoryDecoder decoder(reinterpret_cast<const uchar*>(blocks.at(i).constData()), blocks.at(i).size(), counts.at(i));
+    while(decoder.next(sample.time, sample.value)) {
+      QVERIFY2(index < samples.size(), qPrintable(QString("extra sample in block %1").arg(i)));
+      QCOMPARE(sample.time, samples.at(index).time);
+      QVERIFY2(sample.value == samples.at(index).value,
+               qPrintable(QString("sample %1 (block %2): %3 instead of %4").arg(index).arg(i)
+                          .arg(sample.value, 0, 'g', 17).arg(samples.at(index).value, 0, 'g', 17)));
+      index++;
+    }
+  }
+
+  QCOMPARE(index, samples.size());
+
+  double total = 0;
+  int count = 0;
+  QBENCHMARK {
+    total = 0;
+    count = 0;
+
+    if(compressed) {
+      for(int i = 0; i < blocks.size(); i++) {
+        HistoryDecoder decoder(reinterpret_cast<const uchar*>(blocks.at(i).constData()), blocks.at(i).size(), counts.at(i));
+        while(decoder.next(sample.time, sample.value)) {
+          total += sample.value;
+          count++;
+        }
+      }
+    } else {
+      foreach(const HistorySample& s, samples) {
+        total += s.value;
+        count++;
+      }
+    }
+  }
+
+  QCOMPARE(count, samples.size());
+}
+
+
+
+/*
+ * Size of a compressed sample of typical SMART values, reported as the result of the
+ * benchmark in bytes per sample (against the 16 bytes of a raw sample)
+ */
+void LibDiskMonitorBench::historyCompressionRatio_data()
+{
+  QTest::addColumn<QString>("series");
+
+  foreach(const QString& s, historySeries())
+    QTest::newRow(qPrintable(s)) << s;
+}
+
+void LibDiskMonitorBench::historyCompressionRatio()
+{
+  QFETCH(QString, series);
+
+  QVector<HistorySample> samples;
+  QList<QByteArray> blocks;
+  QList<int> counts;
+  qint64 bits = encodeHistorySeries(series, samples, blocks, counts);
+
+  QVERIFY(bits < (qint64) (samples.size() * sizeof(HistorySample) * 8));
+  QTest::setBenchmarkResult((qreal) bits / 8 / samples.size(), QTest::BytesAllocated);
+}
+
+
+
+/*
+ * StorageUnitModel::data() for every role, over every row
+ */
+void LibDiskMonitorBench::storageUnitModelData_data()
+{
+  QTest::addColumn<int>("role");
+
+  QTest::newRow("DisplayRole") << (int) Qt::DisplayRole;
+  QTest::newRow("ToolTipRole") << (int) Qt::ToolTipRole;
+  QTest::newRow("DecorationRole") << (int) Qt::DecorationRole;
+  QTest::newRow("SizeHintRole") << (int) Qt::SizeHintRole;
+  QTest::newRow("UserRole") << (int) Qt::UserRole;
+}
+
+void LibDiskMonitorBench::storageUnitModelData()
+{
+  QFETCH(int, role);
+
+  populateWrapper(90, 10);
+  StorageUnitModel model;
+  QVERIFY(model.rowCount(QModelIndex()) > 0);
+
+  QBENCHMARK {
+    for(int row = 0; row < model.rowCount(QModelIndex()); row++)
+      model.data(model.index(row), role);
+  }
+}
+
+
+
+/*
+ * DrivePropertiesModel::data() over a full attribute table, for every cell and role
+ */
+void LibDiskMonitorBench::drivePropertiesModelData()
+{
+  BenchDrive drive(QDBusObjectPath(UDISKS2_DRIVES_PATH "/BenchDrive_properties"), driveInterfaces(0));
+  drive.setAttributes(smartAttributes());
+
+  DrivePropertiesModel model;
+  model.setStorageUnit(&drive);
+  QCOMPARE(model.rowCount(QModelIndex()), BENCH_SMART_ATTRIBUTES);
+
+  QList<int> roles;
+  roles << Qt::DisplayRole << Qt::ToolTipRole << Qt::DecorationRole << Qt::FontRole
+        << Qt::ForegroundRole << Qt::BackgroundRole << Qt::TextAlignmentRole;
+
+  QBENCHMARK {
+    for(int row = 0; row < model.rowCount(QModelIndex()); row++) {
+      for(int column = 0; column < model.columnCount(QModelIndex()); column++) {
+        QModelIndex index = model.index(row, column);
+        foreach(int role, roles)
+          model.data(index, role);
+      }
+    }
+  }
+
+  model.setStorageUnit(nullptr);
+}
+
+
+
+/*
+ * DrivePropertiesModel following an update of its drive where a single attribute
+ * changed, as during a self test, the table being updated without reset
+ */
+void LibDiskMonitorBench::drivePropertiesModelUpdate()
+{
+  BenchDrive drive(QDBusObjectPath(UDISKS2_DRIVES_PATH "/BenchDrive_update"), driveInterfaces(0));
+  SmartAttributesList attributes = smartAttributes();
+  drive.setAttributes(attributes);
+
+  DrivePropertiesModel model;
+  model.setStorageUnit(&drive);
+
+  QSignalSpy reset(&model, SIGNAL(modelReset()));
+  QSignalSpy dataChanged(&model, SIGNAL(dataChanged(QModelIndex,QModelIndex,QVector<int>)));
+
+  QBENCHMARK {
+    attributes[0].pretty++;
+    drive.setAttributes(attributes);
+    emit drive.updated(&drive);
+  }
+
+  QCOMPARE(reset.count(), 0);
+  QVERIFY(dataChanged.count() > 0);
+  QCOMPARE(model.rowCount(QModelIndex()), BENCH_SMART_ATTRIBUTES);
+
+  model.setStorageUnit(nullptr);
+}
+
+
+
+/*
+ * StorageUnitQmlModel::monitor(), requesting the refresh of every unit
+ */
+void LibDiskMonitorBench::qmlModelMonitor_data()
+{
+  QTest::addColumn<int>("units");
+
+  QTest::newRow("10 units") << 10;
+  QTest::newRow("100 units") << 100;
+  QTest::newRow("1000 units") << 1000;
+}
+
+void LibDiskMonitorBench::qmlModelMonitor()
+{
+  QFETCH(int, units);
+
+  populateWrapper(units - units / 10, units / 10);
+  StorageUnitQmlModel model;
+
+  QBENCHMARK {
+    QMetaObject::invokeMethod(&model, "monitor", Qt::DirectConnection);
+  }
+}
+
+
+
+/*
+ * StorageUnitQmlModel at the end of a refresh cycle where nothing changed,
+ * no row being notified to the applet
+ */
+void LibDiskMonitorBench::qmlModelRefreshed_data()
+{
+  qmlModelMonitor_data();
+}
+
+void LibDiskMonitorBench::qmlModelRefreshed()
+{
+  QFETCH(int, units);
+
+  populateWrapper(units - units / 10, units / 10);
+  StorageUnitQmlModel model;
+
+  //first cycle processing the units listed on construction
+  QMetaObject::invokeMethod(&model, "storageUnitsRefreshed", Qt::DirectConnection);
+
+  QSignalSpy dataChanged(&model, SIGNAL(dataChanged(QModelIndex,QModelIndex,QVector<int>)));
+  QBENCHMARK {
+    QMetaObject::invokeMethod(&model, "storageUnitsRefreshed", Qt::DirectConnection);
+  }
+
+  QCOMPARE(dataChanged.count(), 0);
+}
+
+
+
+/*
+ * Not a benchmark: assert the DBus call budget of a full refresh, a regression
+ * of the bus load failing the run
+ */
+void LibDiskMonitorBench::callBudget_data()
+{
+  QTest::addColumn<int>("drives");
+  QTest::addColumn<int>("raids");
+
+  QTest::newRow("10 drives") << 10 << 0;
+  QTest::newRow("100 drives, 10 raids") << 100 << 10;
+  QTest::newRow("1000 drives, 100 raids") << 1000 << 100;
+}
+
+void LibDiskMonitorBench::callBudget()
+{
+  QFETCH(int, drives);
+  QFETCH(int, raids);
+
+  UDisks2Wrapper* udisks2 = UDisks2Wrapper::instance();
+  populateWrapper(drives, raids);
+
+  //the first refresh also reads the outdated SMART attributes
+  QSignalSpy refreshed(udisks2, SIGNAL(storageUnitsRefreshed()));
+  udisks2 -> refreshStorageUnits();
+  QVERIFY(refreshed.count() == 1 || refreshed.wait(BUDGET_REFRESH_DEADLINE));
+
+  udisks2 -> resetCallCounts();
+  udisks2 -> refreshStorageUnits();
+  QVERIFY(refreshed.count() == 2 || refreshed.wait(BUDGET_REFRESH_DEADLINE));
+  udisks2 -> dumpCallCounts();
+
+  QVERIFY(udisks2 -> getRoundTripCount() <= (quint64) (BUDGET_DRIVE_REFRESH * drives + BUDGET_RAID_REFRESH * raids));
+
+  //every bench drive supports power management and is active (or unknown to the
+  //bus), each unit being updated exactly once per refresh
+  QCOMPARE(udisks2 -> getCallCount(UDISKS2_ATA_IFACE, "PmGetState", "Drive::update"), (quint64) drives);
+  QCOMPARE(udisks2 -> getCallCount(DBUS_PROPERTIES_IFACE, "GetAll", "Drive::update"), (quint64) drives);
+  QCOMPARE(udisks2 -> getCallCount(DBUS_PROPERTIES_IFACE, "GetAll", "Drive::update (ATA properties)"), (quint64) drives);
+  QCOMPARE(udisks2 -> getCallCount(DBUS_PROPERTIES_IFACE, "GetAll", "MDRaid::update"), (quint64) raids);
+
+  //a refresh never enumerates the nodes again
+  QCOMPARE(udisks2 -> getCallCount(UDISKS2_OBJECT_IFACE, "GetManagedObjects"), (quint64) 0);
+}
+
+
+
+QTEST_MAIN(LibDiskMonitorBench)
+
+#include "libdiskmonitorbench.moc"
@@ -0,0 +1,93 @@
+/****************************************************************************
+ * DisKMonitor, KDE tools to monitor SMART and MDRaid health status         *
+ * Copyright (C) 2014-2015 Michaël Lhomme <papylhomme@gmail.com>            *
+ *                                                                          *
+ * This program is free software; you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation; either version 2 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License along  *
+ * with this program; if not, write to the Free Software Foundation, Inc.,  *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.              *
+ ****************************************************************************/
+
+
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+
+#include "mockudisks2.h"
+
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+  app.setApplicationName("mockudisks2");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Mock UDisks2 service, to be run on a private bus for benchmarking DisKMonitor");
+  parser.addHelpOption();
+
+  QCommandLineOption addressOption("address", "Address of the bus to serve, the session bus if not set", "address");
+  QCommandLineOption drivesOption("drives", "Number of drives", "count", "10");
+  QCommandLineOption raidsOption("raids", "Number of raid arrays", "count", "2");
+  QCommandLineOption failingOption("failing", "Number of failing drives", "count", "0");
+  QCommandLineOption standbyOption("standby", "Number of drives in standby", "count", "0");
+  QCommandLineOption raidMembersOption("raid-members", "Number of members of each raid array, taken from the drives", "count", "0");
+  QCommandLineOption latencyOption("latency", "Latency of every call", "ms", "0");
+  QCommandLineOption jitterOption("jitter", "Random jitter added to the latency", "ms", "0");
+  QCommandLineOption timeoutRateOption("timeout-rate", "Probability of a call never being answered", "rate", "0");
+  QCommandLineOption errorRateOption("error-rate", "Probability of a call failing", "rate", "0");
+  QCommandLineOption hotplugIntervalOption("hotplug-interval", "Interval of the hotplug storm, disabled if 0", "ms", "0");
+  QCommandLineOption hotplugBurstOption("hotplug-burst", "Number of drives replugged on each hotplug", "count", "1");
+  QCommandLineOption changeIntervalOption("change-interval", "Interval of the SMART data updates, disabled if 0", "ms", "0");
+  QCommandLineOption changeBurstOption("change-burst", "Number of drives updated on each change", "count", "1");
+  QCommandLineOption jobIntervalOption("job-interval", "Interval of the self test jobs, disabled if 0", "ms", "0");
+  QCommandLineOption jobDurationOption("job-duration", "Duration of a self test job", "ms", "10000");
+  QCommandLineOption seedOption("seed", "Seed of the random events", "seed", "1");
+
+  parser.addOptions({ addressOption, drivesOption, raidsOption, failingOption, standbyOption, raidMembersOption,
+                      latencyOption, jitterOption, timeoutRateOption, errorRateOption, hotplugIntervalOption,
+                      hotplugBurstOption, changeIntervalOption, changeBurstOption, jobIntervalOption,
+                      jobDurationOption, seedOption });
+  parser.process(app);
+
+  MockConfig config;
+  config.drives = parser.value(drivesOption).toInt();
+  config.raids = parser.value(raidsOption).toInt();
+  config.failingDrives = parser.value(failingOption).toInt();
+  config.standbyDrives = parser.value(standbyOption).toInt();
+  config.raidMembers = parser.value(raidMembersOption).toInt();
+  config.latency = parser.value(latencyOption).toInt();
+  config.jitter = parser.value(jitterOption).toInt();
+  config.timeoutRate = parser.value(timeoutRateOption).toDouble();
+  config.errorRate = parser.value(errorRateOption).toDouble();
+  config.hotplugInterval = parser.value(hotplugIntervalOption).toInt();
+  config.hotplugBurst = parser.value(hotplugBurstOption).toInt();
+  config.changeInterval = parser.value(changeIntervalOption).toInt();
+  config.changeBurst = parser.value(changeBurstOption).toInt();
+  config.jobInterval = parser.value(jobIntervalOption).toInt();
+  config.jobDuration = parser.value(jobDurationOption).toInt();
+  config.seed = parser.value(seedOption).toUInt();
+
+  QDBusConnection connection = parser.isSet(addressOption) ?
+    QDBusConnection::connectToBus(parser.value(addressOption), "mockudisks2") :
+    QDBusConnection::sessionBus();
+
+  if(!connection.isConnected()) {
+    qCritical() << "mockudisks2 => Unable to connect to the bus: " << connection.lastError().message();
+    return 1;
+  }
+
+  MockUDisks2 mock(config, connection);
+  if(!mock.registerOnBus())
+    return 1;
+
+  return app.exec();
+}
@@ -0,0 +1,528 @@
+/****************************************************************************
+ * DisKMonitor, KDE tools to monitor SMART and MDRaid health status         *
+ * Copyright (C) 2014-2015 Michaël Lhomme <papylhomme@gmail.com>            *
+ *                                                                          *
+ * This program is free software; you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation; either version 2 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License along  *
+ * with this program; if not, write to the Free Software Foundation, Inc.,  *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.              *
+ ****************************************************************************/
+
+
+
+#include "mockudisks2.h"
+
+#include "udisks2wrapper.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QSet>
+
+
+
+#define MOCK_DRIVE_PATH UDISKS2_DRIVES_PATH "/MockDrive_"
+#define MOCK_RAID_PATH UDISKS2_MDRAIDS_PATH "/MockRaid_"
+#define MOCK_DRIVE_BLOCK_PATH UDISKS2_BLOCK_DEVICES_PATH "/mock"
+#define MOCK_RAID_BLOCK_PATH UDISKS2_BLOCK_DEVICES_PATH "/md"
+#define MOCK_JOB_PATH UDISKS2_PATH "/jobs/MockJob_"
+
+#define MOCK_ERROR_FAILED "org.freedesktop.UDisks2.Error.Failed"
+
+//ATA power states answered by PmGetState, standby and active/idle
+#define MOCK_PM_STATE_STANDBY 0x00
+#define MOCK_PM_STATE_ACTIVE 0xff
+
+//interval of the progress updates of the jobs, in milliseconds
+#define MOCK_JOB_TICK 1000
+
+
+
+/*
+ * Constructor. Create the nodes described by the configuration
+ *
+ * @param config The behavior of the service
+ * @param connection The bus to serve
+ */
+MockUDisks2::MockUDisks2(const MockConfig& config, const QDBusConnection& connection) : QDBusVirtualObject(),
+  config(config),
+  connection(connection),
+  random(config.seed)
+{
+  qDBusRegisterMetaType<InterfaceList>();
+  qDBusRegisterMetaType<ManagedObjectList>();
+  qDBusRegisterMetaType<SmartAttribute>();
+  qDBusRegisterMetaType<SmartAttributesList>();
+  qDBusRegisterMetaType<MDRaidMember>();
+  qDBusRegisterMetaType<MDRaidMemberList>();
+
+  createAttributes();
+
+  for(int i = 0; i < config.drives; i++)
+    createDrive(i);
+
+  for(int i = 0; i < config.raids; i++)
+    createRaid(i);
+
+  if(config.hotplugInterval > 0) {
+    connect(&hotplugTimer, SIGNAL(timeout()), this, SLOT(hotplug()));
+    hotplugTimer.start(config.hotplugInterval);
+  }
+
+  if(config.changeInterval > 0) {
+    connect(&changeTimer, SIGNAL(timeout()), this, SLOT(changeProperties()));
+    changeTimer.start(config.changeInterval);
+  }
+
+  if(config.jobInterval > 0) {
+    connect(&jobTimer, SIGNAL(timeout()), this, SLOT(startJob()));
+    connect(&jobProgressTimer, SIGNAL(timeout()), this, SLOT(progressJobs()));
+    jobTimer.start(config.jobInterval);
+    jobProgressTimer.start(MOCK_JOB_TICK);
+  }
+}
+
+
+
+/*
+ * Destructor
+ */
+MockUDisks2::~MockUDisks2()
+{
+
+}
+
+
+
+/*
+ * Register the nodes and the UDisks2 service name on the bus
+ *
+ * @return true on success
+ */
+bool MockUDisks2::registerOnBus()
+{
+  if(!connection.registerVirtualObject(UDISKS2_PATH, this, QDBusConnection::SubPath)) {
+    qCritical() << "MockUDisks2 => Unable to register object: " << connection.lastError().message();
+    return false;
+  }
+
+  if(!connection.registerService(UDISKS2_SERVICE)) {
+    qCritical() << "MockUDisks2 => Unable to register service: " << connection.lastError().message();
+    return false;
+  }
+
+  qDebug() << "MockUDisks2 => Serving " << config.drives << " drives and " << config.raids << " raids";
+  return true;
+}
+
+
+
+/*
+ * Create a drive node and its block device
+ */
+void MockUDisks2::createDrive(int index)
+{
+  QDBusObjectPath drivePath(MOCK_DRIVE_PATH + QString::number(index));
+  QDBusObjectPath blockPath(MOCK_DRIVE_BLOCK_PATH + QString::number(index));
+
+  QVariantMap drive;
+  drive["Model"] = QString("Mock Drive %1").arg(index);
+  drive["Serial"] = QString("MOCK%1").arg(index, 8, 10, QChar('0'));
+  drive["Removable"] = false;
+  drive["Size"] = (qulonglong) 1000204886016;
+
+  QVariantMap ata;
+  ata["SmartSupported"] = true;
+  ata["SmartEnabled"] = true;
+  ata["SmartFailing"] = index < config.failingDrives;
+  ata["SmartUpdated"] = (qulonglong) QDateTime::currentMSecsSinceEpoch() / 1000;
+  ata["SmartSelftestStatus"] = QString("success");
+  ata["SmartSelftestPercentRemaining"] = 0;
+  ata["PmSupported"] = true;
+  ata["PmEnabled"] = true;
+
+  QVariantMap block;
+  block["Device"] = QByteArray("/dev/mock" + QByteArray::number(index));
+  block["Drive"] = QVariant::fromValue(drivePath);
+  block["MDRaid"] = QVariant::fromValue(QDBusObjectPath("/"));
+
+  if(index < config.standbyDrives)
+    standbyDrives << drivePath;
+
+  objects[drivePath][UDISKS2_DRIVE_IFACE] = drive;
+  objects[drivePath][UDISKS2_ATA_IFACE] = ata;
+  objects[blockPath][UDISKS2_BLOCK_IFACE] = block;
+}
+
+
+
+/*
+ * Create a raid node and its block device. The members are the block devices
+ * of the drives, taken in turn by the arrays
+ */
+void MockUDisks2::createRaid(int index)
+{
+  QDBusObjectPath raidPath(MOCK_RAID_PATH + QString::number(index));
+  QDBusObjectPath blockPath(MOCK_RAID_BLOCK_PATH + QString::number(index));
+
+  MDRaidMemberList members;
+  for(int i = 0; config.drives > 0 && i < config.raidMembers; i++) {
+    MDRaidMember member;
+    member.block = QDBusObjectPath(MOCK_DRIVE_BLOCK_PATH + QString::number((index * config.raidMembers + i) % config.drives));
+    member.slot = i;
+    member.state << "in_sync";
+    member.numReadErrors = 0;
+    members << member;
+  }
+
+  QVariantMap raid;
+  raid["UUID"] = QString("00000000:00000000:00000000:%1").arg(index, 8, 16, QChar('0'));
+  raid["Name"] = QString("mock:%1").arg(index);
+  raid["Level"] = QString("raid1");
+  raid["NumDevices"] = (uint) (members.isEmpty() ? 2 : members.size());
+  raid["Size"] = (qulonglong) 1000204886016;
+  raid["SyncAction"] = QString("idle");
+  raid["SyncCompleted"] = 0.0;
+  raid["SyncRate"] = (qulonglong) 0;
+  raid["SyncRemainingTime"] = (qulonglong) 0;
+  raid["Degraded"] = (uint) 0;
+  raid["ActiveDevices"] = QVariant::fromValue(members);
+
+  QVariantMap block;
+  block["Device"] = QByteArray("/dev/md" + QByteArray::number(index));
+  block["Drive"] = QVariant::fromValue(QDBusObjectPath("/"));
+  block["MDRaid"] = QVariant::fromValue(raidPath);
+
+  objects[raidPath][UDISKS2_MDRAID_IFACE] = raid;
+  objects[blockPath][UDISKS2_BLOCK_IFACE] = block;
+}
+
+
+
+/*
+ * Create the SMART attribute table shared by every drive
+ */
+void MockUDisks2::createAttributes()
+{
+  const char* names[] = {
+    "raw-read-error-rate", "spin-up-time", "start-stop-count", "reallocated-sector-count",
+    "seek-error-rate", "power-on-hours", "spin-retry-count", "power-cycle-count",
+    "power-off-retract-count", "load-cycle-count", "temperature-celsius-2",
+    "reallocated-event-count", "current-pending-sector", "offline-uncorrectable",
+    "udma-crc-error-count", "multi-zone-error-rate"
+  };
+  const quint8 ids[] = { 1, 3, 4, 5, 7, 9, 10, 12, 192, 193, 194, 196, 197, 198, 199, 200 };
+
+  for(unsigned int i = 0; i < sizeof(ids) / sizeof(ids[0]); i++) {
+    SmartAttribute a;
+    a.id = ids[i];
+    a.name = names[i];
+    a.flags = 0x0032;
+    a.value = 100;
+    a.worst = 100;
+    a.threshold = 10;
+    a.pretty = ids[i] == 194 ? 308150 : i;
+    a.pretty_unit = ids[i] == 194 ? 4 : 1;
+    attributes << a;
+  }
+}
+
+
+
+/*
+ * Introspection data of a node, only listing its children: the typed
+ * proxies of libdiskmonitor don't rely on introspection
+ */
+QString MockUDisks2::introspect(const QString& path) const
+{
+  QString prefix = path.endsWith('/') ? path : path + '/';
+  QSet<QString> children;
+
+  foreach(const QDBusObjectPath& objectPath, objects.keys()) {
+    if(objectPath.path().startsWith(prefix))
+      children << objectPath.path().mid(prefix.size()).section('/', 0, 0);
+  }
+
+  QString xml;
+  foreach(const QString& child, children)
+    xml += QString("<node name=\"%1\"/>").arg(child);
+
+  return xml;
+}
+
+
+
+/*
+ * Handle a call to any node of the service, replying after the configured latency
+ */
+bool MockUDisks2::handleMessage(const QDBusMessage& message, const QDBusConnection& /*connection*/)
+{
+  if(message.type() != QDBusMessage::MethodCallMessage)
+    return false;
+
+  //injected timeout, the caller never receives a reply
+  if(roll(config.timeoutRate))
+    return true;
+
+  if(roll(config.errorRate))
+    sendReply(message.createErrorReply(MOCK_ERROR_FAILED, "Injected error"));
+  else
+    sendReply(buildReply(message));
+
+  return true;
+}
+
+
+
+/*
+ * Build the reply of a method call
+ */
+QDBusMessage MockUDisks2::buildReply(const QDBusMessage& message)
+{
+  QString interface = message.interface();
+  QString member = message.member();
+  QDBusObjectPath objectPath(message.path());
+  QList<QVariant> args = message.arguments();
+
+  if(interface == UDISKS2_OBJECT_IFACE && member == "GetManagedObjects")
+    return message.createReply(QVariant::fromValue(objects));
+
+  if(!objects.contains(objectPath))
+    return message.createErrorReply(QDBusError::UnknownObject, "No such node: " + objectPath.path());
+
+  const InterfaceList& interfaces = objects[objectPath];
+
+  if(interface == DBUS_PROPERTIES_IFACE) {
+    QString propertiesInterface = args.value(0).toString();
+    if(!interfaces.contains(propertiesInterface))
+      return message.createErrorReply(QDBusError::UnknownInterface, "No such interface: " + propertiesInterface);
+
+    if(member == "GetAll")
+      return message.createReply(interfaces[propertiesInterface]);
+
+    if(member == "Get" && interfaces[propertiesInterface].contains(args.value(1).toString()))
+      return message.createReply(QVariant::fromValue(QDBusVariant(interfaces[propertiesInterface][args.value(1).toString()])));
+
+    return message.createErrorReply(QDBusError::UnknownProperty, "No such property");
+  }
+
+  if(!interfaces.contains(interface))
+    return message.createErrorReply(QDBusError::UnknownInterface, "No such interface: " + interface);
+
+  if(interface == UDISKS2_ATA_IFACE && member == "SmartGetAttributes")
+    return message.createReply(QVariant::fromValue(attributes));
+
+  if(interface == UDISKS2_ATA_IFACE && member == "PmGetState")
+    return message.createReply(QVariant::fromValue((quint8) (standbyDrives.contains(objectPath) ? MOCK_PM_STATE_STANDBY : MOCK_PM_STATE_ACTIVE)));
+
+  //actions are accepted without changing the state of the node
+  if((interface == UDISKS2_ATA_IFACE &&
+      (member == "SmartUpdate" || member == "SmartSetEnabled" || member == "SmartSelftestStart" || member == "SmartSelftestAbort")) ||
+     (interface == UDISKS2_MDRAID_IFACE && member == "RequestSyncAction"))
+    return message.createReply();
+
+  return message.createErrorReply(QDBusError::UnknownMethod, "No such method: " + member);
+}
+
+
+
+/*
+ * Send a reply after the configured latency
+ */
+void MockUDisks2::sendReply(const QDBusMessage& reply)
+{
+  int delay = config.latency;
+  if(config.jitter > 0)
+    delay += std::uniform_int_distribution<int>(0, config.jitter)(random);
+
+  if(delay == 0) {
+    connection.send(reply);
+    return;
+  }
+
+  QDBusConnection bus = connection;
+  QTimer::singleShot(delay, this, [bus, reply]() { bus.send(reply); });
+}
+
+
+
+/*
+ * Test a random event of the given probability
+ */
+bool MockUDisks2::roll(double probability)
+{
+  if(probability <= 0)
+    return false;
+
+  return std::uniform_real_distribution<double>(0, 1)(random) < probability;
+}
+
+
+
+/*
+ * Unplug random drives and plug them back, as UDisks2 signals it: the drive
+ * node is added before its block device, and removed after it
+ */
+void MockUDisks2::hotplug()
+{
+  if(config.drives == 0)
+    return;
+
+  std::uniform_int_distribution<int> pick(0, config.drives - 1);
+
+  for(int i = 0; i < config.hotplugBurst; i++) {
+    int index = pick(random);
+    QDBusObjectPath drivePath(MOCK_DRIVE_PATH + QString::number(index));
+    QDBusObjectPath blockPath(MOCK_DRIVE_BLOCK_PATH + QString::number(index));
+
+    emitInterfacesRemoved(blockPath);
+    emitInterfacesRemoved(drivePath);
+    emitInterfacesAdded(drivePath);
+    emitInterfacesAdded(blockPath);
+  }
+}
+
+
+
+/*
+ * Bump SmartUpdated of random drives, as UDisks2 does when it collects the SMART data
+ */
+void MockUDisks2::changeProperties()
+{
+  if(config.drives == 0)
+    return;
+
+  std::uniform_int_distribution<int> pick(0, config.drives - 1);
+  qulonglong now = QDateTime::currentMSecsSinceEpoch() / 1000;
+
+  for(int i = 0; i < config.changeBurst; i++) {
+    QDBusObjectPath drivePath(MOCK_DRIVE_PATH + QString::number(pick(random)));
+
+    //several changes in the same second must still be seen as new data
+    qulonglong updated = qMax(now, objects[drivePath][UDISKS2_ATA_IFACE]["SmartUpdated"].toULongLong() + 1);
+
+    QVariantMap properties;
+    properties["SmartUpdated"] = updated;
+    emitPropertiesChanged(drivePath, UDISKS2_ATA_IFACE, properties);
+  }
+}
+
+
+
+/*
+ * Start a SMART self test job on a random idle drive, exported as a Job node operating
+ * on the drive, the self test status of the drive following the job
+ */
+void MockUDisks2::startJob()
+{
+  if(config.drives == 0)
+    return;
+
+  QDBusObjectPath drivePath(MOCK_DRIVE_PATH + QString::number(std::uniform_int_distribution<int>(0, config.drives - 1)(random)));
+  if(jobs.values().contains(drivePath))
+    return;
+
+  QDBusObjectPath jobPath(MOCK_JOB_PATH + QString::number(jobCount++));
+  qulonglong now = QDateTime::currentMSecsSinceEpoch() * 1000;
+
+  QVariantMap job;
+  job["Operation"] = QString("ata-smart-selftest");
+  job["Progress"] = 0.0;
+  job["ProgressValid"] = true;
+  job["Rate"] = (qulonglong) 0;
+  job["StartTime"] = now;
+  job["ExpectedEndTime"] = now + (qulonglong) config.jobDuration * 1000;
+  job["Objects"] = QVariant::fromValue(QList<QDBusObjectPath>() << drivePath);
+  job["Cancelable"] = true;
+  job["StartedByUID"] = (uint) 0;
+
+  objects[jobPath][UDISKS2_JOB_IFACE] = job;
+  jobs[jobPath] = drivePath;
+
+  QVariantMap ata;
+  ata["SmartSelftestStatus"] = QString("inprogress");
+  ata["SmartSelftestPercentRemaining"] = 100;
+  emitPropertiesChanged(drivePath, UDISKS2_ATA_IFACE, ata);
+
+  emitInterfacesAdded(jobPath);
+}
+
+
+
+/*
+ * Advance the running jobs, removing the completed ones
+ */
+void MockUDisks2::progressJobs()
+{
+  foreach(const QDBusObjectPath& jobPath, jobs.keys()) {
+    QDBusObjectPath drivePath = jobs[jobPath];
+    double progress = objects[jobPath][UDISKS2_JOB_IFACE]["Progress"].toDouble() + (double) MOCK_JOB_TICK / qMax(config.jobDuration, 1);
+    progress = qMin(progress, 1.0);
+
+    QVariantMap job;
+    job["Progress"] = progress;
+    emitPropertiesChanged(jobPath, UDISKS2_JOB_IFACE, job);
+
+    QVariantMap ata;
+    ata["SmartSelftestStatus"] = QString(progress < 1 ? "inprogress" : "success");
+    ata["SmartSelftestPercentRemaining"] = (int) (100 * (1 - progress));
+    emitPropertiesChanged(drivePath, UDISKS2_ATA_IFACE, ata);
+
+    if(progress >= 1) {
+      emitInterfacesRemoved(jobPath);
+      objects.remove(jobPath);
+      jobs.remove(jobPath);
+    }
+  }
+}
+
+
+
+/*
+ * Emit ObjectManager "InterfacesAdded" signal for every interface of the node
+ */
+void MockUDisks2::emitInterfacesAdded(const QDBusObjectPath& objectPath)
+{
+  QDBusMessage signal = QDBusMessage::createSignal(UDISKS2_PATH, UDISKS2_OBJECT_IFACE, "InterfacesAdded");
+  signal << QVariant::fromValue(objectPath) << QVariant::fromValue(objects[objectPath]);
+  connection.send(signal);
+}
+
+
+
+/*
+ * Emit ObjectManager "InterfacesRemoved" signal for every interface of the node
+ */
+void MockUDisks2::emitInterfacesRemoved(const QDBusObjectPath& objectPath)
+{
+  QDBusMessage signal = QDBusMessage::createSignal(UDISKS2_PATH, UDISKS2_OBJECT_IFACE, "InterfacesRemoved");
+  signal << QVariant::fromValue(objectPath) << QStringList(objects[objectPath].keys());
+  connection.send(signal);
+}
+
+
+
+/*
+ * Update properties of a node and emit the Properties "PropertiesChanged" signal
+ *
+ * @param objectPath The node owning the properties
+ * @param interface The interface owning the properties
+ * @param properties The changed properties with their new values
+ */
+void MockUDisks2::emitPropertiesChanged(const QDBusObjectPath& objectPath, const QString& interface, const QVariantMap& properties)
+{
+  for(QVariantMap::const_iterator it = properties.constBegin(); it != properties.constEnd(); ++it)
+    objects[objectPath][interface][it.key()] = it.value();
+
+  QDBusMessage signal = QDBusMessage::createSignal(objectPath.path(), DBUS_PROPERTIES_IFACE, "PropertiesChanged");
+  signal << interface << properties << QStringList();
+  connection.send(signal);
+}
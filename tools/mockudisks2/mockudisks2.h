@@ -0,0 +1,133 @@
+/****************************************************************************
+ * DisKMonitor, KDE tools to monitor SMART and MDRaid health status         *
+ * Copyright (C) 2014-2015 Michaël Lhomme <papylhomme@gmail.com>            *
+ *                                                                          *
+ * This program is free software; you can redistribute it and/or modify     *
+ * it under the terms of the GNU General Public License as published by     *
+ * the Free Software Foundation; either version 2 of the License, or        *
+ * (at your option) any later version.                                      *
+ *                                                                          *
+ * This program is distributed in the hope that it will be useful,          *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ * GNU General Public License for more details.                             *
+ *                                                                          *
+ * You should have received a copy of the GNU General Public License along  *
+ * with this program; if not, write to the Free Software Foundation, Inc.,  *
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.              *
+ ****************************************************************************/
+
+
+
+#ifndef MOCKUDISKS2_H
+#define MOCKUDISKS2_H
+
+#include <QDBusVirtualObject>
+#include <QDBusConnection>
+#include <QMap>
+#include <QSet>
+#include <QTimer>
+
+#include <random>
+
+#include "dbus_metatypes.h"
+
+
+
+/*
+ * Behavior of the mock service
+ */
+struct MockConfig {
+  int drives = 10;
+  int raids = 2;
+  int failingDrives = 0;
+
+  //drives answering PmGetState with a standby state
+  int standbyDrives = 0;
+
+  //members of each raid array, taken from the drives' block devices
+  int raidMembers = 0;
+
+  //per call latency and its random jitter, in milliseconds
+  int latency = 0;
+  int jitter = 0;
+
+  //probability of a call never being answered, or answered with an error
+  double timeoutRate = 0;
+  double errorRate = 0;
+
+  //hotplug storm: every hotplugInterval ms, hotplugBurst drives are unplugged and plugged back
+  int hotplugInterval = 0;
+  int hotplugBurst = 1;
+
+  //property changes: every changeInterval ms, SmartUpdated of changeBurst drives is bumped
+  int changeInterval = 0;
+  int changeBurst = 1;
+
+  //jobs: every jobInterval ms, a self test job lasting jobDuration ms is started on a drive
+  int jobInterval = 0;
+  int jobDuration = 10000;
+
+  quint32 seed = 1;
+};
+
+
+
+/*
+ * Mock UDisks2 service, serving a configurable set of drives and raid arrays
+ *
+ * Implement the subset of ObjectManager, Properties, Drive, Drive.Ata, MDRaid and
+ * Job used by libdiskmonitor. Every node is handled by this single virtual object,
+ * allowing thousands of units without registering an object per node
+ */
+class MockUDisks2 : public QDBusVirtualObject
+{
+  Q_OBJECT
+
+public:
+  explicit MockUDisks2(const MockConfig& config, const QDBusConnection& connection);
+  ~MockUDisks2();
+
+  bool registerOnBus();
+
+  virtual QString introspect(const QString& path) const override;
+  virtual bool handleMessage(const QDBusMessage& message, const QDBusConnection& connection) override;
+
+private:
+  MockConfig config;
+  QDBusConnection connection;
+
+  ManagedObjectList objects;
+  SmartAttributesList attributes;
+  QSet<QDBusObjectPath> standbyDrives;
+
+  //running jobs and the drive they operate on
+  QMap<QDBusObjectPath, QDBusObjectPath> jobs;
+  int jobCount = 0;
+
+  QTimer hotplugTimer;
+  QTimer changeTimer;
+  QTimer jobTimer;
+  QTimer jobProgressTimer;
+  std::mt19937 random;
+
+  void createDrive(int index);
+  void createRaid(int index);
+  void createAttributes();
+
+  bool roll(double probability);
+  QDBusMessage buildReply(const QDBusMessage& message);
+  void sendReply(const QDBusMessage& reply);
+
+  void emitInterfacesAdded(const QDBusObjectPath& objectPath);
+  void emitInterfacesRemoved(const QDBusObjectPath& objectPath);
+  void emitPropertiesChanged(const QDBusObjectPath& objectPath, const QString& interface, const QVariantMap& properties);
+
+private slots:
+  void hotplug();
+  void changeProperties();
+  void startJob();
+  void progressJobs();
+};
+
+#endif // MOCKUDISKS2_H
@@ -0,0 +1,40 @@
+#!/bin/sh
+#
+# Start a private bus running mockudisks2, then run the given command with
+# DISKMONITOR_UDISKS2_BUS pointing libdiskmonitor to the mock service
+#
+# Usage: run-private-bus.sh [mockudisks2 options] -- command [args]
+#
+# Example: run-private-bus.sh --drives 1000 --latency 5 -- ./diskmonitord --snapshot ""
+
+MOCK_OPTIONS=""
+while [ $# -gt 0 ] && [ "$1" != "--" ]; do
+  MOCK_OPTIONS="$MOCK_OPTIONS $1"
+  shift
+done
+[ "$1" = "--" ] && shift
+
+if [ $# -eq 0 ]; then
+  echo "Usage: $0 [mockudisks2 options] -- command [args]" >&2
+  exit 1
+fi
+
+DIR=$(dirname "$0")
+
+eval $(dbus-daemon --session --fork --print-address=1 --print-pid=1 | {
+  read address; read pid
+  echo "BUS_ADDRESS='$address'; BUS_PID=$pid"
+})
+trap 'kill $MOCK_PID $BUS_PID 2>/dev/null' EXIT INT TERM
+
+"$DIR/mockudisks2" --address "$BUS_ADDRESS" $MOCK_OPTIONS &
+MOCK_PID=$!
+
+#wait for the mock to own its name
+for i in $(seq 50); do
+  dbus-send --bus="$BUS_ADDRESS" --print-reply --dest=org.freedesktop.DBus / org.freedesktop.DBus.NameHasOwner \
+    string:org.freedesktop.UDisks2 2>/dev/null | grep -q "true" && break
+  sleep 0.1
+done
+
+DISKMONITOR_UDISKS2_BUS="$BUS_ADDRESS" "$@"